@@ -1,7 +1,9 @@
 #pragma once
 
 #include <cstddef>
+#include <cstring>
 #include <map>
+#include <optional>
 #include <string>
 #include <vector>
 #include <utility>
@@ -40,16 +42,24 @@ public:
   cereal::Event::Reader &operator[](const char *name) const;
 
 private:
+  struct SubMessage;
   bool all_(const std::vector<const char *> &service_list, bool valid, bool alive);
+  SubMessage *find(const char *name) const;
+  bool receive(SubMessage *m);
+  void updateMessage(SubMessage *m, uint64_t current_time, const cereal::Event::Reader &event);
+  void updateAlive(uint64_t current_time);
+
   Poller *poller_ = nullptr;
-  struct SubMessage;
-  std::map<SubSocket *, SubMessage *> messages_;
-  std::map<std::string, SubMessage *> services_;
+  std::vector<SubMessage *> messages_;  // in service_list order
+  std::vector<SubMessage *> services_;  // sorted by name for lookups without std::string
+  std::vector<SubMessage *> polled_;    // sorted by socket, to find the messages poll() returned
 };
 
 class MessageBuilder : public capnp::MallocMessageBuilder {
 public:
   MessageBuilder() = default;
+  // first_segment must be zeroed, it is zeroed again when the builder is destroyed
+  MessageBuilder(kj::ArrayPtr<capnp::word> first_segment) : capnp::MallocMessageBuilder(first_segment) {}
 
   cereal::Event::Builder initEvent(bool valid = true) {
     cereal::Event::Builder event = initRoot<cereal::Event>();
@@ -82,11 +92,59 @@ private:
   kj::Array<capnp::word> heapArray_;
 };
 
+// Builds every message in the same first segment and serializes into the same
+// output buffer. The first segment grows to fit the largest message seen, after
+// which building and sending a message doesn't allocate.
+class PooledMessageBuilder {
+public:
+  PooledMessageBuilder(size_t first_segment_words = 1024) {
+    allocSegment(first_segment_words);
+    builder_.emplace(first_segment_);
+  }
+
+  // discards the previous message
+  MessageBuilder &reset() {
+    auto segments = builder_->getSegmentsForOutput();
+    if (segments.size() > 1) {
+      size_t words = 0;
+      for (auto &segment : segments) words += segment.size();
+      builder_.reset();
+      allocSegment(words * 2);
+    }
+    builder_.emplace(first_segment_);
+    return *builder_;
+  }
+  inline cereal::Event::Builder initEvent(bool valid = true) { return reset().initEvent(valid); }
+  inline MessageBuilder &builder() { return *builder_; }
+
+  kj::ArrayPtr<capnp::byte> toBytes() {
+    size_t size = builder_->getSerializedSize();
+    if (output_.size() * sizeof(capnp::word) < size) {
+      output_ = kj::heapArray<capnp::word>(size / sizeof(capnp::word) * 2);
+    }
+    builder_->serializeToBuffer(output_.asBytes().begin(), size);
+    return output_.asBytes().slice(0, size);
+  }
+
+private:
+  void allocSegment(size_t words) {
+    first_segment_ = kj::heapArray<capnp::word>(words);
+    memset(first_segment_.begin(), 0, first_segment_.size() * sizeof(capnp::word));
+  }
+
+  kj::Array<capnp::word> first_segment_, output_;
+  std::optional<MessageBuilder> builder_;
+};
+
 class PubMaster {
 public:
   PubMaster(const std::vector<const char *> &service_list);
   inline int send(const char *name, capnp::byte *data, size_t size) { return sockets_.at(name)->send((char *)data, size); }
   int send(const char *name, MessageBuilder &msg);
+  inline int send(const char *name, PooledMessageBuilder &msg) {
+    auto bytes = msg.toBytes();
+    return send(name, bytes.begin(), bytes.size());
+  }
   ~PubMaster();
 
 private:
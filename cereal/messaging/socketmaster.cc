@@ -1,6 +1,9 @@
 #include <time.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
 #include <string>
 #include <mutex>
 
@@ -46,7 +49,9 @@ struct SubMaster::SubMessage {
   uint64_t rcv_time = 0, rcv_frame = 0;
   void *allocated_msg_reader = nullptr;
   bool is_polled = false;
+  bool ready = false;  // received from in this update
   capnp::FlatArrayMessageReader *msg_reader = nullptr;
+  Message *msg = nullptr;  // kept alive while msg_reader points into it
   AlignedBuffer aligned_buf;
   cereal::Event::Reader event;
 };
@@ -70,64 +75,97 @@ SubMaster::SubMaster(const std::vector<const char *> &service_list, const std::v
       .allocated_msg_reader = malloc(sizeof(capnp::FlatArrayMessageReader)),
       .is_polled = is_polled};
     m->msg_reader = new (m->allocated_msg_reader) capnp::FlatArrayMessageReader({});
-    messages_[socket] = m;
-    services_[name] = m;
+    messages_.push_back(m);
   }
+
+  services_ = messages_;
+  std::sort(services_.begin(), services_.end(), [](auto a, auto b) { return a->name < b->name; });
+  std::copy_if(messages_.begin(), messages_.end(), std::back_inserter(polled_), [](auto m) { return m->is_polled; });
+  std::sort(polled_.begin(), polled_.end(), [](auto a, auto b) { return a->socket < b->socket; });
 }
 
-void SubMaster::update(int timeout) {
-  for (auto &kv : messages_) kv.second->updated = false;
+SubMaster::SubMessage *SubMaster::find(const char *name) const {
+  auto it = std::lower_bound(services_.begin(), services_.end(), name,
+                             [](const SubMessage *m, const char *n) { return strcmp(m->name.c_str(), n) < 0; });
+  if (it == services_.end() || strcmp((*it)->name.c_str(), name) != 0) {
+    throw std::out_of_range(name);
+  }
+  return *it;
+}
+
+bool SubMaster::receive(SubMessage *m) {
+  Message *msg = m->socket->receive(true);
+  if (msg == nullptr) return false;
 
-  auto sockets = poller_->poll(timeout);
+  m->msg_reader->~FlatArrayMessageReader();
+  delete m->msg;
+  m->msg = msg;
 
-  // add non-polled sockets for non-blocking receive
-  for (auto &kv : messages_) {
-    SubMessage *m = kv.second;
-    SubSocket *s = kv.first;
-    if (!m->is_polled) sockets.push_back(s);
+  // read in place if msgq handed us a word aligned buffer, copy otherwise
+  kj::ArrayPtr<const capnp::word> words;
+  if (((uintptr_t)msg->getData() % sizeof(capnp::word)) == 0 && (msg->getSize() % sizeof(capnp::word)) == 0) {
+    words = kj::ArrayPtr<const capnp::word>((const capnp::word *)msg->getData(), msg->getSize() / sizeof(capnp::word));
+  } else {
+    words = m->aligned_buf.align(msg);
   }
 
-  uint64_t current_time = nanos_since_boot();
+  capnp::ReaderOptions options;
+  options.traversalLimitInWords = kj::maxValue; // Don't limit
+  m->msg_reader = new (m->allocated_msg_reader) capnp::FlatArrayMessageReader(words, options);
+  return true;
+}
 
-  std::vector<std::pair<std::string, cereal::Event::Reader>> messages;
+void SubMaster::update(int timeout) {
+  for (auto m : messages_) {
+    m->updated = false;
+    // non-polled sockets get a non-blocking receive
+    m->ready = !m->is_polled;
+  }
 
-  for (auto s : sockets) {
-    Message *msg = s->receive(true);
-    if (msg == nullptr) continue;
+  for (auto s : poller_->poll(timeout)) {
+    auto it = std::lower_bound(polled_.begin(), polled_.end(), s, [](const SubMessage *m, SubSocket *s) { return m->socket < s; });
+    if (it != polled_.end() && (*it)->socket == s) (*it)->ready = true;
+  }
 
-    SubMessage *m = messages_.at(s);
+  uint64_t current_time = nanos_since_boot();
+  if (++frame == UINT64_MAX) frame = 1;
 
-    m->msg_reader->~FlatArrayMessageReader();
-    capnp::ReaderOptions options;
-    options.traversalLimitInWords = kj::maxValue; // Don't limit
-    m->msg_reader = new (m->allocated_msg_reader) capnp::FlatArrayMessageReader(m->aligned_buf.align(msg), options);
-    delete msg;
-    messages.push_back({m->name, m->msg_reader->getRoot<cereal::Event>()});
+  for (auto m : messages_) {
+    if (m->ready && receive(m)) {
+      updateMessage(m, current_time, m->msg_reader->getRoot<cereal::Event>());
+    }
   }
 
-  update_msgs(current_time, messages);
+  updateAlive(current_time);
 }
 
 void SubMaster::update_msgs(uint64_t current_time, const std::vector<std::pair<std::string, cereal::Event::Reader>> &messages){
   if (++frame == UINT64_MAX) frame = 1;
 
   for (auto &kv : messages) {
-    auto m_find = services_.find(kv.first);
-    if (m_find == services_.end()){
+    auto it = std::lower_bound(services_.begin(), services_.end(), kv.first,
+                               [](const SubMessage *m, const std::string &n) { return m->name < n; });
+    if (it == services_.end() || (*it)->name != kv.first) {
       continue;
     }
-    SubMessage *m = m_find->second;
-    m->event = kv.second;
-    m->updated = true;
-    m->rcv_time = current_time;
-    m->rcv_frame = frame;
-    m->valid = m->event.getValid();
-    if (SIMULATION) m->alive = true;
+    updateMessage(*it, current_time, kv.second);
   }
 
+  updateAlive(current_time);
+}
+
+void SubMaster::updateMessage(SubMessage *m, uint64_t current_time, const cereal::Event::Reader &event) {
+  m->event = event;
+  m->updated = true;
+  m->rcv_time = current_time;
+  m->rcv_frame = frame;
+  m->valid = m->event.getValid();
+  if (SIMULATION) m->alive = true;
+}
+
+void SubMaster::updateAlive(uint64_t current_time) {
   if (!SIMULATION) {
-    for (auto &kv : messages_) {
-      SubMessage *m = kv.second;
+    for (auto m : messages_) {
       m->alive = (m->freq <= (1e-5) || ((current_time - m->rcv_time) * (1e-9)) < (10.0 / m->freq));
     }
   }
@@ -135,8 +173,7 @@ void SubMaster::update_msgs(uint64_t current_time, const std::vector<std::pair<s
 
 bool SubMaster::all_(const std::vector<const char *> &service_list, bool valid, bool alive) {
   int found = 0;
-  for (auto &kv : messages_) {
-    SubMessage *m = kv.second;
+  for (auto m : messages_) {
     if (service_list.size() == 0 || inList(service_list, m->name.c_str())) {
       found += (!valid || m->valid) && (!alive || (m->alive || m->ignore_alive));
     }
@@ -158,35 +195,35 @@ void SubMaster::drain() {
 }
 
 bool SubMaster::updated(const char *name) const {
-  return services_.at(name)->updated;
+  return find(name)->updated;
 }
 
 bool SubMaster::alive(const char *name) const {
-  return services_.at(name)->alive;
+  return find(name)->alive;
 }
 
 bool SubMaster::valid(const char *name) const {
-  return services_.at(name)->valid;
+  return find(name)->valid;
 }
 
 uint64_t SubMaster::rcv_frame(const char *name) const {
-  return services_.at(name)->rcv_frame;
+  return find(name)->rcv_frame;
 }
 
 uint64_t SubMaster::rcv_time(const char *name) const {
-  return services_.at(name)->rcv_time;
+  return find(name)->rcv_time;
 }
 
 cereal::Event::Reader &SubMaster::operator[](const char *name) const {
-  return services_.at(name)->event;
+  return find(name)->event;
 }
 
 SubMaster::~SubMaster() {
   delete poller_;
-  for (auto &kv : messages_) {
-    SubMessage *m = kv.second;
+  for (auto m : messages_) {
     m->msg_reader->~FlatArrayMessageReader();
     free(m->allocated_msg_reader);
+    delete m->msg;
     delete m->socket;
     delete m;
   }
@@ -202,8 +239,14 @@ PubMaster::PubMaster(const std::vector<const char *> &service_list) {
 }
 
 int PubMaster::send(const char *name, MessageBuilder &msg) {
-  auto bytes = msg.toBytes();
-  return send(name, bytes.begin(), bytes.size());
+  // serialize into a buffer that is reused across messages sent from this thread
+  static thread_local kj::Array<capnp::word> buf;
+  size_t size = msg.getSerializedSize();
+  if (buf.size() * sizeof(capnp::word) < size) {
+    buf = kj::heapArray<capnp::word>(size / sizeof(capnp::word) * 2);
+  }
+  msg.serializeToBuffer(buf.asBytes().begin(), size);
+  return send(name, buf.asBytes().begin(), size);
 }
 
 PubMaster::~PubMaster() {
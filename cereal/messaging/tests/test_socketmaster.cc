@@ -0,0 +1,182 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <thread>
+
+#include "catch2/catch.hpp"
+#include "cereal/messaging/messaging.h"
+#include "common/tests/alloc_count.h"
+#include "common/timing.h"
+
+// 20 services that are published at or near 100 Hz on the device
+const std::vector<const char *> TEST_SERVICES = {
+  "gyroscope2", "accelerometer2", "lightSensor", "can", "controlsState",
+  "sendcan", "carState", "carControl", "carOutput", "radarState",
+  "liveTracks", "roadCameraState", "driverCameraState", "wideRoadCameraState", "modelV2",
+  "longitudinalPlan", "liveLocationKalman", "liveParameters", "cameraOdometry", "driverStateV2",
+};
+
+void publish_all(PubMaster &pm, int frame) {
+  for (auto name : TEST_SERVICES) {
+    MessageBuilder msg;
+    auto event = msg.initEvent(frame % 2 == 0);
+    if (strcmp(name, "carState") == 0) {
+      event.initCarState().setVEgo(frame);
+    } else if (strcmp(name, "can") == 0) {
+      auto can = event.initCan(50);
+      for (int i = 0; i < can.size(); ++i) {
+        can[i].setAddress(i);
+        can[i].setDat(kj::arrayPtr((capnp::byte *)&frame, sizeof(frame)));
+      }
+    } else {
+      event.initControlsState().setVCruise(frame);
+    }
+    pm.send(name, msg);
+  }
+}
+
+TEST_CASE("SubMaster") {
+  SubMaster sm(TEST_SERVICES);
+  PubMaster pm(TEST_SERVICES);
+
+  for (int frame = 0; frame < 100; ++frame) {
+    publish_all(pm, frame);
+    sm.update(100);
+    for (auto name : TEST_SERVICES) {
+      REQUIRE(sm.updated(name));
+    }
+    REQUIRE(sm["carState"].getCarState().getVEgo() == frame);
+    REQUIRE(sm["can"].getCan().size() == 50);
+    REQUIRE(sm.valid("carState") == (frame % 2 == 0));
+  }
+  REQUIRE_THROWS_AS(sm["gpsLocation"], std::out_of_range);
+}
+
+// the receive path SubMaster::update used before reading messages in place
+struct CopyingSubMaster {
+  CopyingSubMaster() {
+    ctx.reset(Context::create());
+    poller.reset(Poller::create());
+    for (auto name : TEST_SERVICES) {
+      SubSocket *s = SubSocket::create(ctx.get(), name, "127.0.0.1", true);
+      poller->registerSocket(s);
+      socks.emplace_back(s, name);
+      bufs.emplace_back();
+      readers.emplace_back(new capnp::FlatArrayMessageReader({}));
+    }
+  }
+  void update(int timeout) {
+    std::vector<std::pair<std::string, cereal::Event::Reader>> messages;
+    for (auto s : poller->poll(timeout)) {
+      Message *msg = s->receive(true);
+      if (msg == nullptr) continue;
+      int i = std::find_if(socks.begin(), socks.end(), [=](auto &p) { return p.first.get() == s; }) - socks.begin();
+      capnp::ReaderOptions options;
+      options.traversalLimitInWords = kj::maxValue;
+      readers[i].reset(new capnp::FlatArrayMessageReader(bufs[i].align(msg), options));
+      delete msg;
+      messages.push_back({socks[i].second, readers[i]->getRoot<cereal::Event>()});
+    }
+  }
+
+  std::unique_ptr<Context> ctx;
+  std::unique_ptr<Poller> poller;
+  std::vector<std::pair<std::unique_ptr<SubSocket>, std::string>> socks;
+  std::vector<AlignedBuffer> bufs;
+  std::vector<std::unique_ptr<capnp::FlatArrayMessageReader>> readers;
+};
+
+template <typename SM>
+void benchmark_update(const char *label, SM &sm, PubMaster &pm) {
+  const int cycles = 300;
+  std::vector<double> update_us;
+  for (int frame = 0; frame < cycles; ++frame) {
+    uint64_t cycle_start = nanos_since_boot();
+    publish_all(pm, frame);
+
+    uint64_t start = nanos_since_boot();
+    sm.update(0);
+    update_us.push_back((nanos_since_boot() - start) / 1e3);
+
+    // run at 100 Hz
+    int64_t remaining = 10 * 1000000 - (nanos_since_boot() - cycle_start);
+    if (remaining > 0) std::this_thread::sleep_for(std::chrono::nanoseconds(remaining));
+  }
+  std::sort(update_us.begin(), update_us.end());
+  double mean = std::accumulate(update_us.begin(), update_us.end(), 0.0) / update_us.size();
+  printf("%-24s update() with %zu services: mean %7.2f us, p50 %7.2f us, p99 %7.2f us\n", label, TEST_SERVICES.size(),
+         mean, update_us[update_us.size() / 2], update_us[update_us.size() * 99 / 100]);
+}
+
+TEST_CASE("SubMaster update at 100Hz", "[.][benchmark]") {
+  SECTION("copying receive path") {
+    CopyingSubMaster sm;
+    PubMaster pm(TEST_SERVICES);
+    benchmark_update("copying receive path", sm, pm);
+  }
+  SECTION("SubMaster") {
+    SubMaster sm(TEST_SERVICES);
+    PubMaster pm(TEST_SERVICES);
+    benchmark_update("SubMaster", sm, pm);
+  }
+}
+
+void build_can(cereal::Event::Builder event, int frame) {
+  auto can = event.initCan(100);
+  for (int i = 0; i < can.size(); ++i) {
+    can[i].setAddress(i);
+    can[i].setSrc(i % 3);
+    can[i].setDat(kj::arrayPtr((capnp::byte *)&frame, sizeof(frame)));
+  }
+}
+
+TEST_CASE("PooledMessageBuilder") {
+  PubMaster pm({"can"});
+  SubMaster sm({"can"});
+
+  SECTION("steady state building and serializing doesn't allocate") {
+    // start with a first segment that is too small, it grows on the next reset
+    PooledMessageBuilder msg(16);
+    for (int frame = 0; frame < 3; ++frame) {
+      build_can(msg.initEvent(), frame);
+      msg.toBytes();
+    }
+
+    // PubSocket::send is left out, msgq copies the message into its own buffer
+    alloc_count = 0;
+    count_allocs = true;
+    for (int frame = 0; frame < 100; ++frame) {
+      build_can(msg.initEvent(), frame);
+      msg.toBytes();
+    }
+    count_allocs = false;
+    REQUIRE(alloc_count == 0);
+
+    pm.send("can", msg);
+    sm.update(100);
+    REQUIRE(sm.updated("can"));
+    REQUIRE(sm["can"].getCan().size() == 100);
+  }
+  SECTION("builds a message without a reset first") {
+    PooledMessageBuilder msg;
+    build_can(msg.builder().initEvent(), 0);
+    pm.send("can", msg);
+    sm.update(100);
+    REQUIRE(sm.updated("can"));
+    REQUIRE(sm["can"].getCan().size() == 100);
+  }
+  SECTION("a new MessageBuilder allocates every message") {
+    alloc_count = 0;
+    count_allocs = true;
+    for (int frame = 0; frame < 100; ++frame) {
+      MessageBuilder msg;
+      build_can(msg.initEvent(), frame);
+      msg.toBytes();
+    }
+    count_allocs = false;
+    REQUIRE(alloc_count >= 100);
+  }
+}
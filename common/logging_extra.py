@@ -12,6 +12,8 @@ from threading import local
 from collections import OrderedDict
 from contextlib import contextmanager
 
+from openpilot.common.trace import TRACE_NO_FRAME_ID, trace
+
 LOG_TIMESTAMPS = "LOG_TIMESTAMPS" in os.environ
 
 def json_handler(obj):
@@ -166,13 +168,17 @@ class SwagLogger(logging.Logger):
     else:
       self.info(evt)
 
-  def timestamp(self, event_name):
+  def timestamp(self, event_name, frame_id=TRACE_NO_FRAME_ID):
+    # the binary trace is always on
+    trace(event_name, frame_id)
     if LOG_TIMESTAMPS:
       t = time.monotonic()
       tstp = NiceOrderedDict()
       tstp['timestamp'] = NiceOrderedDict()
       tstp['timestamp']["event"] = event_name
       tstp['timestamp']["time"] = t*1e9
+      if frame_id != TRACE_NO_FRAME_ID:
+        tstp['timestamp']["frame_id"] = frame_id
       self.debug(tstp)
 
   def findCaller(self, stack_info=False, stacklevel=1):
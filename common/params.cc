@@ -1,15 +1,26 @@
 #include "common/params.h"
 
 #include <dirent.h>
+#include <poll.h>
 #include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
 
 #include <algorithm>
 #include <cassert>
+#include <climits>
 #include <csignal>
+#include <cstring>
+#include <mutex>
 #include <unordered_map>
 
 #include "common/queue.h"
 #include "common/swaglog.h"
+#include "common/timing.h"
 #include "common/util.h"
 #include "system/hardware/hw.h"
 
@@ -20,6 +31,25 @@ void params_sig_handler(int signal) {
   params_do_exit = 1;
 }
 
+// Writes value to a new temp file next to the params and fsyncs it.
+int write_tmp_file(const std::string &path, const char *value, size_t value_size, std::string &tmp_path) {
+  tmp_path = path + "/.tmp_value_XXXXXX";
+  int tmp_fd = mkstemp((char*)tmp_path.c_str());
+  if (tmp_fd < 0) return -1;
+
+  int result = -20;
+  ssize_t bytes_written = HANDLE_EINTR(write(tmp_fd, value, value_size));
+  if (bytes_written >= 0 && (size_t)bytes_written == value_size) {
+    // fsync to force persist the changes.
+    result = fsync(tmp_fd);
+  }
+  close(tmp_fd);
+  if (result != 0) {
+    ::unlink(tmp_path.c_str());
+  }
+  return result;
+}
+
 int fsync_dir(const std::string &path) {
   int result = -1;
   int fd = HANDLE_EINTR(open(path.c_str(), O_RDONLY, 0755));
@@ -259,10 +289,342 @@ std::unordered_map<std::string, uint32_t> keys = {
 
 } // namespace
 
+// Reports params written to or removed from a params directory.
+// Without inotify it falls back to polling and can't tell which keys changed.
+class ParamsWatcher {
+public:
+  ParamsWatcher(const std::string &path) {
+#ifdef __linux__
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    // params are renamed into place, removed by unlink
+    if (inotify_fd < 0 || wake_fd < 0 ||
+        inotify_add_watch(inotify_fd, path.c_str(), IN_MOVED_TO | IN_DELETE) < 0) {
+      LOGE("Failed to watch params path %s, errno=%d", path.c_str(), errno);
+      closeFds();
+    }
+#endif
+  }
+
+  ~ParamsWatcher() { closeFds(); }
+
+  // Returns true when something changed, changed is empty if the keys are unknown.
+  // Returns false on timeout, interrupt() or a signal.
+  bool wait(std::vector<std::string> &changed, int timeout_ms) {
+    changed.clear();
+    if (inotify_fd < 0 || wake_fd < 0) {
+      util::sleep_for(timeout_ms < 0 ? 100 : std::min(timeout_ms, 100));
+      return !interrupted;
+    }
+
+#ifdef __linux__
+    struct pollfd fds[] = {{.fd = inotify_fd, .events = POLLIN}, {.fd = wake_fd, .events = POLLIN}};
+    if (poll(fds, std::size(fds), timeout_ms) <= 0 || (fds[1].revents & POLLIN)) {
+      return false;
+    }
+
+    alignas(struct inotify_event) char buf[4096];
+    ssize_t len = 0;
+    while ((len = read(inotify_fd, buf, sizeof(buf))) > 0) {
+      for (char *p = buf; p < buf + len; p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len) {
+        auto event = (struct inotify_event *)p;
+        if (event->mask & IN_Q_OVERFLOW) {
+          // events were dropped, report everything as changed
+          changed.clear();
+          return true;
+        }
+        if (event->len > 0) {
+          changed.push_back(event->name);
+        }
+      }
+    }
+#endif
+    return true;
+  }
+
+  void interrupt() {
+    interrupted = true;
+#ifdef __linux__
+    if (wake_fd >= 0) {
+      uint64_t one = 1;
+      HANDLE_EINTR(write(wake_fd, &one, sizeof(one)));
+    }
+#endif
+  }
+
+private:
+  void closeFds() {
+    if (inotify_fd >= 0) close(inotify_fd);
+    if (wake_fd >= 0) close(wake_fd);
+    inotify_fd = wake_fd = -1;
+  }
+
+  int inotify_fd = -1, wake_fd = -1;
+  std::atomic<bool> interrupted = false;
+};
+
+// Shared memory copy of a params directory, so reads don't need any syscalls.
+// The files stay the source of truth: writers update them first and then the cache,
+// both while holding the params lock. Every known key has a page sized slot guarded
+// by a seqlock, values that don't fit are read from disk. The generation is odd while
+// a write is in progress, readAll uses it to get a consistent snapshot of all slots.
+// Nothing checks the files again, so params must only be written through Params.
+// A writer that dies while updating a slot leaves it odd, the next reader finds it
+// busy and reloads it under the params lock, which the dead writer doesn't hold anymore.
+class ParamsCache {
+public:
+  enum SlotState : uint32_t {
+    UNKNOWN = 0,  // not loaded since the cache was created
+    ABSENT,
+    PRESENT,
+    UNCACHED,     // too large
+    BUSY,         // only returned by read(), being written or a writer died while writing it
+  };
+
+  static std::shared_ptr<ParamsCache> get(const std::string &dir, const std::string &lock_path);
+  ~ParamsCache() { munmap(header, map_size); }
+
+  static int index(const std::string &key) {
+    auto &sorted = sortedKeys();
+    auto it = std::lower_bound(sorted.begin(), sorted.end(), key);
+    return it != sorted.end() && *it == key ? it - sorted.begin() : -1;
+  }
+
+  SlotState read(int idx, std::string &value) const {
+    const Slot &slot = slots[idx];
+    for (int i = 0; i < 1000; ++i) {
+      uint32_t seq = slot.seq.load(std::memory_order_acquire);
+      if (seq & 1) continue;
+
+      uint32_t state = slot.state;
+      if (state == PRESENT) {
+        value.assign(slot.data, std::min<size_t>(slot.size, sizeof(slot.data)));
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) == seq) {
+        return state <= UNCACHED ? (SlotState)state : UNCACHED;
+      }
+    }
+    return BUSY;
+  }
+
+  // returns false if the cache doesn't hold the whole directory
+  bool readAll(std::map<std::string, std::string> &values, const std::function<std::string(const std::string &)> &read_file) const {
+    auto &sorted = sortedKeys();
+    for (int i = 0; i < 100; ++i) {
+      uint64_t generation = header->generation.load(std::memory_order_acquire);
+      if (generation & 1) continue;
+      if (!header->complete.load(std::memory_order_relaxed)) return false;
+
+      values.clear();
+      std::string value;
+      for (int idx = 0; idx < (int)sorted.size(); ++idx) {
+        SlotState state = read(idx, value);
+        if (state == UNKNOWN || state == BUSY) return false;
+        if (state == PRESENT) values[sorted[idx]] = value;
+        if (state == UNCACHED) values[sorted[idx]] = read_file(sorted[idx]);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (header->generation.load(std::memory_order_relaxed) == generation) return true;
+    }
+    return false;
+  }
+
+  // updates, the caller must hold the params lock
+  void beginWrite() {
+    header->generation.store(header->generation.load(std::memory_order_relaxed) | 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+  void endWrite() {
+    header->generation.store((header->generation.load(std::memory_order_relaxed) | 1) + 1, std::memory_order_release);
+  }
+  void put(const std::string &key, const char *value, size_t size) {
+    if (int idx = index(key); idx >= 0) {
+      update(idx, size <= sizeof(Slot::data) ? PRESENT : UNCACHED, value, size);
+    } else {
+      header->complete.store(false, std::memory_order_relaxed);
+    }
+  }
+  void remove(const std::string &key) {
+    if (int idx = index(key); idx >= 0) {
+      update(idx, ABSENT);
+    }
+  }
+  // replace everything with the contents of the whole directory
+  void fill(const std::map<std::string, std::string> &values) {
+    auto &sorted = sortedKeys();
+    beginWrite();
+    for (int idx = 0; idx < (int)sorted.size(); ++idx) {
+      auto it = values.find(sorted[idx]);
+      it == values.end() ? update(idx, ABSENT) : put(it->first, it->second.data(), it->second.size());
+    }
+    bool complete = std::all_of(values.begin(), values.end(), [](auto &v) { return index(v.first) >= 0; });
+    header->complete.store(complete, std::memory_order_relaxed);
+    endWrite();
+  }
+
+  // the shared memory file
+  const std::string path;
+
+private:
+  struct Header {
+    uint32_t magic;
+    uint32_t num_slots;
+    uint64_t dir_dev, dir_ino;  // the directory it was loaded from
+    std::atomic<uint32_t> complete;  // all slots are loaded, there are no files for unknown keys
+    std::atomic<uint64_t> generation;
+    char dir[2048];
+  };
+  struct Slot {
+    std::atomic<uint32_t> seq;
+    uint32_t state;
+    uint32_t size;
+    char data[4096 - 12];
+  };
+  static_assert(sizeof(Slot) == 4096 && sizeof(Header) <= sizeof(Slot));
+  static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free);
+  static constexpr uint32_t MAGIC = 0x50434833;  // "PCH3"
+
+  ParamsCache(const std::string &path, void *ptr, size_t size)
+      : path(path), header((Header *)ptr), slots((Slot *)((char *)ptr + sizeof(Slot))), map_size(size) {}
+
+  static const std::vector<std::string> &sortedKeys() {
+    static const std::vector<std::string> sorted = [] {
+      std::vector<std::string> ret;
+      for (auto &p : keys) ret.push_back(p.first);
+      std::sort(ret.begin(), ret.end());
+      return ret;
+    }();
+    return sorted;
+  }
+
+  void update(int idx, SlotState state, const char *value = nullptr, size_t size = 0) {
+    Slot &slot = slots[idx];
+    uint32_t seq = slot.seq.load(std::memory_order_relaxed) | 1;
+    slot.seq.store(seq, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.state = state;
+    slot.size = state == PRESENT ? size : 0;
+    if (state == PRESENT) {
+      memcpy(slot.data, value, size);
+    }
+    slot.seq.store(seq + 1, std::memory_order_release);
+  }
+
+  static std::string cacheDir();
+  static void removeStale(const std::string &cache_dir);
+  static std::shared_ptr<ParamsCache> create(const std::string &real_path, const struct stat &dir_st, const std::string &lock_path);
+
+  Header *header;
+  Slot *slots;
+  size_t map_size;
+};
+
+std::shared_ptr<ParamsCache> ParamsCache::get(const std::string &dir, const std::string &lock_path) {
+  // the params directory is a symlink to a temp dir, which is replaced when recreated
+  char real_path[PATH_MAX];
+  struct stat st = {};
+  if (!realpath(dir.c_str(), real_path) || stat(real_path, &st) != 0) return nullptr;
+
+  // one mapping per directory and process
+  static std::mutex lock;
+  static std::map<std::string, std::shared_ptr<ParamsCache>> caches;
+  std::lock_guard lk(lock);
+  auto &cache = caches[real_path];
+  if (!cache || cache->header->dir_dev != st.st_dev || cache->header->dir_ino != st.st_ino) {
+    cache = create(real_path, st, lock_path);
+  }
+  return cache;
+}
+
+std::string ParamsCache::cacheDir() {
+#ifdef __APPLE__
+  std::string cache_dir = "/tmp";
+#else
+  std::string cache_dir = "/dev/shm";
+#endif
+  // keep it next to the prefix's msgq files, they're cleaned up together
+  if (auto prefix = Path::openpilot_prefix(); !prefix.empty() && util::file_exists(cache_dir + "/" + prefix)) {
+    cache_dir += "/" + prefix;
+  }
+  return cache_dir;
+}
+
+// removes the caches of directories that don't exist anymore. a process still using one
+// keeps its mapping, there is nothing left to write to it.
+void ParamsCache::removeStale(const std::string &cache_dir) {
+  DIR *d = opendir(cache_dir.c_str());
+  if (!d) return;
+  while (struct dirent *de = readdir(d)) {
+    if (strncmp(de->d_name, "params_cache_", strlen("params_cache_")) != 0) continue;
+
+    std::string fn = cache_dir + "/" + de->d_name;
+    int fd = HANDLE_EINTR(open(fn.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd < 0) continue;
+    Header h;
+    bool stale = false;
+    if (HANDLE_EINTR(pread(fd, &h, sizeof(h), 0)) == sizeof(h) && h.magic == MAGIC) {
+      h.dir[sizeof(h.dir) - 1] = '\0';
+      struct stat st = {};
+      stale = stat(h.dir, &st) != 0 || st.st_dev != h.dir_dev || st.st_ino != h.dir_ino;
+    }
+    close(fd);
+    if (stale) {
+      unlink(fn.c_str());
+    }
+  }
+  closedir(d);
+}
+
+std::shared_ptr<ParamsCache> ParamsCache::create(const std::string &real_path, const struct stat &dir_st, const std::string &lock_path) {
+  if (real_path.size() >= sizeof(Header::dir)) return nullptr;
+
+  // named after the directory and the known keys, so builds with different keys don't share it
+  std::string id = real_path;
+  for (auto &key : sortedKeys()) id += "," + key;
+  const std::string cache_dir = cacheDir();
+  removeStale(cache_dir);
+  std::string fn = util::string_format("%s/params_cache_%016zx", cache_dir.c_str(), std::hash<std::string>{}(id));
+
+  const size_t size = sizeof(Slot) * (sortedKeys().size() + 1);
+  FileLock file_lock(lock_path);
+  int fd = HANDLE_EINTR(open(fn.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600));
+  if (fd < 0) {
+    LOGW("Failed to open params cache %s, errno=%d", fn.c_str(), errno);
+    return nullptr;
+  }
+  struct stat st = {};
+  bool ok = fstat(fd, &st) == 0 && ((size_t)st.st_size == size || (st.st_size == 0 && ftruncate(fd, size) == 0));
+  void *ptr = ok ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    LOGW("Failed to map params cache %s, errno=%d", fn.c_str(), errno);
+    return nullptr;
+  }
+
+  std::shared_ptr<ParamsCache> cache(new ParamsCache(fn, ptr, size));
+  Header *h = cache->header;
+  if (h->magic != MAGIC || h->num_slots != sortedKeys().size() || h->dir_dev != dir_st.st_dev || h->dir_ino != dir_st.st_ino) {
+    cache->beginWrite();
+    for (int idx = 0; idx < (int)sortedKeys().size(); ++idx) {
+      cache->update(idx, UNKNOWN);
+    }
+    h->num_slots = sortedKeys().size();
+    h->dir_dev = dir_st.st_dev;
+    h->dir_ino = dir_st.st_ino;
+    strncpy(h->dir, real_path.c_str(), sizeof(h->dir));
+    h->complete.store(false, std::memory_order_relaxed);
+    h->magic = MAGIC;
+    cache->endWrite();
+  }
+  return cache;
+}
+
 
 Params::Params(const std::string &path) {
   params_prefix = "/" + util::getenv("OPENPILOT_PREFIX", "d");
   params_path = ensure_params_path(params_prefix, path);
+  cache = ParamsCache::get(getParamPath(), params_path + "/.lock");
 }
 
 Params::~Params() {
@@ -270,6 +632,9 @@ Params::~Params() {
     future.wait();
   }
   assert(queue.empty());
+
+  for (auto &w : watchers) w->interrupt();
+  for (auto &t : watch_threads) t.join();
 }
 
 std::vector<std::string> Params::allKeys() const {
@@ -295,41 +660,76 @@ int Params::put(const char* key, const char* value, size_t value_size) {
   // 3) fsync() the temp file
   // 4) rename the temp file to the real name
   // 5) fsync() the containing directory
-  std::string tmp_path = params_path + "/.tmp_value_XXXXXX";
-  int tmp_fd = mkstemp((char*)tmp_path.c_str());
-  if (tmp_fd < 0) return -1;
-
-  int result = -1;
-  do {
-    // Write value to temp.
-    ssize_t bytes_written = HANDLE_EINTR(write(tmp_fd, value, value_size));
-    if (bytes_written < 0 || (size_t)bytes_written != value_size) {
-      result = -20;
-      break;
-    }
-
-    // fsync to force persist the changes.
-    if ((result = fsync(tmp_fd)) < 0) break;
+  std::string tmp_path;
+  int result = write_tmp_file(params_path, value, value_size, tmp_path);
+  if (result != 0) return result;
 
+  {
     FileLock file_lock(params_path + "/.lock");
 
     // Move temp into place.
-    if ((result = rename(tmp_path.c_str(), getParamPath(key).c_str())) < 0) break;
+    if ((result = rename(tmp_path.c_str(), getParamPath(key).c_str())) == 0) {
+      if (cache) {
+        cache->beginWrite();
+        cache->put(key, value, value_size);
+        cache->endWrite();
+      }
 
-    // fsync parent directory
-    result = fsync_dir(getParamPath());
-  } while (false);
+      // fsync parent directory
+      result = fsync_dir(getParamPath());
+    }
+  }
 
-  close(tmp_fd);
   if (result != 0) {
     ::unlink(tmp_path.c_str());
   }
   return result;
 }
 
+int Params::putMany(const std::map<std::string, std::string> &values) {
+  // same as put(), but all values are moved into place under one lock and
+  // followed by a single fsync of the directory
+  std::vector<std::string> tmp_paths;
+  int result = 0;
+  for (auto &[key, value] : values) {
+    if ((result = write_tmp_file(params_path, value.data(), value.size(), tmp_paths.emplace_back())) != 0) {
+      tmp_paths.pop_back();
+      break;
+    }
+  }
+
+  if (result == 0) {
+    FileLock file_lock(params_path + "/.lock");
+
+    if (cache) cache->beginWrite();
+    auto it = values.begin();
+    for (auto &tmp_path : tmp_paths) {
+      if ((result = rename(tmp_path.c_str(), getParamPath(it->first).c_str())) < 0) break;
+      if (cache) cache->put(it->first, it->second.data(), it->second.size());
+      tmp_path.clear();
+      ++it;
+    }
+    if (cache) cache->endWrite();
+
+    if (int ret = fsync_dir(getParamPath()); result == 0) {
+      result = ret;
+    }
+  }
+
+  for (auto &tmp_path : tmp_paths) {
+    if (!tmp_path.empty()) ::unlink(tmp_path.c_str());
+  }
+  return result;
+}
+
 int Params::remove(const std::string &key) {
   FileLock file_lock(params_path + "/.lock");
   int result = unlink(getParamPath(key).c_str());
+  if (cache && (result == 0 || errno == ENOENT)) {
+    cache->beginWrite();
+    cache->remove(key);
+    cache->endWrite();
+  }
   if (result != 0) {
     return result;
   }
@@ -338,6 +738,10 @@ int Params::remove(const std::string &key) {
 
 std::string Params::get(const std::string &key, bool block) {
   if (!block) {
+    std::string value;
+    if (cache && getCached(key, value)) {
+      return value;
+    }
     return util::read_file(getParamPath(key));
   } else {
     // blocking read until successful
@@ -345,23 +749,101 @@ std::string Params::get(const std::string &key, bool block) {
     void (*prev_handler_sigint)(int) = std::signal(SIGINT, params_sig_handler);
     void (*prev_handler_sigterm)(int) = std::signal(SIGTERM, params_sig_handler);
 
-    std::string value;
-    while (!params_do_exit) {
-      if (value = util::read_file(getParamPath(key)); !value.empty()) {
-        break;
-      }
-      util::sleep_for(100);  // 0.1 s
-    }
+    std::string value = waitFor(key);
 
     std::signal(SIGINT, prev_handler_sigint);
     std::signal(SIGTERM, prev_handler_sigterm);
+    params_do_exit = 0;
     return value;
   }
 }
 
+std::string Params::cachePath() const {
+  return cache ? cache->path : "";
+}
+
+bool Params::getCached(const std::string &key, std::string &value) {
+  int idx = ParamsCache::index(key);
+  if (idx < 0) return false;
+
+  switch (cache->read(idx, value)) {
+    case ParamsCache::PRESENT:
+      return true;
+    case ParamsCache::ABSENT:
+      value.clear();
+      return true;
+    case ParamsCache::UNKNOWN:
+    case ParamsCache::BUSY: {
+      // not loaded yet, or a writer is updating it or died doing so. no writer
+      // can race with us under the lock, reloading it ends a write that never finished
+      FileLock file_lock(params_path + "/.lock");
+      value = util::read_file(getParamPath(key));
+      cache->beginWrite();
+      if (value.empty() && !util::file_exists(getParamPath(key))) {
+        cache->remove(key);
+      } else {
+        cache->put(key, value.data(), value.size());
+      }
+      cache->endWrite();
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+std::string Params::waitFor(const std::string &key, int timeout_ms) {
+  // watch before the first read, so a put in between isn't missed
+  ParamsWatcher watcher(getParamPath());
+  const double deadline = millis_since_boot() + timeout_ms;
+
+  std::string value;
+  std::vector<std::string> changed;
+  while (!params_do_exit) {
+    if (value = util::read_file(getParamPath(key)); !value.empty()) {
+      break;
+    }
+
+    // wake up at least once a second to catch a signal that arrived before poll
+    int wait_ms = 1000;
+    if (timeout_ms >= 0) {
+      wait_ms = std::min(wait_ms, std::max(0, (int)(deadline - millis_since_boot())));
+      if (wait_ms == 0) break;
+    }
+    watcher.wait(changed, wait_ms);
+  }
+  return value;
+}
+
+void Params::watch(const std::vector<std::string> &watch_keys, WatchCallback fn) {
+  ParamsWatcher *watcher = watchers.emplace_back(new ParamsWatcher(getParamPath())).get();
+  watch_threads.emplace_back([=]() {
+    util::set_thread_name("params_watch");
+    std::vector<std::string> changed;
+    while (watcher->wait(changed, -1)) {
+      for (const auto &key : watch_keys) {
+        if (changed.empty() || std::find(changed.begin(), changed.end(), key) != changed.end()) {
+          fn(key, util::read_file(getParamPath(key)));
+        }
+      }
+    }
+  });
+}
+
 std::map<std::string, std::string> Params::readAll() {
+  std::map<std::string, std::string> values;
+  auto read_file = [this](const std::string &key) { return util::read_file(getParamPath(key)); };
+  if (cache && cache->readAll(values, read_file)) {
+    return values;
+  }
+
+  // also repairs the slots and generation of a writer that died
   FileLock file_lock(params_path + "/.lock");
-  return util::read_files_in_dir(getParamPath());
+  values = util::read_files_in_dir(getParamPath());
+  if (cache) {
+    cache->fill(values);
+  }
+  return values;
 }
 
 void Params::clearAll(ParamKeyType key_type) {
@@ -370,15 +852,19 @@ void Params::clearAll(ParamKeyType key_type) {
   // 1) delete params of key_type
   // 2) delete files that are not defined in the keys.
   if (DIR *d = opendir(getParamPath().c_str())) {
+    if (cache) cache->beginWrite();
     struct dirent *de = NULL;
     while ((de = readdir(d))) {
       if (de->d_type != DT_DIR) {
         auto it = keys.find(de->d_name);
         if (it == keys.end() || (it->second & key_type)) {
-          unlink(getParamPath(de->d_name).c_str());
+          if (unlink(getParamPath(de->d_name).c_str()) == 0 && cache) {
+            cache->remove(de->d_name);
+          }
         }
       }
     }
+    if (cache) cache->endWrite();
     closedir(d);
   }
 
@@ -394,10 +880,14 @@ void Params::putNonBlocking(const std::string &key, const std::string &val) {
 }
 
 void Params::asyncWriteThread() {
-  // TODO: write the latest one if a key has multiple values in the queue.
+  // write everything queued so far as one batch, keeping the latest value of each key
   std::pair<std::string, std::string> p;
   while (queue.try_pop(p, 0)) {
-    // Params::put is Thread-Safe
-    put(p.first, p.second);
+    std::map<std::string, std::string> batch;
+    do {
+      batch[p.first] = std::move(p.second);
+    } while (queue.try_pop(p, 0));
+    // Params::putMany is Thread-Safe
+    putMany(batch);
   }
 }
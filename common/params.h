@@ -1,8 +1,11 @@
 #pragma once
 
+#include <functional>
 #include <future>
 #include <map>
+#include <memory>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <utility>
 #include <vector>
@@ -19,6 +22,9 @@ enum ParamKeyType {
   ALL = 0xFFFFFFFF
 };
 
+class ParamsCache;
+class ParamsWatcher;
+
 class Params {
 public:
   explicit Params(const std::string &path = {});
@@ -38,7 +44,8 @@ public:
   int remove(const std::string &key);
   void clearAll(ParamKeyType type);
 
-  // helpers for reading values
+  // helpers for reading values. they are served from a cache shared by all processes,
+  // which only sees writes made through Params, so never write the files directly.
   std::string get(const std::string &key, bool block = false);
   inline bool getBool(const std::string &key, bool block = false) {
     return get(key, block) == "1";
@@ -49,6 +56,13 @@ public:
   }
   std::map<std::string, std::string> readAll();
 
+  // wait until key has a value, returns an empty string after timeout_ms (-1 waits forever)
+  std::string waitFor(const std::string &key, int timeout_ms = -1);
+  // call fn from a background thread whenever one of keys is written or removed,
+  // until this Params is destroyed
+  typedef std::function<void(const std::string &key, const std::string &value)> WatchCallback;
+  void watch(const std::vector<std::string> &keys, WatchCallback fn);
+
   // helpers for writing values
   int put(const char *key, const char *val, size_t value_size);
   inline int put(const std::string &key, const std::string &val) {
@@ -60,6 +74,8 @@ public:
   inline int putInt(const std::string &key, int val) {
     return put(key.c_str(), std::to_string(val).c_str(), std::to_string(val).size());
   }
+  // write several values at once, with a single fsync of the directory
+  int putMany(const std::map<std::string, std::string> &values);
   void putNonBlocking(const std::string &key, const std::string &val);
   inline void putBoolNonBlocking(const std::string &key, bool val) {
     putNonBlocking(key, val ? "1" : "0");
@@ -71,11 +87,17 @@ public:
 
 private:
   void asyncWriteThread();
+  bool getCached(const std::string &key, std::string &value);
+  std::string cachePath() const;
 
   std::string params_path;
   std::string params_prefix;
+  std::shared_ptr<ParamsCache> cache;
 
   // for nonblocking write
   std::future<void> future;
   SafeQueue<std::pair<std::string, std::string>> queue;
+
+  std::vector<std::unique_ptr<ParamsWatcher>> watchers;
+  std::vector<std::thread> watch_threads;
 };
@@ -1,6 +1,7 @@
 # distutils: language = c++
 # cython: language_level = 3
 from libcpp cimport bool
+from libcpp.map cimport map
 from libcpp.string cimport string
 from libcpp.vector cimport vector
 
@@ -20,6 +21,7 @@ cdef extern from "common/params.h":
     int getInt(string, bool) nogil
     int remove(string) nogil
     int put(string, string) nogil
+    int putMany(map[string, string]) nogil
     void putNonBlocking(string, string) nogil
     void putBoolNonBlocking(string, bool) nogil
     void putIntNonBlocking(string, int) nogil
@@ -99,6 +101,17 @@ cdef class Params:
     with nogil:
       self.p.put(k, dat_bytes)
 
+  def put_many(self, dat):
+    """
+    Writes all of dat (a dict of key to value) with a single directory fsync.
+    Blocks until the params are written to disk, like put.
+    """
+    cdef map[string, string] values
+    for k, v in dat.items():
+      values[self.check_key(k)] = ensure_bytes(v)
+    with nogil:
+      self.p.putMany(values)
+
   def put_bool(self, key, bool val):
     cdef string k = self.check_key(key)
     with nogil:
@@ -1,8 +1,20 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <climits>
 #include <condition_variable>
+#include <cstdint>
 #include <mutex>
 #include <queue>
+#include <thread>
+#include <utility>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 template <class T>
 class SafeQueue {
@@ -50,3 +62,171 @@ private:
   std::condition_variable cv;
   std::queue<T> q;
 };
+
+// Bounded lock-free queue with the same pop/try_pop surface as SafeQueue, for hot paths.
+// Elements are moved in and out, so T may be move-only but has to be default constructible.
+// Only one thread may pop. With MultiProducer any number of threads may push, otherwise one.
+// Waiting for data (or for space when full) sleeps on a futex, which is only touched
+// when someone is waiting.
+template <class T, size_t N, bool MultiProducer>
+class RingQueue {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+  RingQueue() {
+    for (size_t i = 0; i < N; ++i) {
+      cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+  RingQueue(const RingQueue&) = delete;
+  RingQueue& operator=(const RingQueue&) = delete;
+
+  // returns false when full, v is only moved from when it was pushed
+  bool try_push(T&& v) {
+    return push_now(std::move(v));
+  }
+  bool try_push(const T& v) {
+    return push_now(v);
+  }
+
+  // waits while full
+  void push(T v) {
+    if (!push_now(std::move(v))) {
+      wait_until([&] { return push_now(std::move(v)); }, std::chrono::steady_clock::time_point::max());
+    }
+  }
+
+  T pop() {
+    T v{};
+    if (!pop_now(v)) {
+      wait_until([&] { return pop_now(v); }, std::chrono::steady_clock::time_point::max());
+    }
+    return v;
+  }
+
+  bool try_pop(T& v, int timeout_ms = 0) {
+    if (pop_now(v)) return true;
+    if (timeout_ms <= 0) return false;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    return wait_until([&] { return pop_now(v); }, deadline);
+  }
+
+  bool empty() const { return size() == 0; }
+  size_t size() const {
+    size_t tail = tail_.load(std::memory_order_acquire);
+    return head_.load(std::memory_order_acquire) - tail;
+  }
+  constexpr size_t capacity() const { return N; }
+
+private:
+  // each cell's sequence number says whose turn it is: the producer of position seq,
+  // or the consumer of position seq - 1 (https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue)
+  struct Cell {
+    std::atomic<size_t> seq;
+    T value;
+  };
+
+  template <class U>
+  bool push_now(U&& v) {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    Cell *cell = nullptr;
+    while (true) {
+      cell = &cells[pos & (N - 1)];
+      intptr_t diff = (intptr_t)cell->seq.load(std::memory_order_acquire) - (intptr_t)pos;
+      if (diff < 0) return false;  // full
+      if (diff > 0) {
+        pos = head_.load(std::memory_order_relaxed);
+      } else if (!MultiProducer) {
+        head_.store(pos + 1, std::memory_order_relaxed);
+        break;
+      } else if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    }
+    cell->value = std::forward<U>(v);
+    cell->seq.store(pos + 1, std::memory_order_release);
+    notify();
+    return true;
+  }
+
+  bool pop_now(T& v) {
+    const size_t pos = tail_.load(std::memory_order_relaxed);
+    Cell &cell = cells[pos & (N - 1)];
+    if (cell.seq.load(std::memory_order_acquire) != pos + 1) return false;  // empty
+
+    v = std::move(cell.value);
+    cell.seq.store(pos + N, std::memory_order_release);
+    tail_.store(pos + 1, std::memory_order_release);
+    notify();
+    return true;
+  }
+
+  void notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_relaxed) > 0) {
+      event.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+      syscall(SYS_futex, &event, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+      { std::scoped_lock lk(m); }
+      cv.notify_all();
+#endif
+    }
+  }
+
+  template <class Pred>
+  bool wait_until(Pred pred, std::chrono::steady_clock::time_point deadline) {
+    // the other side is usually just about to catch up, try a little before sleeping
+    for (int i = 0; i < 64; ++i) {
+      std::this_thread::yield();
+      if (pred()) return true;
+    }
+
+    waiters.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    bool ret = false;
+    while (true) {
+      uint32_t ev = event.load(std::memory_order_acquire);
+      if ((ret = pred())) break;
+
+      auto now = std::chrono::steady_clock::now();
+      if (now >= deadline) break;
+#ifdef __linux__
+      struct timespec ts = {}, *timeout = nullptr;
+      if (deadline != std::chrono::steady_clock::time_point::max()) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now).count();
+        ts = {.tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000};
+        timeout = &ts;
+      }
+      syscall(SYS_futex, &event, FUTEX_WAIT_PRIVATE, ev, timeout, nullptr, 0);
+#else
+      std::unique_lock lk(m);
+      auto changed = [&] { return event.load(std::memory_order_acquire) != ev; };
+      if (deadline == std::chrono::steady_clock::time_point::max()) {
+        cv.wait(lk, changed);
+      } else {
+        cv.wait_until(lk, deadline, changed);
+      }
+#endif
+    }
+    waiters.fetch_sub(1, std::memory_order_relaxed);
+    return ret;
+  }
+
+  Cell cells[N];
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+  alignas(64) std::atomic<uint32_t> event{0};
+  std::atomic<uint32_t> waiters{0};
+#ifndef __linux__
+  std::mutex m;
+  std::condition_variable cv;
+#endif
+};
+
+template <class T, size_t N>
+using SpscQueue = RingQueue<T, N, false>;
+
+template <class T, size_t N>
+using MpscQueue = RingQueue<T, N, true>;
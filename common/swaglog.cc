@@ -4,17 +4,51 @@
 
 #include "common/swaglog.h"
 
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+
+#include <atomic>
 #include <cassert>
 #include <limits>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 
 #include <zmq.h>
 #include <stdarg.h>
 #include "third_party/json11/json11.hpp"
+#include "common/queue.h"
+#include "common/trace.h"
+#include "common/util.h"
 #include "common/version.h"
 #include "system/hardware/hw.h"
 
+// Everything the caller knows about a message. The caller only formats the text,
+// the JSON is built and sent from the swaglog thread.
+struct LogRecord {
+  int levelnum;
+  const char *filename;
+  int lineno;
+  const char *func;
+  double created;
+  bool timestamp;  // LOGT event
+  uint64_t timestamp_ns;
+  uint32_t frame_id;
+  char msg[256];
+  std::string long_msg;  // only for messages that don't fit in msg
+
+  inline const char *text() const { return long_msg.empty() ? msg : long_msg.c_str(); }
+};
+
+static std::atomic<bool> swaglog_forked = false;
+
+class SwaglogState;
+static std::atomic<SwaglogState *> crash_state = nullptr;
+static struct sigaction prev_crash_actions[NSIG];
+static void crash_handler(int sig);
+
 class SwaglogState {
 public:
   SwaglogState() {
@@ -37,7 +71,7 @@ public:
       }
     }
 
-    ctx_j = json11::Json::object{};
+    json11::Json::object ctx_j = json11::Json::object{};
     if (char* dongle_id = getenv("DONGLE_ID")) {
       ctx_j["dongle_id"] = dongle_id;
     }
@@ -56,17 +90,120 @@ public:
     ctx_j["version"] = COMMA_VERSION;
     ctx_j["dirty"] = !getenv("CLEAN");
     ctx_j["device"] = Hardware::get_name();
+    // the context never changes, serialize it once
+    ctx_s = ((json11::Json)ctx_j).dump();
+
+    // the swaglog thread doesn't exist in a forked child, it logs synchronously instead
+    pthread_atfork(nullptr, nullptr, [] { swaglog_forked = true; });
+    thread.reset(new std::thread(&SwaglogState::run, this));
+
+    // what was logged right before a crash is the most interesting, it is sent before dying
+    crash_state = this;
+    struct sigaction sa = {};
+    sa.sa_handler = crash_handler;
+    for (int sig : {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT}) {
+      sigaction(sig, &sa, &prev_crash_actions[sig]);
+    }
   }
 
   ~SwaglogState() {
-    zmq_close(sock);
-    zmq_ctx_destroy(zctx);
+    crash_state = nullptr;
+    exit = true;
+    if (swaglog_forked) {
+      thread.release();
+    } else {
+      thread->join();
+    }
+    if (!flushed) {
+      zmq_close(sock);
+      zmq_ctx_destroy(zctx);
+    }
+  }
+
+  void log(LogRecord &&rec) {
+    if (swaglog_forked) {
+      std::lock_guard lk(lock);
+      send(rec);
+    } else if (!queue.try_push(std::move(rec))) {
+      ++dropped;
+    }
+  }
+
+  // called by the crash signal handler, waits up to 300ms for the swaglog thread to send what's queued
+  void flushOnCrash() {
+    if (swaglog_forked || std::this_thread::get_id() == thread->get_id()) return;
+    crashing = true;
+    for (int i = 0; i < 300 && !flushed; ++i) {
+      struct timespec ts = {.tv_sec = 0, .tv_nsec = 1000000};
+      nanosleep(&ts, nullptr);
+    }
+  }
+
+private:
+  void run() {
+    util::set_thread_name("swaglog");
+
+    LogRecord rec = {};
+    while (true) {
+      // read exit before popping, so nothing logged before exit is missed
+      const bool exiting = exit || crashing;
+      if (!queue.try_pop(rec, exiting ? 0 : 100)) {
+        if (exiting) break;
+        continue;
+      }
+
+      std::lock_guard lk(lock);
+      send(rec);
+
+      if (int n = dropped.exchange(0)) {
+        rec = {.levelnum = CLOUDLOG_WARNING, .filename = __FILE__, .lineno = __LINE__, .func = __func__,
+               .created = seconds_since_epoch()};
+        snprintf(rec.msg, sizeof(rec.msg), "swaglog: %d messages dropped", n);
+        send(rec);
+      }
+    }
+
+    if (crashing) {
+      // the process is about to die, wait for zmq to hand over the messages (up to ZMQ_LINGER)
+      zmq_close(sock);
+      zmq_ctx_term(zctx);
+      flushed = true;
+    }
   }
 
-  void log(int levelnum, const char* filename, int lineno, const char* func, const char* msg, const std::string& log_s) {
-    std::lock_guard lk(lock);
-    if (levelnum >= print_level) {
-      printf("%s: %s\n", filename, msg);
+  void send(const LogRecord &rec) {
+    // same as dumping a json11::Json::object, keys in sorted order
+    log_s.clear();
+    log_s += (char)rec.levelnum;
+    log_s += "{\"created\": ";
+    json11::Json(rec.created).dump(log_s);
+    log_s += ", \"ctx\": ";
+    log_s += ctx_s;
+    log_s += ", \"filename\": ";
+    json11::Json(rec.filename).dump(log_s);
+    log_s += ", \"funcname\": ";
+    json11::Json(rec.func).dump(log_s);
+    log_s += ", \"levelnum\": ";
+    json11::Json(rec.levelnum).dump(log_s);
+    log_s += ", \"lineno\": ";
+    json11::Json(rec.lineno).dump(log_s);
+    log_s += ", \"msg\": ";
+    if (rec.timestamp) {
+      json11::Json::object tspt_j = json11::Json::object{
+        {"event", rec.text()},
+        {"time", std::to_string(rec.timestamp_ns)}
+      };
+      if (rec.frame_id < std::numeric_limits<uint32_t>::max()) {
+        tspt_j["frame_id"] = std::to_string(rec.frame_id);
+      }
+      json11::Json(json11::Json::object{{"timestamp", tspt_j}}).dump(log_s);
+    } else {
+      json11::Json(rec.text()).dump(log_s);
+    }
+    log_s += "}";
+
+    if (rec.levelnum >= print_level) {
+      printf("%s: %s\n", rec.filename, rec.text());
     }
     zmq_send(sock, log_s.data(), log_s.length(), ZMQ_NOBLOCK);
   }
@@ -75,78 +212,77 @@ public:
   void* zctx = nullptr;
   void* sock = nullptr;
   int print_level;
-  json11::Json::object ctx_j;
+  std::string ctx_s;
+  std::string log_s;
+
+  // room for a burst of a few hundred messages
+  MpscQueue<LogRecord, 1024> queue;
+  std::atomic<int> dropped = 0;
+  std::atomic<bool> exit = false;
+  std::atomic<bool> crashing = false, flushed = false;
+  std::unique_ptr<std::thread> thread;
 };
 
+static void crash_handler(int sig) {
+  if (SwaglogState *s = crash_state) {
+    s->flushOnCrash();
+  }
+  // let the previous handler, or the default action, finish the crash
+  sigaction(sig, &prev_crash_actions[sig], nullptr);
+  raise(sig);
+}
+
 bool LOG_TIMESTAMPS = getenv("LOG_TIMESTAMPS");
 uint32_t NO_FRAME_ID = std::numeric_limits<uint32_t>::max();
 
-static void cloudlog_common(int levelnum, const char* filename, int lineno, const char* func,
-                            char* msg_buf, const json11::Json::object &msg_j={}) {
+static void cloudlog_common(LogRecord &rec, const char* fmt, va_list args) {
   static SwaglogState s;
 
-  json11::Json::object log_j = json11::Json::object {
-    {"ctx", s.ctx_j},
-    {"levelnum", levelnum},
-    {"filename", filename},
-    {"lineno", lineno},
-    {"funcname", func},
-    {"created", seconds_since_epoch()}
-  };
-  if (msg_j.empty()) {
-    log_j["msg"] = msg_buf;
-  } else {
-    log_j["msg"] = msg_j;
+  va_list args_copy;
+  va_copy(args_copy, args);
+  int ret = vsnprintf(rec.msg, sizeof(rec.msg), fmt, args);
+  if (ret >= (int)sizeof(rec.msg)) {
+    rec.long_msg.resize(ret);
+    vsnprintf(rec.long_msg.data(), ret + 1, fmt, args_copy);
   }
+  va_end(args_copy);
+  if (ret <= 0) return;
 
-  std::string log_s;
-  log_s += (char)levelnum;
-  ((json11::Json)log_j).dump(log_s);
-  s.log(levelnum, filename, lineno, func, msg_buf, log_s);
-
-  free(msg_buf);
+  rec.created = seconds_since_epoch();
+  s.log(std::move(rec));
 }
 
 void cloudlog_e(int levelnum, const char* filename, int lineno, const char* func,
                 const char* fmt, ...) {
+  LogRecord rec = {.levelnum = levelnum, .filename = filename, .lineno = lineno, .func = func};
   va_list args;
   va_start(args, fmt);
-  char* msg_buf = nullptr;
-  int ret = vasprintf(&msg_buf, fmt, args);
+  cloudlog_common(rec, fmt, args);
   va_end(args);
-  if (ret <= 0 || !msg_buf) return;
-  cloudlog_common(levelnum, filename, lineno, func, msg_buf);
 }
 
-void cloudlog_t_common(int levelnum, const char* filename, int lineno, const char* func,
+void cloudlog_t_common(TraceSite &site, int levelnum, const char* filename, int lineno, const char* func,
                        uint32_t frame_id, const char* fmt, va_list args) {
+  // the binary trace is always on, the format string names the event
+  trace_event(site, fmt, frame_id);
   if (!LOG_TIMESTAMPS) return;
-  char* msg_buf = nullptr;
-  int ret = vasprintf(&msg_buf, fmt, args);
-  if (ret <= 0 || !msg_buf) return;
-  json11::Json::object tspt_j = json11::Json::object{
-    {"event", msg_buf},
-    {"time", std::to_string(nanos_since_boot())}
-  };
-  if (frame_id < NO_FRAME_ID) {
-    tspt_j["frame_id"] = std::to_string(frame_id);
-  }
-  tspt_j = json11::Json::object{{"timestamp", tspt_j}};
-  cloudlog_common(levelnum, filename, lineno, func, msg_buf, tspt_j);
+  LogRecord rec = {.levelnum = levelnum, .filename = filename, .lineno = lineno, .func = func,
+                   .timestamp = true, .timestamp_ns = nanos_since_boot(), .frame_id = frame_id};
+  cloudlog_common(rec, fmt, args);
 }
 
 
-void cloudlog_te(int levelnum, const char* filename, int lineno, const char* func,
+void cloudlog_te(TraceSite &site, int levelnum, const char* filename, int lineno, const char* func,
                  const char* fmt, ...) {
   va_list args;
   va_start(args, fmt);
-  cloudlog_t_common(levelnum, filename, lineno, func, NO_FRAME_ID, fmt, args);
+  cloudlog_t_common(site, levelnum, filename, lineno, func, NO_FRAME_ID, fmt, args);
   va_end(args);
 }
-void cloudlog_te(int levelnum, const char* filename, int lineno, const char* func,
+void cloudlog_te(TraceSite &site, int levelnum, const char* filename, int lineno, const char* func,
                  uint32_t frame_id, const char* fmt, ...) {
   va_list args;
   va_start(args, fmt);
-  cloudlog_t_common(levelnum, filename, lineno, func, frame_id, fmt, args);
+  cloudlog_t_common(site, levelnum, filename, lineno, func, frame_id, fmt, args);
   va_end(args);
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common/timing.h"
+#include "common/trace.h"
 
 #define CLOUDLOG_DEBUG 10
 #define CLOUDLOG_INFO 20
@@ -18,20 +19,23 @@
 void cloudlog_e(int levelnum, const char* filename, int lineno, const char* func,
                 const char* fmt, ...) SWAG_LOG_CHECK_FMT(5, 6);
 
-void cloudlog_te(int levelnum, const char* filename, int lineno, const char* func,
-                 const char* fmt, ...) SWAG_LOG_CHECK_FMT(5, 6);
+void cloudlog_te(TraceSite &site, int levelnum, const char* filename, int lineno, const char* func,
+                 const char* fmt, ...) SWAG_LOG_CHECK_FMT(6, 7);
 
-void cloudlog_te(int levelnum, const char* filename, int lineno, const char* func,
-                 uint32_t frame_id, const char* fmt, ...) SWAG_LOG_CHECK_FMT(6, 7);
+void cloudlog_te(TraceSite &site, int levelnum, const char* filename, int lineno, const char* func,
+                 uint32_t frame_id, const char* fmt, ...) SWAG_LOG_CHECK_FMT(7, 8);
 
 
 #define cloudlog(lvl, fmt, ...) cloudlog_e(lvl, __FILE__, __LINE__, \
                                            __func__, \
                                            fmt, ## __VA_ARGS__)
 
-#define cloudlog_t(lvl, ...) cloudlog_te(lvl, __FILE__, __LINE__, \
-                                          __func__, \
-                                          __VA_ARGS__)
+// each call site keeps the trace event id of its format string
+#define cloudlog_t(lvl, ...) do {                              \
+  static TraceSite __trace_site;                               \
+  cloudlog_te(__trace_site, lvl, __FILE__, __LINE__, __func__, \
+              __VA_ARGS__);                                    \
+} while (0)
 
 
 #define cloudlog_rl(burst, millis, lvl, fmt, ...)   \
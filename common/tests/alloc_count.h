@@ -0,0 +1,33 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Counts heap allocations made through operator new, malloc and calloc (used by capnp for segments)
+// while count_allocs is set. This replaces the global allocation functions, so only one source file
+// of a test program may include it.
+static std::atomic<bool> count_allocs = false;
+static std::atomic<int> alloc_count = 0;
+
+void *operator new(size_t size) {
+  if (count_allocs) ++alloc_count;
+  void *p = malloc(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *malloc(size_t size) {
+  if (count_allocs) ++alloc_count;
+  return __libc_malloc(size);
+}
+extern "C" void *calloc(size_t n, size_t size) {
+  if (count_allocs) ++alloc_count;
+  return __libc_calloc(n, size);
+}
+#endif
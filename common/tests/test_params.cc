@@ -1,6 +1,9 @@
+#include <sys/wait.h>
+
 #include "catch2/catch.hpp"
 #define private public
 #include "common/params.h"
+#include "common/timing.h"
 #include "common/util.h"
 
 TEST_CASE("params_nonblocking_put") {
@@ -25,3 +28,163 @@ TEST_CASE("params_nonblocking_put") {
     REQUIRE(p.get(name) == "1");
   }
 }
+
+TEST_CASE("params_wait_for") {
+  char tmp_path[] = "/tmp/paramsWait_XXXXXX";
+  const std::string param_path = mkdtemp(tmp_path);
+  Params params(param_path);
+
+  SECTION("timeout") {
+    double start = millis_since_boot();
+    REQUIRE(params.waitFor("CarParams", 200).empty());
+    REQUIRE(millis_since_boot() - start >= 200);
+  }
+  SECTION("already set") {
+    params.put("CarParams", "1");
+    REQUIRE(params.waitFor("CarParams", 0) == "1");
+  }
+  SECTION("wake up latency after a put from another process") {
+    pid_t pid = fork();
+    if (pid == 0) {
+      Params p(param_path);
+      util::sleep_for(100);
+      p.put("IsMetric", "0");  // other keys don't satisfy the wait
+      p.put("CarParams", std::to_string(nanos_since_boot()));
+      _exit(0);
+    }
+    std::string value = params.waitFor("CarParams", 5000);
+    uint64_t woken = nanos_since_boot();
+    waitpid(pid, nullptr, 0);
+
+    REQUIRE(!value.empty());
+    // polling used to add up to 100 ms, not asserted on as it depends on the load of the machine
+    printf("params wake up latency after put: %.3f ms\n", (woken - std::stoull(value)) / 1e6);
+  }
+}
+
+TEST_CASE("params_watch") {
+  char tmp_path[] = "/tmp/paramsWatch_XXXXXX";
+  const std::string param_path = mkdtemp(tmp_path);
+  std::mutex lock;
+  std::map<std::string, std::string> latest;
+  int callback_cnt = 0;
+  {
+    Params params(param_path);
+    params.watch({"CarParams", "IsMetric"}, [&](const std::string &key, const std::string &value) {
+      std::lock_guard lk(lock);
+      latest[key] = value;
+      ++callback_cnt;
+    });
+
+    Params writer(param_path);
+    writer.put("CarParams", "1");
+    writer.put("LastUpdateTime", "2");
+    writer.put("IsMetric", "3");
+    writer.remove("CarParams");
+    for (int i = 0; i < 500; ++i) {
+      {
+        std::lock_guard lk(lock);
+        auto it = latest.find("CarParams");
+        if (latest.size() == 2 && it != latest.end() && it->second.empty()) break;
+      }
+      util::sleep_for(10);
+    }
+  }
+  // each key is reported with its value at the time, only the watched keys are
+  REQUIRE(latest == std::map<std::string, std::string>{{"CarParams", ""}, {"IsMetric", "3"}});
+  REQUIRE(callback_cnt >= 2);
+}
+
+TEST_CASE("params_cache") {
+  char tmp_path[] = "/tmp/paramsCache_XXXXXX";
+  const std::string param_path = mkdtemp(tmp_path);
+  Params params(param_path);
+  REQUIRE(params.cache);
+
+  SECTION("shared between processes") {
+    REQUIRE(params.get("CarParams").empty());
+    pid_t pid = fork();
+    if (pid == 0) {
+      Params p(param_path);
+      p.put("CarParams", "1");
+      p.remove("IsMetric");
+      _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+    REQUIRE(params.get("CarParams") == "1");
+    REQUIRE(params.get("IsMetric").empty());
+  }
+  SECTION("a writer died while updating a slot") {
+    params.put("CarParams", "1");
+    REQUIRE(params.get("CarParams") == "1");
+
+    // a slot's seqlock is its first word, the slots follow a page sized header in key order
+    auto keys = params.allKeys();
+    std::sort(keys.begin(), keys.end());
+    const off_t seq_offset = 4096 * (1 + (std::find(keys.begin(), keys.end(), "CarParams") - keys.begin()));
+    int fd = open(params.cachePath().c_str(), O_RDWR);
+    REQUIRE(fd >= 0);
+    uint32_t seq = 0;
+    REQUIRE(pread(fd, &seq, sizeof(seq), seq_offset) == sizeof(seq));
+    seq |= 1;
+    REQUIRE(pwrite(fd, &seq, sizeof(seq), seq_offset) == sizeof(seq));
+
+    // read from the file, and the slot is usable again
+    REQUIRE(params.get("CarParams") == "1");
+    REQUIRE(pread(fd, &seq, sizeof(seq), seq_offset) == sizeof(seq));
+    REQUIRE((seq & 1) == 0);
+    REQUIRE(params.readAll() == std::map<std::string, std::string>{{"CarParams", "1"}});
+    close(fd);
+  }
+  SECTION("values too large for the cache") {
+    std::string large(10000, 'a');
+    params.put("CarParams", large);
+    REQUIRE(params.get("CarParams") == large);
+    REQUIRE(params.readAll()["CarParams"] == large);
+    REQUIRE(params.readAll()["CarParams"] == large);
+  }
+  SECTION("readAll") {
+    params.put("CarParams", "1");
+    params.put("IsMetric", "");
+    std::map<std::string, std::string> expected = {{"CarParams", "1"}, {"IsMetric", ""}};
+    REQUIRE(params.readAll() == expected);
+    REQUIRE(params.readAll() == expected);
+
+    // unknown keys can't be cached, those are read from disk
+    params.put("UnknownKey", "2");
+    expected["UnknownKey"] = "2";
+    REQUIRE(params.readAll() == expected);
+    params.remove("CarParams");
+    expected.erase("CarParams");
+    REQUIRE(params.readAll() == expected);
+    params.clearAll(ALL);
+    REQUIRE(params.readAll().empty());
+  }
+  SECTION("recreated directory") {
+    params.put("CarParams", "1");
+    std::string real_path = util::readlink(params.getParamPath());
+    REQUIRE(system(("rm -rf " + real_path + " " + params.getParamPath()).c_str()) == 0);
+
+    Params p(param_path);
+    REQUIRE(p.cache != params.cache);
+    REQUIRE(p.get("CarParams").empty());
+    REQUIRE(p.readAll().empty());
+    // the cache of the removed directory is removed with it
+    REQUIRE(util::file_exists(p.cachePath()));
+    REQUIRE(!util::file_exists(params.cachePath()));
+  }
+}
+
+TEST_CASE("params_put_many") {
+  char tmp_path[] = "/tmp/paramsPutMany_XXXXXX";
+  const std::string param_path = mkdtemp(tmp_path);
+  const std::map<std::string, std::string> values = {{"CarParams", "1"}, {"IsMetric", "2"}, {"UnknownKey", "3"}};
+  {
+    Params params(param_path);
+    REQUIRE(params.putMany(values) == 0);
+    REQUIRE(params.get("IsMetric") == "2");
+  }
+  Params params(param_path);
+  REQUIRE(params.readAll() == values);
+  REQUIRE(util::read_files_in_dir(params.getParamPath()) == values);
+}
@@ -40,6 +40,14 @@ class TestParams:
     assert self.params.get("DongleId") == b"bob"
     assert self.params.get("AthenadPid") == b"123"
 
+  def test_params_put_many(self):
+    self.params.put_many({"DongleId": "bob", "AthenadPid": b"123"})
+    assert self.params.get("DongleId") == b"bob"
+    assert self.params.get("AthenadPid") == b"123"
+
+    with pytest.raises(UnknownKeyName):
+      self.params.put_many({"swag": "abc"})
+
   def test_params_get_block(self):
     def _delayed_writer():
       time.sleep(0.1)
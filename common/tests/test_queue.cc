@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "common/queue.h"
+#include "common/timing.h"
+#include "common/util.h"
+
+TEST_CASE("SpscQueue") {
+  SpscQueue<std::string, 4> q;
+  REQUIRE(q.empty());
+  REQUIRE(q.capacity() == 4);
+
+  for (int i = 0; i < 4; ++i) {
+    REQUIRE(q.try_push(std::to_string(i)));
+  }
+  REQUIRE(q.size() == 4);
+  REQUIRE_FALSE(q.try_push("4"));
+  // a value that isn't pushed is left alone
+  std::string full = "4";
+  REQUIRE_FALSE(q.try_push(std::move(full)));
+  REQUIRE(full == "4");
+
+  std::string v;
+  for (int i = 0; i < 4; ++i) {
+    REQUIRE(q.try_pop(v));
+    REQUIRE(v == std::to_string(i));
+  }
+  REQUIRE_FALSE(q.try_pop(v));
+  REQUIRE(q.empty());
+
+  SECTION("try_pop timeout") {
+    double start = millis_since_boot();
+    REQUIRE_FALSE(q.try_pop(v, 100));
+    REQUIRE(millis_since_boot() - start >= 100);
+  }
+  SECTION("blocking pop and push") {
+    const int n = 100000;
+    std::thread producer([&]() {
+      for (int i = 0; i < n; ++i) q.push(std::to_string(i));
+    });
+    for (int i = 0; i < n; ++i) {
+      REQUIRE(q.pop() == std::to_string(i));
+    }
+    producer.join();
+  }
+}
+
+TEST_CASE("MpscQueue") {
+  MpscQueue<std::unique_ptr<int>, 64> q;
+  const int producers = 4, n = 50000;
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p]() {
+      for (int i = 0; i < n; ++i) q.push(std::make_unique<int>(p * n + i));
+    });
+  }
+
+  // every item arrives once, in order per producer
+  std::vector<int> last(producers, -1);
+  for (int i = 0; i < producers * n; ++i) {
+    std::unique_ptr<int> v;
+    REQUIRE(q.try_pop(v, 1000));
+    int p = *v / n;
+    REQUIRE(*v % n == last[p] + 1);
+    last[p] = *v % n;
+  }
+  for (auto &t : threads) t.join();
+  REQUIRE(q.empty());
+
+  SECTION("try_push when full") {
+    for (size_t i = 0; i < q.capacity(); ++i) {
+      REQUIRE(q.try_push(std::make_unique<int>(i)));
+    }
+    auto v = std::make_unique<int>(-1);
+    REQUIRE_FALSE(q.try_push(std::move(v)));
+    REQUIRE(v != nullptr);
+  }
+}
+
+struct QueueBenchmark {
+  double items_per_sec;
+  uint64_t p50_ns, p99_ns, max_ns;
+};
+
+template <class Queue>
+QueueBenchmark run_queue_benchmark(Queue &q, int producers, int n) {
+  std::vector<uint64_t> latency(producers * n);
+  std::vector<std::thread> threads;
+  uint64_t start = nanos_since_boot();
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < n; ++i) q.push(nanos_since_boot());
+    });
+  }
+  for (auto &l : latency) {
+    uint64_t sent = q.pop();
+    l = nanos_since_boot() - sent;
+  }
+  uint64_t elapsed = nanos_since_boot() - start;
+  for (auto &t : threads) t.join();
+
+  std::sort(latency.begin(), latency.end());
+  return {
+    .items_per_sec = latency.size() / (elapsed / 1e9),
+    .p50_ns = latency[latency.size() / 2],
+    .p99_ns = latency[latency.size() * 99 / 100],
+    .max_ns = latency.back(),
+  };
+}
+
+TEST_CASE("queue_benchmark", "[.][benchmark]") {
+  const int n = 1000000;
+  auto report = [](const char *name, int producers, const QueueBenchmark &b) {
+    printf("%-12s %d producers: %6.2f M items/s, latency p50 %6lu ns, p99 %8lu ns, max %9lu ns\n",
+           name, producers, b.items_per_sec / 1e6, b.p50_ns, b.p99_ns, b.max_ns);
+  };
+
+  for (int producers : {1, 4}) {
+    auto safe_queue = std::make_unique<SafeQueue<uint64_t>>();
+    report("SafeQueue", producers, run_queue_benchmark(*safe_queue, producers, n / producers));
+    if (producers == 1) {
+      auto spsc_queue = std::make_unique<SpscQueue<uint64_t, 1024>>();
+      report("SpscQueue", producers, run_queue_benchmark(*spsc_queue, producers, n / producers));
+    }
+    auto mpsc_queue = std::make_unique<MpscQueue<uint64_t, 1024>>();
+    report("MpscQueue", producers, run_queue_benchmark(*mpsc_queue, producers, n / producers));
+  }
+}
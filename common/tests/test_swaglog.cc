@@ -1,5 +1,9 @@
+#include <sys/resource.h>
+#include <sys/wait.h>
 #include <zmq.h>
 
+#include <algorithm>
+#include <csignal>
 #include <iostream>
 
 #include "catch2/catch.hpp"
@@ -86,3 +90,123 @@ TEST_CASE("swaglog") {
 
   recv_log(thread_cnt, thread_msg_cnt);
 }
+
+TEST_CASE("swaglog long message") {
+  void *zctx = zmq_ctx_new();
+  void *sock = zmq_socket(zctx, ZMQ_PULL);
+  zmq_bind(sock, Path::swaglog_ipc().c_str());
+
+  // longer than the preallocated message buffer
+  std::string long_msg(2000, 'a');
+  LOGE("%s", long_msg.c_str());
+
+  std::string msg;
+  for (int i = 0; i < 100 && msg.empty(); ++i) {
+    char buf[4096] = {};
+    if (zmq_recv(sock, buf, sizeof(buf), ZMQ_DONTWAIT) > 0) {
+      std::string err;
+      msg = json11::Json::parse(buf + 1, err)["msg"].string_value();
+    }
+    util::sleep_for(10);
+  }
+  REQUIRE(msg == long_msg);
+  zmq_close(sock);
+  zmq_ctx_destroy(zctx);
+}
+
+// receives until count messages arrived or nothing arrived for a second, returns their levels
+std::vector<int> recv_levels(void *sock, int count) {
+  std::vector<int> levels;
+  for (int i = 0; i < 100 && levels.size() < count; ) {
+    char buf[4096] = {};
+    if (zmq_recv(sock, buf, sizeof(buf), ZMQ_DONTWAIT) > 0) {
+      levels.push_back(buf[0]);
+    } else {
+      util::sleep_for(10);
+      ++i;
+    }
+  }
+  return levels;
+}
+
+TEST_CASE("swaglog errors are queued in order") {
+  void *zctx = zmq_ctx_new();
+  void *sock = zmq_socket(zctx, ZMQ_PULL);
+  zmq_bind(sock, Path::swaglog_ipc().c_str());
+
+  const int queued_cnt = 500;
+  for (int i = 0; i < queued_cnt; ++i) {
+    LOGD("%d", i);
+  }
+  LOGE("error");
+
+  auto levels = recv_levels(sock, queued_cnt + 1);
+  REQUIRE(levels.size() == queued_cnt + 1);
+  REQUIRE(std::count(levels.begin(), levels.end(), CLOUDLOG_DEBUG) == queued_cnt);
+  REQUIRE(levels.back() == CLOUDLOG_ERROR);
+  zmq_close(sock);
+  zmq_ctx_destroy(zctx);
+}
+
+// run in a new process by the test below
+TEST_CASE("swaglog crashing process", "[.]") {
+  for (int i = 0; i < 500; ++i) {
+    LOGD("%d", i);
+  }
+  LOGE("error");
+  abort();
+}
+
+TEST_CASE("swaglog sends what is queued when the process crashes") {
+  void *zctx = zmq_ctx_new();
+  void *sock = zmq_socket(zctx, ZMQ_PULL);
+  zmq_bind(sock, Path::swaglog_ipc().c_str());
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    // a fresh process, the swaglog thread doesn't survive a fork
+    struct rlimit no_core = {};
+    setrlimit(RLIMIT_CORE, &no_core);
+    freopen("/dev/null", "w", stdout);
+    execl("/proc/self/exe", "/proc/self/exe", "swaglog crashing process", nullptr);
+    _exit(1);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  REQUIRE(WIFSIGNALED(status));
+  REQUIRE(WTERMSIG(status) == SIGABRT);
+
+  auto levels = recv_levels(sock, 501);
+  REQUIRE(levels.size() == 501);
+  REQUIRE(levels.back() == CLOUDLOG_ERROR);
+  zmq_close(sock);
+  zmq_ctx_destroy(zctx);
+}
+
+TEST_CASE("swaglog_benchmark", "[.][benchmark]") {
+  const int calls = 100000;
+  for (int thread_cnt : {1, 4}) {
+    std::vector<std::vector<uint64_t>> latency(thread_cnt, std::vector<uint64_t>(calls));
+    std::vector<std::thread> threads;
+    uint64_t start = nanos_since_boot();
+    for (int i = 0; i < thread_cnt; ++i) {
+      threads.emplace_back([&, i]() {
+        for (auto &l : latency[i]) {
+          uint64_t t = nanos_since_boot();
+          LOGD("benchmark %d %s", i, "some text");
+          l = nanos_since_boot() - t;
+          // stay below the rate the swaglog thread can ship
+          usleep(5);
+        }
+      });
+    }
+    for (auto &t : threads) t.join();
+    double elapsed_s = (nanos_since_boot() - start) / 1e9;
+
+    std::vector<uint64_t> all;
+    for (auto &l : latency) all.insert(all.end(), l.begin(), l.end());
+    std::sort(all.begin(), all.end());
+    printf("%d threads: %.0f calls/s, caller latency p50 %lu ns, p99 %lu ns, max %lu ns\n", thread_cnt,
+           all.size() / elapsed_s, all[all.size() / 2], all[all.size() * 99 / 100], all.back());
+  }
+}
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "common/swaglog.h"
+#include "common/timing.h"
+#include "common/trace.h"
+#include "common/util.h"
+
+TEST_CASE("trace_event") {
+  uint64_t start = nanos_since_boot();
+  trace_event("test: start", 1);
+  const TraceHeader *h = trace_ring();
+  REQUIRE(h != nullptr);
+  REQUIRE(h->magic == TRACE_MAGIC);
+  REQUIRE(h->pid == (uint32_t)getpid());
+  REQUIRE(util::file_exists(util::string_format("/dev/shm/trace%s_%d", util::getenv("OPENPILOT_PREFIX", "").c_str(), getpid())));
+
+  const uint64_t head = h->head;
+  const int threads_cnt = 4, events_cnt = TRACE_RING_SIZE;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < threads_cnt; ++i) {
+    threads.emplace_back([=]() {
+      for (int j = 0; j < events_cnt; ++j) {
+        trace_event(i % 2 ? "test: odd" : "test: even", j);
+      }
+    });
+  }
+  for (auto &t : threads) t.join();
+  REQUIRE(h->head == head + threads_cnt * events_cnt);
+
+  // names are registered once, in order of first use
+  REQUIRE(h->event_count >= 3);
+  std::vector<std::string> names(h->events, h->events + h->event_count);
+  REQUIRE(std::count(names.begin(), names.end(), "test: odd") == 1);
+  REQUIRE(std::count(names.begin(), names.end(), "test: even") == 1);
+
+  // the ring holds the newest events, all complete
+  const TraceRecord *records = (const TraceRecord *)((const char *)h + 4096);
+  for (uint64_t idx = h->head - TRACE_RING_SIZE; idx < h->head; ++idx) {
+    const TraceRecord &r = records[idx % TRACE_RING_SIZE];
+    REQUIRE(r.seq == 2 * idx + 2);
+    REQUIRE(r.nanos >= start);
+    REQUIRE(r.frame_id < events_cnt);
+    std::string name = h->events[r.event_id];
+    REQUIRE((name == "test: odd" || name == "test: even"));
+  }
+}
+
+TEST_CASE("trace_event sites") {
+  const TraceHeader *h = trace_ring();
+  REQUIRE(h != nullptr);
+  const TraceRecord *records = (const TraceRecord *)((const char *)h + 4096);
+  auto last_event = [&]() { return std::string(h->events[records[(h->head - 1) % TRACE_RING_SIZE].event_id]); };
+
+  TraceSite site;
+  for (int i = 0; i < 3; ++i) {
+    trace_event(site, "test: site", i);
+  }
+  REQUIRE(site.id >= 0);
+  REQUIRE(std::string(h->events[site.id]) == "test: site");
+  REQUIRE(last_event() == "test: site");
+
+  // another name at the same site is looked up
+  trace_event(site, "test: other name", 0);
+  REQUIRE(last_event() == "test: other name");
+  trace_event(site, "test: site", 0);
+  REQUIRE(last_event() == "test: site");
+
+  for (int i = 0; i < 2; ++i) {
+    LOGT(i, "test: LOGT");
+    REQUIRE(last_event() == "test: LOGT");
+  }
+}
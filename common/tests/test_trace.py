@@ -0,0 +1,42 @@
+import os
+
+from openpilot.common.trace import TRACE_NO_FRAME_ID, TRACE_RING_SIZE, open_rings, trace
+
+
+class TestTrace:
+  def test_write_and_drain(self):
+    trace("test: first", 1)
+    ring = open_rings()[os.path.join("/dev/shm", f"trace{os.getenv('OPENPILOT_PREFIX', '')}_{os.getpid()}")]
+    assert ring.valid()
+    pid, _, event_count, _ = ring.header()
+    assert pid == os.getpid()
+    assert event_count >= 1
+    ring.drain()
+
+    for i in range(10):
+      trace("test: frame", i)
+    trace("test: no frame")
+    records, lost = ring.drain()
+    assert lost == 0
+    assert [r[1] for r in records] == list(range(10)) + [TRACE_NO_FRAME_ID]
+    assert {ring.event_name(r[2]) for r in records} == {"test: frame", "test: no frame"}
+    assert all(r[3] == records[0][3] for r in records)
+    assert all(a[0] <= b[0] for a, b in zip(records, records[1:], strict=False))
+
+  def test_overwrite(self):
+    trace("test: first")
+    ring = open_rings()[os.path.join("/dev/shm", f"trace{os.getenv('OPENPILOT_PREFIX', '')}_{os.getpid()}")]
+    ring.drain()
+    for i in range(TRACE_RING_SIZE + 100):
+      trace("test: frame", i)
+    records, lost = ring.drain()
+    assert lost == 100
+    assert records[-1][1] == TRACE_RING_SIZE + 99
+
+  def test_no_ring(self, mocker):
+    mocker.patch("openpilot.common.trace._ring", None)
+    mocker.patch("openpilot.common.trace.TRACE_DIR", "/nonexistent")
+    warning = mocker.patch("openpilot.common.swaglog.cloudlog.warning")
+    for i in range(10):
+      trace("test: frame", i)
+    assert warning.call_count == 1
@@ -0,0 +1,136 @@
+#include "common/trace.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+#include "common/timing.h"
+#include "common/util.h"
+
+namespace {
+
+#ifdef __APPLE__
+const char *TRACE_DIR = "/tmp";
+#else
+const char *TRACE_DIR = "/dev/shm";
+#endif
+
+class TraceRing {
+public:
+  TraceRing() {
+    const std::string prefix = "trace" + util::getenv("OPENPILOT_PREFIX", "") + "_";
+    removeStaleRings(prefix);
+
+    const std::string path = util::string_format("%s/%s%d", TRACE_DIR, prefix.c_str(), getpid());
+    const size_t size = 4096 + TRACE_RING_SIZE * sizeof(TraceRecord);
+    int fd = HANDLE_EINTR(open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666));
+    if (fd < 0) return;
+    void *ptr = ftruncate(fd, size) == 0 ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (ptr == MAP_FAILED) {
+      unlink(path.c_str());
+      return;
+    }
+
+    header = (TraceHeader *)ptr;
+    records = (TraceRecord *)((char *)ptr + 4096);
+    header->capacity = TRACE_RING_SIZE;
+    header->pid = getpid();
+    std::string process = util::getenv("MANAGER_DAEMON", util::read_file("/proc/self/comm"));
+    process.erase(process.find_last_not_of("\n") + 1);
+    strncpy(header->process, process.c_str(), sizeof(header->process) - 1);
+    // readers ignore the ring until the magic is set
+    __atomic_store_n(&header->magic, TRACE_MAGIC, __ATOMIC_RELEASE);
+  }
+
+  void write(int event_id, uint32_t frame_id) {
+    if (!header || event_id < 0) return;
+
+    static thread_local uint32_t tid = syscall(SYS_gettid);
+    const uint64_t idx = __atomic_fetch_add(&header->head, 1, __ATOMIC_RELAXED);
+    TraceRecord &r = records[idx & (TRACE_RING_SIZE - 1)];
+    __atomic_store_n(&r.seq, 2 * idx + 1, __ATOMIC_RELAXED);
+    std::atomic_thread_fence(std::memory_order_release);
+    r.nanos = nanos_since_boot();
+    r.frame_id = frame_id;
+    r.event_id = event_id;
+    r.tid = tid;
+    __atomic_store_n(&r.seq, 2 * idx + 2, __ATOMIC_RELEASE);
+  }
+
+  // -1 if there's no ring or no room for another name
+  int eventId(const char *name) {
+    if (!header) return -1;
+    // string literals keep their address, so the common case is a pointer compare
+    const int count = __atomic_load_n(&header->event_count, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < count; ++i) {
+      if (names[i].load(std::memory_order_relaxed) == name) return i;
+    }
+
+    std::lock_guard lk(lock);
+    for (int i = 0; i < (int)header->event_count; ++i) {
+      if (strncmp(header->events[i], name, TRACE_EVENT_NAME_SIZE - 1) == 0) return i;
+    }
+    const int id = header->event_count;
+    if (id == TRACE_MAX_EVENTS) return -1;
+    strncpy(header->events[id], name, TRACE_EVENT_NAME_SIZE - 1);
+    names[id] = name;
+    __atomic_store_n(&header->event_count, id + 1, __ATOMIC_RELEASE);
+    return id;
+  }
+
+  TraceHeader *header = nullptr;
+
+private:
+  // rings of processes that are gone, the collector may not be running to remove them
+  static void removeStaleRings(const std::string &prefix) {
+    if (DIR *d = opendir(TRACE_DIR)) {
+      while (struct dirent *de = readdir(d)) {
+        if (strncmp(de->d_name, prefix.c_str(), prefix.size()) != 0) continue;
+        int pid = atoi(de->d_name + prefix.size());
+        if (pid > 0 && kill(pid, 0) != 0 && errno == ESRCH) {
+          unlink((std::string(TRACE_DIR) + "/" + de->d_name).c_str());
+        }
+      }
+      closedir(d);
+    }
+  }
+
+  TraceRecord *records = nullptr;
+  std::mutex lock;
+  std::atomic<const char *> names[TRACE_MAX_EVENTS] = {};
+};
+
+TraceRing &ring() {
+  static TraceRing r;
+  return r;
+}
+
+}  // namespace
+
+void trace_event(const char *name, uint32_t frame_id) {
+  TraceRing &r = ring();
+  r.write(r.eventId(name), frame_id);
+}
+
+void trace_event(TraceSite &site, const char *name, uint32_t frame_id) {
+  TraceRing &r = ring();
+  std::call_once(site.once, [&] {
+    site.name = name;
+    site.id = r.eventId(name);
+  });
+  r.write(name == site.name ? site.id : r.eventId(name), frame_id);
+}
+
+const TraceHeader *trace_ring() {
+  return ring().header;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+// Always-on binary trace events. Every process writes fixed size records into its
+// own shared memory ring (/dev/shm/trace<prefix>_<pid>), which never blocks and
+// overwrites the oldest events. tools/latencylogger/trace_collector.py drains the
+// rings of all processes into a Chrome trace. The layout is shared with common/trace.py.
+
+#define TRACE_MAGIC 0x31435254  // "TRC1"
+#define TRACE_RING_SIZE 4096    // records, a power of two
+#define TRACE_MAX_EVENTS 64     // distinct event names per process
+#define TRACE_EVENT_NAME_SIZE 56
+#define TRACE_NO_FRAME_ID UINT32_MAX
+
+struct TraceHeader {
+  uint32_t magic;
+  uint32_t capacity;
+  uint32_t pid;
+  uint32_t event_count;  // names registered so far
+  uint64_t head;         // records written so far
+  char process[40];
+  char events[TRACE_MAX_EVENTS][TRACE_EVENT_NAME_SIZE];
+};
+
+struct TraceRecord {
+  uint64_t seq;  // 2 * index + 1 while being written, 2 * index + 2 once complete
+  uint64_t nanos;  // nanos_since_boot
+  uint32_t frame_id;
+  uint16_t event_id;  // index into TraceHeader::events
+  uint16_t reserved;
+  uint32_t tid;
+  uint32_t reserved2;
+};
+
+static_assert(sizeof(TraceHeader) <= 4096, "the records start at 4096");
+static_assert(sizeof(TraceRecord) == 32);
+
+// A call site of trace_event, which looks up the id of its name only once. See LOGT.
+struct TraceSite {
+  std::once_flag once;
+  const char *name = nullptr;
+  int id = -1;
+};
+
+// name is usually a string literal, events with the same name share an id
+void trace_event(const char *name, uint32_t frame_id = TRACE_NO_FRAME_ID);
+// same, with the id of the site's first name. other names are still looked up.
+void trace_event(TraceSite &site, const char *name, uint32_t frame_id = TRACE_NO_FRAME_ID);
+// the ring of the calling process, nullptr if it couldn't be created
+const TraceHeader *trace_ring();
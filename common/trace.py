@@ -0,0 +1,153 @@
+"""Always-on binary trace events, written to a per-process shared memory ring.
+
+The ring layout is shared with common/trace.h, which documents it.
+tools/latencylogger/trace_collector.py drains the rings of all processes.
+"""
+import mmap
+import os
+import struct
+import sys
+import threading
+import time
+
+TRACE_MAGIC = 0x31435254
+TRACE_RING_SIZE = 4096
+TRACE_MAX_EVENTS = 64
+TRACE_EVENT_NAME_SIZE = 56
+TRACE_NO_FRAME_ID = 0xFFFFFFFF
+
+HEADER = struct.Struct("<IIIIQ40s")  # magic, capacity, pid, event_count, head, process
+RECORD = struct.Struct("<QQIHHII")  # seq, nanos, frame_id, event_id, reserved, tid, reserved
+HEADER_SIZE = 4096
+RING_FILE_SIZE = HEADER_SIZE + TRACE_RING_SIZE * RECORD.size
+TRACE_DIR = "/tmp" if os.uname().sysname == "Darwin" else "/dev/shm"
+CLOCK = getattr(time, "CLOCK_BOOTTIME", time.CLOCK_MONOTONIC)
+
+
+def ring_prefix():
+  return f"trace{os.getenv('OPENPILOT_PREFIX', '')}_"
+
+
+class TraceRing:
+  def __init__(self, path, create=False):
+    self.path = path
+    flags = os.O_RDWR | os.O_CREAT | os.O_TRUNC if create else os.O_RDONLY
+    fd = os.open(path, flags, 0o666)
+    try:
+      if create:
+        os.ftruncate(fd, RING_FILE_SIZE)
+      self.buf = mmap.mmap(fd, RING_FILE_SIZE, prot=mmap.PROT_READ | (mmap.PROT_WRITE if create else 0))
+    except OSError:
+      if create:
+        os.unlink(path)
+      raise
+    finally:
+      os.close(fd)
+    self.read_pos = None
+
+  # reading
+  def valid(self):
+    return HEADER.unpack_from(self.buf, 0)[0] == TRACE_MAGIC
+
+  def header(self):
+    magic, capacity, pid, event_count, head, process = HEADER.unpack_from(self.buf, 0)
+    return pid, process.split(b"\0")[0].decode(), event_count, head
+
+  def event_name(self, event_id):
+    offset = HEADER.size + event_id * TRACE_EVENT_NAME_SIZE
+    return self.buf[offset:offset + TRACE_EVENT_NAME_SIZE].split(b"\0")[0].decode(errors="replace")
+
+  def drain(self):
+    """Returns the complete records written since the last call, and how many were lost."""
+    _, _, _, head = self.header()
+    if self.read_pos is None:
+      self.read_pos = max(0, head - TRACE_RING_SIZE)
+    lost = max(0, head - TRACE_RING_SIZE - self.read_pos)
+    records = []
+    for idx in range(self.read_pos + lost, head):
+      offset = HEADER_SIZE + (idx % TRACE_RING_SIZE) * RECORD.size
+      seq, nanos, frame_id, event_id, _, tid, _ = RECORD.unpack_from(self.buf, offset)
+      # torn, still being written, or already overwritten
+      if seq != 2 * idx + 2 or struct.unpack_from("<Q", self.buf, offset)[0] != seq:
+        lost += 1
+        continue
+      records.append((nanos, frame_id, event_id, tid))
+    self.read_pos = head
+    return records, lost
+
+  # writing, only from the process that created the ring
+  @classmethod
+  def create(cls, process):
+    ring = cls(os.path.join(TRACE_DIR, f"{ring_prefix()}{os.getpid()}"), create=True)
+    ring.pid = os.getpid()
+    ring.event_ids = {}
+    HEADER.pack_into(ring.buf, 0, 0, TRACE_RING_SIZE, ring.pid, 0, 0, process.encode()[:39])
+    # readers ignore the ring until the magic is set
+    struct.pack_into("<I", ring.buf, 0, TRACE_MAGIC)
+    return ring
+
+  def write(self, name, frame_id):
+    event_id = self.event_ids.get(name)
+    if event_id is None:
+      event_id = self.event_ids[name] = len(self.event_ids)
+      if event_id >= TRACE_MAX_EVENTS:
+        return
+      offset = HEADER.size + event_id * TRACE_EVENT_NAME_SIZE
+      self.buf[offset:offset + TRACE_EVENT_NAME_SIZE] = name.encode()[:TRACE_EVENT_NAME_SIZE - 1].ljust(TRACE_EVENT_NAME_SIZE, b"\0")
+      struct.pack_into("<I", self.buf, 12, event_id + 1)
+    elif event_id >= TRACE_MAX_EVENTS:
+      return
+
+    idx = struct.unpack_from("<Q", self.buf, 16)[0]
+    struct.pack_into("<Q", self.buf, 16, idx + 1)
+    offset = HEADER_SIZE + (idx % TRACE_RING_SIZE) * RECORD.size
+    struct.pack_into("<Q", self.buf, offset, 2 * idx + 1)
+    RECORD.pack_into(self.buf, offset, 2 * idx + 1, time.clock_gettime_ns(CLOCK), frame_id, event_id, 0, threading.get_native_id(), 0)
+    struct.pack_into("<Q", self.buf, offset, 2 * idx + 2)
+
+  def close(self):
+    self.buf.close()
+
+
+class NullRing:
+  """Stands in for the ring of a process that couldn't create one, tracing is off there."""
+  def __init__(self):
+    self.pid = os.getpid()
+
+  def write(self, name, frame_id):
+    pass
+
+
+_lock = threading.Lock()
+_ring: TraceRing | NullRing | None = None
+
+
+def trace(name: str, frame_id: int = TRACE_NO_FRAME_ID) -> None:
+  global _ring
+  error = None
+  with _lock:
+    # a forked child gets a ring of its own
+    if _ring is None or _ring.pid != os.getpid():
+      try:
+        _ring = TraceRing.create(os.getenv("MANAGER_DAEMON", os.path.basename(sys.argv[0])))
+      except OSError as e:
+        _ring, error = NullRing(), e
+    _ring.write(name, frame_id)
+
+  if error is not None:
+    # imported here, swaglog imports this module
+    from openpilot.common.swaglog import cloudlog
+    cloudlog.warning(f"trace: can't create the trace ring, tracing is off: {error}")
+
+
+def open_rings():
+  """All rings of the current OPENPILOT_PREFIX, keyed by path."""
+  rings = {}
+  prefix = ring_prefix()
+  for fn in os.listdir(TRACE_DIR):
+    if fn.startswith(prefix) and fn[len(prefix):].isdigit():
+      try:
+        rings[os.path.join(TRACE_DIR, fn)] = TraceRing(os.path.join(TRACE_DIR, fn))
+      except (OSError, ValueError):
+        pass
+  return rings
@@ -830,10 +830,11 @@ class Controls:
 
     # Sample data from sockets and get a carState
     CS = self.data_sample()
-    cloudlog.timestamp("Data sampled")
+    frame_id = self.sm['modelV2'].frameId
+    cloudlog.timestamp("Data sampled", frame_id)
 
     self.update_events(CS)
-    cloudlog.timestamp("Events updated")
+    cloudlog.timestamp("Events updated", frame_id)
 
     if not self.CP.passive and self.initialized:
       # Update control state
@@ -844,6 +845,7 @@ class Controls:
 
     # Publish data
     self.publish_logs(CS, start_time, CC, lac_log)
+    cloudlog.timestamp("carControl sent", frame_id)
 
     self.CS_prev = CS
 
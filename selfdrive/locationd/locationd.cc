@@ -611,7 +611,7 @@ void Localizer::handle_msg(const cereal::Event::Reader& log) {
   this->update_reset_tracker();
 }
 
-kj::ArrayPtr<capnp::byte> Localizer::get_message_bytes(MessageBuilder& msg_builder, bool inputsOK,
+kj::ArrayPtr<capnp::byte> Localizer::get_message_bytes(PooledMessageBuilder& msg_builder, bool inputsOK,
                                                        bool sensorsOK, bool gpsOK, bool msgValid) {
   cereal::Event::Builder evt = msg_builder.initEvent();
   evt.setValid(msgValid);
@@ -693,6 +693,7 @@ int Localizer::locationd_thread() {
 
   SubMaster sm(service_list, {}, nullptr, {gps_location_socket});
   PubMaster pm({"liveLocationKalman"});
+  PooledMessageBuilder msg_builder;
 
   uint64_t cnt = 0;
   bool filterInitialized = false;
@@ -726,7 +727,6 @@ int Localizer::locationd_thread() {
         this->ttff = std::max(1e-3, (sm[trigger_msg].getLogMonoTime() * 1e-9) - this->first_valid_log_time);
       }
 
-      MessageBuilder msg_builder;
       kj::ArrayPtr<capnp::byte> bytes = this->get_message_bytes(msg_builder, inputsOK, sensorsOK, gpsOK, filterInitialized);
       pm.send("liveLocationKalman", bytes.begin(), bytes.size());
 
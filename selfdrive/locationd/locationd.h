@@ -45,7 +45,7 @@ public:
   bool are_inputs_ok();
   void observation_timings_invalid_reset();
 
-  kj::ArrayPtr<capnp::byte> get_message_bytes(MessageBuilder& msg_builder,
+  kj::ArrayPtr<capnp::byte> get_message_bytes(PooledMessageBuilder& msg_builder,
     bool inputsOK, bool sensorsOK, bool gpsOK, bool msgValid);
   void build_live_location(cereal::LiveLocationKalman::Builder& fix);
 
@@ -252,6 +252,7 @@ def main(demo=False):
       'lateral_control_params': lateral_control_params,
       }
 
+    cloudlog.timestamp("modeld: model run", meta_main.frame_id)
     mt1 = time.perf_counter()
     model_output = model.run(buf_main, buf_extra, model_transform_main, model_transform_extra, inputs, prepare_only)
     mt2 = time.perf_counter()
@@ -275,6 +276,7 @@ def main(demo=False):
       fill_pose_msg(posenet_send, model_output, meta_main.frame_id, vipc_dropped_frames, meta_main.timestamp_eof, live_calib_seen)
       pm.send('modelV2', modelv2_send)
       pm.send('cameraOdometry', posenet_send)
+      cloudlog.timestamp("modeld: modelV2 sent", meta_main.frame_id)
 
     last_vipc_frame_id = meta_main.frame_id
 
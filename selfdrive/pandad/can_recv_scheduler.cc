@@ -0,0 +1,72 @@
+#include "selfdrive/pandad/can_recv_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <thread>
+
+#include "common/timing.h"
+#include "common/util.h"
+
+void LatencyHistogram::add(uint64_t latency_ns) {
+  const uint64_t us = latency_ns / 1000;
+  const int bucket = us == 0 ? 0 : 64 - __builtin_clzll(us);
+  ++buckets_[std::min(bucket, BUCKETS - 1)];
+  ++count_;
+  max_ns_ = std::max(max_ns_, latency_ns);
+}
+
+uint64_t LatencyHistogram::percentile_us(double p) const {
+  uint64_t n = 0;
+  for (int i = 0; i < BUCKETS - 1; ++i) {
+    n += buckets_[i];
+    if (n >= count_ * p) return 1ULL << i;
+  }
+  return max_us();
+}
+
+std::string LatencyHistogram::summary() const {
+  return util::string_format("%" PRIu64 " batches, p50 < %" PRIu64 "us, p99 < %" PRIu64 "us, max %" PRIu64 "us",
+                             count_, percentile_us(0.5), percentile_us(0.99), max_us());
+}
+
+void CanRecvClock::sleepUntil(uint64_t ns) {
+  const uint64_t t = now();
+  if (ns > t) {
+    std::this_thread::sleep_for(std::chrono::nanoseconds(ns - t));
+  }
+}
+
+CanRecvScheduler::CanRecvScheduler(const std::vector<Panda *> &pandas, uint64_t period_ns, CanRecvClock *clock)
+    : pandas_(pandas), period_ns_(period_ns) {
+  static CanRecvClock system_clock;
+  clock_ = clock ? clock : &system_clock;
+  next_read_ns_ = clock_->now();
+  latency.resize(pandas_.size());
+  read_start_ns_.assign(pandas_.size(), 0);
+}
+
+bool CanRecvScheduler::receive(std::vector<can_recv_frame> &frames) {
+  clock_->sleepUntil(next_read_ns_);
+
+  frames.clear();
+  bool comms_healthy = true;
+  for (size_t i = 0; i < pandas_.size(); ++i) {
+    read_start_ns_[i] = clock_->now();
+    comms_healthy &= pandas_[i]->can_receive(frames);
+  }
+  return comms_healthy;
+}
+
+void CanRecvScheduler::published() {
+  const uint64_t now = clock_->now();
+  for (size_t i = 0; i < pandas_.size(); ++i) {
+    latency[i].add(now - read_start_ns_[i]);
+  }
+
+  // stay on the grid after a late publish, start a new one after missing a whole period
+  next_read_ns_ += period_ns_;
+  if (next_read_ns_ <= now) {
+    next_read_ns_ = now + period_ns_;
+  }
+}
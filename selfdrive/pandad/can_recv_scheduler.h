@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common/timing.h"
+#include "selfdrive/pandad/panda.h"
+
+// receive latencies in power of two microsecond buckets, the last bucket holds everything above
+class LatencyHistogram {
+public:
+  static constexpr int BUCKETS = 16;
+
+  void add(uint64_t latency_ns);
+  void reset() { *this = {}; }
+  uint64_t count() const { return count_; }
+  uint64_t max_us() const { return max_ns_ / 1000; }
+  // the upper bound of the bucket the p-th percentile falls in
+  uint64_t percentile_us(double p) const;
+  std::string summary() const;
+
+private:
+  std::array<uint64_t, BUCKETS> buckets_ = {};
+  uint64_t count_ = 0;
+  uint64_t max_ns_ = 0;
+};
+
+// the clock CanRecvScheduler runs on, tests replace it
+class CanRecvClock {
+public:
+  virtual ~CanRecvClock() {}
+  virtual uint64_t now() { return nanos_since_boot(); }
+  virtual void sleepUntil(uint64_t ns);
+};
+
+// Reads every panda once per period and publishes the frames right after, so can keeps the
+// 100Hz cadence card.py and everything downstream is built for. The reads start on a fixed grid,
+// a slow read delays one publish without shifting the ones after it.
+class CanRecvScheduler {
+public:
+  CanRecvScheduler(const std::vector<Panda *> &pandas, uint64_t period_ns = 10000000, CanRecvClock *clock = nullptr);
+  // waits for the next period and reads every panda into frames, returns whether the comms were healthy
+  bool receive(std::vector<can_recv_frame> &frames);
+  // call right after publishing the frames
+  void published();
+
+  // the time from starting to read each panda to publishing its frames. how long the frames
+  // waited on the panda before the read isn't known, it is up to a period.
+  std::vector<LatencyHistogram> latency;
+
+private:
+  std::vector<Panda *> pandas_;
+  const uint64_t period_ns_;
+  CanRecvClock *clock_;
+  uint64_t next_read_ns_;
+  std::vector<uint64_t> read_start_ns_;
+};
@@ -42,6 +42,10 @@ std::string Panda::hw_serial() {
   return handle->hw_serial;
 }
 
+const char *Panda::transport() {
+  return handle->transport();
+}
+
 std::vector<std::string> Panda::list(bool usb_only) {
   std::vector<std::string> serials = PandaUsbHandle::list();
 
@@ -212,7 +216,7 @@ void Panda::can_send(capnp::List<cereal::CanData>::Reader can_data_list) {
   });
 }
 
-bool Panda::can_receive(std::vector<can_frame>& out_vec) {
+bool Panda::can_receive(std::vector<can_recv_frame>& out_vec) {
   // Check if enough space left in buffer to store RECV_SIZE data
   assert(receive_buffer_size + RECV_SIZE <= sizeof(receive_buffer));
 
@@ -233,7 +237,7 @@ void Panda::can_reset_communications() {
   handle->control_write(0xc0, 0, 0);
 }
 
-bool Panda::unpack_can_buffer(uint8_t *data, uint32_t &size, std::vector<can_frame> &out_vec) {
+bool Panda::unpack_can_buffer(uint8_t *data, uint32_t &size, std::vector<can_recv_frame> &out_vec) {
   int pos = 0;
 
   while (pos <= size - sizeof(can_header)) {
@@ -253,8 +257,7 @@ bool Panda::unpack_can_buffer(uint8_t *data, uint32_t &size, std::vector<can_fra
       return false;
     }
 
-    can_frame &canData = out_vec.emplace_back();
-    canData.busTime = 0;
+    can_recv_frame &canData = out_vec.emplace_back();
     canData.address = header.addr;
     canData.src = header.bus + bus_offset;
     if (header.rejected) {
@@ -264,7 +267,8 @@ bool Panda::unpack_can_buffer(uint8_t *data, uint32_t &size, std::vector<can_fra
       canData.src += CAN_RETURNED_BUS_OFFSET;
     }
 
-    canData.dat.assign((char *)&data[pos + sizeof(can_header)], data_len);
+    canData.len = data_len;
+    memcpy(canData.dat, &data[pos + sizeof(can_header)], data_len);
 
     pos += sizeof(can_header) + data_len;
   }
@@ -19,6 +19,8 @@
 #define USBPACKET_MAX_SIZE  (0x40)
 
 #define RECV_SIZE (0x4000U)
+// the most frames a receive can return, all of them without data
+#define RECV_MAX_FRAMES ((RECV_SIZE + sizeof(can_header) + 64) / sizeof(can_header))
 
 #define CAN_REJECTED_BUS_OFFSET   0xC0U
 #define CAN_RETURNED_BUS_OFFSET 0x80U
@@ -43,6 +45,14 @@ struct can_frame {
   long src;
 };
 
+// a received frame, the data is inline so receiving into a reused vector doesn't allocate
+struct can_recv_frame {
+  uint32_t address;
+  uint32_t src;
+  uint8_t len;
+  uint8_t dat[64];
+};
+
 
 class Panda {
 private:
@@ -57,6 +67,7 @@ public:
   bool connected();
   bool comms_healthy();
   std::string hw_serial();
+  const char *transport();
 
   // Static functions
   static std::vector<std::string> list(bool usb_only=false);
@@ -81,7 +92,8 @@ public:
   void set_data_speed_kbps(uint16_t bus, uint16_t speed);
   void set_canfd_non_iso(uint16_t bus, bool non_iso);
   void can_send(capnp::List<cereal::CanData>::Reader can_data_list);
-  bool can_receive(std::vector<can_frame>& out_vec);
+  // appends to out_vec, reserve RECV_MAX_FRAMES per panda for it to never allocate
+  bool can_receive(std::vector<can_recv_frame>& out_vec);
   void can_reset_communications();
 
 protected:
@@ -90,8 +102,9 @@ protected:
   uint32_t receive_buffer_size = 0;
 
   Panda(uint32_t bus_offset) : bus_offset(bus_offset) {}
+  Panda(std::unique_ptr<PandaCommsHandle> handle, uint32_t bus_offset) : handle(std::move(handle)), bus_offset(bus_offset) {}
   void pack_can_buffer(const capnp::List<cereal::CanData>::Reader &can_data_list,
                          std::function<void(uint8_t *, size_t)> write_func);
-  bool unpack_can_buffer(uint8_t *data, uint32_t &size, std::vector<can_frame> &out_vec);
+  bool unpack_can_buffer(uint8_t *data, uint32_t &size, std::vector<can_recv_frame> &out_vec);
   uint8_t calculate_checksum(uint8_t *data, uint32_t len);
 };
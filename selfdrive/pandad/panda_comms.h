@@ -28,6 +28,7 @@ public:
   std::atomic<bool> connected = true;
   std::atomic<bool> comms_healthy = true;
   static std::vector<std::string> list();
+  virtual const char *transport() const = 0;
 
   // HW communication
   virtual int control_write(uint8_t request, uint16_t param1, uint16_t param2, unsigned int timeout=TIMEOUT) = 0;
@@ -45,6 +46,7 @@ public:
   int bulk_write(unsigned char endpoint, unsigned char* data, int length, unsigned int timeout=TIMEOUT);
   int bulk_read(unsigned char endpoint, unsigned char* data, int length, unsigned int timeout=TIMEOUT);
   void cleanup();
+  const char *transport() const { return "USB"; }
 
   static std::vector<std::string> list();
 
@@ -72,6 +74,7 @@ public:
   int bulk_write(unsigned char endpoint, unsigned char* data, int length, unsigned int timeout=TIMEOUT);
   int bulk_read(unsigned char endpoint, unsigned char* data, int length, unsigned int timeout=TIMEOUT);
   void cleanup();
+  const char *transport() const { return "SPI"; }
 
   static std::vector<std::string> list();
 
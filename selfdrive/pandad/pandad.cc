@@ -18,6 +18,7 @@
 #include "common/swaglog.h"
 #include "common/timing.h"
 #include "common/util.h"
+#include "selfdrive/pandad/can_recv_scheduler.h"
 #include "system/hardware/hw.h"
 
 // -- Multi-panda conventions --
@@ -202,30 +203,35 @@ void can_recv_thread(std::vector<Panda *> pandas) {
 
   PubMaster pm({"can"});
 
-  // run at 100Hz
-  RateKeeper rk("pandad_can_recv", 100);
-  std::vector<can_frame> raw_can_data;
+  // run at 100Hz, publishing right after reading
+  CanRecvScheduler scheduler(pandas);
+  uint64_t last_latency_log_ns = nanos_since_boot();
+
+  std::vector<can_recv_frame> raw_can_data;
+  raw_can_data.reserve(pandas.size() * RECV_MAX_FRAMES);
+  PooledMessageBuilder msg;
 
   while (!do_exit && check_all_connected(pandas)) {
-    bool comms_healthy = true;
-    raw_can_data.clear();
-    for (const auto& panda : pandas) {
-      comms_healthy &= panda->can_receive(raw_can_data);
-    }
+    bool comms_healthy = scheduler.receive(raw_can_data);
 
-    MessageBuilder msg;
     auto evt = msg.initEvent();
     evt.setValid(comms_healthy);
     auto canData = evt.initCan(raw_can_data.size());
     for (uint i = 0; i<raw_can_data.size(); i++) {
       canData[i].setAddress(raw_can_data[i].address);
-      canData[i].setBusTime(raw_can_data[i].busTime);
-      canData[i].setDat(kj::arrayPtr((uint8_t*)raw_can_data[i].dat.data(), raw_can_data[i].dat.size()));
+      canData[i].setDat(kj::arrayPtr(raw_can_data[i].dat, raw_can_data[i].len));
       canData[i].setSrc(raw_can_data[i].src);
     }
     pm.send("can", msg);
+    scheduler.published();
 
-    rk.keepTime();
+    if (nanos_since_boot() - last_latency_log_ns > 60e9) {
+      for (int i = 0; i < pandas.size(); ++i) {
+        LOGD("panda %d (%s) can recv latency: %s", i, pandas[i]->transport(), scheduler.latency[i].summary().c_str());
+        scheduler.latency[i].reset();
+      }
+      last_latency_log_ns = nanos_since_boot();
+    }
   }
 }
 
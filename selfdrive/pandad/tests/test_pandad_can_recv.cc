@@ -0,0 +1,180 @@
+#define CATCH_CONFIG_MAIN
+
+#include <cstring>
+#include <map>
+
+#include "catch2/catch.hpp"
+#include "selfdrive/pandad/can_recv_scheduler.h"
+#include "selfdrive/pandad/panda.h"
+
+// time only moves when the scheduler sleeps or a panda is read
+class FakeClock : public CanRecvClock {
+public:
+  uint64_t now() override { return t; }
+  void sleepUntil(uint64_t ns) override { t = std::max(t, ns); }
+  uint64_t t = 1000000000;
+};
+
+// A panda receiving frames at a steady rate. Each read takes read_ns, like a transfer over the wire,
+// and returns the frames that arrived until then, with the time they arrived as their data.
+class FakeCommsHandle : public PandaCommsHandle {
+public:
+  FakeCommsHandle(FakeClock *clock, const char *transport, uint64_t read_ns, int frames_per_sec)
+      : PandaCommsHandle(""), clock_(clock), transport_(transport), read_ns_(read_ns), frame_interval_ns_(frames_per_sec > 0 ? 1e9 / frames_per_sec : 0) {
+    next_frame_ns_ = clock->t;
+  }
+  int control_write(uint8_t request, uint16_t param1, uint16_t param2, unsigned int timeout) { return 0; }
+  int control_read(uint8_t request, uint16_t param1, uint16_t param2, unsigned char *data, uint16_t length, unsigned int timeout) { return 0; }
+  int bulk_write(unsigned char endpoint, unsigned char *data, int length, unsigned int timeout) { return length; }
+  void cleanup() {}
+  const char *transport() const { return transport_; }
+
+  int bulk_read(unsigned char endpoint, unsigned char *data, int length, unsigned int timeout) {
+    auto slow = slow_reads.find(reads++);
+    clock_->t += slow != slow_reads.end() ? slow->second : read_ns_;
+
+    int pos = 0;
+    while (frame_interval_ns_ > 0 && next_frame_ns_ <= clock_->t && pos + FRAME_SIZE <= length) {
+      can_header header = {};
+      header.data_len_code = 8;  // 8 bytes
+      header.addr = sent & 0x7ff;
+      memcpy(&data[pos], &header, sizeof(header));
+      memcpy(&data[pos + sizeof(header)], &next_frame_ns_, sizeof(next_frame_ns_));
+
+      uint8_t checksum = 0;
+      for (int i = 0; i < FRAME_SIZE; ++i) checksum ^= data[pos + i];
+      header.checksum = checksum;
+      memcpy(&data[pos], &header, sizeof(header));
+
+      pos += FRAME_SIZE;
+      next_frame_ns_ += frame_interval_ns_;
+      ++sent;
+    }
+    return pos;
+  }
+
+  static constexpr int FRAME_SIZE = sizeof(can_header) + 8;
+  uint64_t sent = 0;
+  int reads = 0;
+  // how long a read takes instead of read_ns, by read number
+  std::map<int, uint64_t> slow_reads;
+
+private:
+  FakeClock *clock_;
+  const char *transport_;
+  const uint64_t read_ns_;
+  const uint64_t frame_interval_ns_;
+  uint64_t next_frame_ns_;
+};
+
+class FakePanda : public Panda {
+public:
+  FakePanda(FakeCommsHandle *comms, uint32_t bus_offset) : Panda(std::unique_ptr<PandaCommsHandle>(comms), bus_offset), comms(comms) {}
+  FakeCommsHandle *comms;
+};
+
+const uint64_t PERIOD_NS = 10000000;
+const uint64_t USB_READ_NS = 150000;
+const uint64_t SPI_READ_NS = 50000;
+
+// runs can_recv_thread's loop against a USB-like and an SPI-like panda
+struct CanRecvTest {
+  CanRecvTest(int frames_per_sec)
+      : usb(new FakeCommsHandle(&clock, "USB", USB_READ_NS, frames_per_sec), 0),
+        spi(new FakeCommsHandle(&clock, "SPI", SPI_READ_NS, frames_per_sec), PANDA_BUS_OFFSET),
+        scheduler(pandas, PERIOD_NS, &clock) {
+    start_ns = clock.t;
+  }
+
+  void run(int publishes) {
+    std::vector<can_recv_frame> frames;
+    for (int i = 0; i < publishes; ++i) {
+      REQUIRE(scheduler.receive(frames));
+      publish_ns.push_back(clock.t);
+      scheduler.published();
+
+      received += frames.size();
+      for (const auto &f : frames) {
+        uint64_t arrived_ns;
+        memcpy(&arrived_ns, f.dat, sizeof(arrived_ns));
+        max_latency_ns = std::max(max_latency_ns, clock.t - arrived_ns);
+        uint32_t &next = next_address[f.src / PANDA_BUS_OFFSET];
+        in_order &= f.address == next;
+        next = (f.address + 1) & 0x7ff;
+      }
+    }
+  }
+  // the time the i-th reads start
+  uint64_t period_start(int i) const { return start_ns + i * PERIOD_NS; }
+  uint64_t sent() const { return usb.comms->sent + spi.comms->sent; }
+
+  FakeClock clock;
+  FakePanda usb, spi;
+  std::vector<Panda *> pandas = {&usb, &spi};
+  CanRecvScheduler scheduler;
+
+  uint64_t start_ns;
+  std::vector<uint64_t> publish_ns;
+  uint64_t received = 0;
+  // from a frame arriving at the panda to publishing it
+  uint64_t max_latency_ns = 0;
+  bool in_order = true;
+  uint32_t next_address[2] = {};
+};
+
+TEST_CASE("CanRecvScheduler") {
+  const uint64_t read_ns = USB_READ_NS + SPI_READ_NS;
+
+  SECTION("publishes every frame once, in order") {
+    CanRecvTest t(5000);
+    t.run(100);
+    REQUIRE(t.sent() > 0);
+    REQUIRE(t.received == t.sent());
+    REQUIRE(t.in_order);
+    // a frame waits at most a period and the reads it came in
+    REQUIRE(t.max_latency_ns <= PERIOD_NS + read_ns);
+    for (auto &h : t.scheduler.latency) {
+      REQUIRE(h.count() == 100);
+    }
+  }
+
+  SECTION("publishes at 100Hz, right after reading") {
+    CanRecvTest t(5000);
+    t.run(100);
+    for (int i = 0; i < t.publish_ns.size(); ++i) {
+      REQUIRE(t.publish_ns[i] == t.period_start(i) + read_ns);
+    }
+    REQUIRE(t.scheduler.latency[0].max_us() == read_ns / 1000);
+    REQUIRE(t.scheduler.latency[1].max_us() == SPI_READ_NS / 1000);
+  }
+
+  SECTION("stays on the grid after a slow read") {
+    CanRecvTest t(5000);
+    t.usb.comms->slow_reads[10] = 3000000;
+    t.run(100);
+    REQUIRE(t.publish_ns[10] == t.period_start(10) + 3000000 + SPI_READ_NS);
+    for (int i = 11; i < t.publish_ns.size(); ++i) {
+      REQUIRE(t.publish_ns[i] == t.period_start(i) + read_ns);
+    }
+    REQUIRE(t.received == t.sent());
+  }
+
+  SECTION("doesn't catch up after missing periods") {
+    CanRecvTest t(5000);
+    t.usb.comms->slow_reads[10] = 35000000;
+    t.run(100);
+    // the next reads start a period after the late publish, on a new grid
+    REQUIRE(t.publish_ns[11] - t.publish_ns[10] == PERIOD_NS + read_ns);
+    for (int i = 12; i < t.publish_ns.size(); ++i) {
+      REQUIRE(t.publish_ns[i] - t.publish_ns[i - 1] == PERIOD_NS);
+    }
+    REQUIRE(t.received == t.sent());
+  }
+
+  SECTION("publishes on an idle bus") {
+    CanRecvTest t(0);
+    t.run(100);
+    REQUIRE(t.received == 0);
+    REQUIRE(t.publish_ns.back() == t.period_start(99) + read_ns);
+  }
+}
@@ -3,6 +3,8 @@
 
 #include "catch2/catch.hpp"
 #include "cereal/messaging/messaging.h"
+#include "common/tests/alloc_count.h"
+#include "common/timing.h"
 #include "common/util.h"
 #include "selfdrive/pandad/panda.h"
 
@@ -11,6 +13,8 @@ struct PandaTest : public Panda {
   void test_can_send();
   void test_can_recv(uint32_t chunk_size = 0);
   void test_chunked_can_recv();
+  std::vector<uint8_t> usb_read();
+  bool recv_cycle(const std::vector<uint8_t> &read, std::vector<can_recv_frame> &frames, PooledMessageBuilder &msg_builder);
 
   std::map<int, std::string> test_data;
   int can_list_size = 0;
@@ -74,7 +78,7 @@ void PandaTest::test_can_send() {
 }
 
 void PandaTest::test_can_recv(uint32_t rx_chunk_size) {
-  std::vector<can_frame> frames;
+  std::vector<can_recv_frame> frames;
   this->pack_can_buffer(can_data_list, [&](uint8_t *data, uint32_t size) {
     if (rx_chunk_size == 0) {
       REQUIRE(this->unpack_can_buffer(data, size, frames));
@@ -96,12 +100,40 @@ void PandaTest::test_can_recv(uint32_t rx_chunk_size) {
   REQUIRE(frames.size() == can_list_size);
   for (int i = 0; i < frames.size(); ++i) {
     REQUIRE(frames[i].address == i);
-    REQUIRE(test_data.find(frames[i].dat.size()) != test_data.end());
-    const std::string &dat = test_data[frames[i].dat.size()];
-    REQUIRE(memcmp(dat.data(), frames[i].dat.data(), dat.size()) == 0);
+    REQUIRE(test_data.find(frames[i].len) != test_data.end());
+    const std::string &dat = test_data[frames[i].len];
+    REQUIRE(memcmp(dat.data(), frames[i].dat, dat.size()) == 0);
   }
 }
 
+// the frames as the panda sends them in one bulk read
+std::vector<uint8_t> PandaTest::usb_read() {
+  std::vector<uint8_t> read;
+  this->pack_can_buffer(can_data_list, [&](uint8_t *data, size_t size) {
+    read.insert(read.end(), data, data + size);
+  });
+  REQUIRE(read.size() <= RECV_SIZE);
+  return read;
+}
+
+// one cycle of can_recv_thread with the read in place of the bulk read
+bool PandaTest::recv_cycle(const std::vector<uint8_t> &read, std::vector<can_recv_frame> &frames, PooledMessageBuilder &msg_builder) {
+  frames.clear();
+  memcpy(&this->receive_buffer[this->receive_buffer_size], read.data(), read.size());
+  this->receive_buffer_size += read.size();
+  if (!this->unpack_can_buffer(this->receive_buffer, this->receive_buffer_size, frames)) {
+    return false;
+  }
+
+  auto canData = msg_builder.initEvent().initCan(frames.size());
+  for (uint i = 0; i < frames.size(); i++) {
+    canData[i].setAddress(frames[i].address);
+    canData[i].setDat(kj::arrayPtr(frames[i].dat, frames[i].len));
+    canData[i].setSrc(frames[i].src);
+  }
+  return msg_builder.toBytes().size() > 0;
+}
+
 TEST_CASE("send/recv CAN 2.0 packets") {
   auto bus_offset = GENERATE(0, 4);
   auto can_list_size = GENERATE(1, 3, 5, 10, 30, 60, 100, 200);
@@ -133,3 +165,53 @@ TEST_CASE("send/recv CAN FD packets") {
     test.test_can_recv(0x40);
   }
 }
+
+TEST_CASE("recv CAN packets without allocating") {
+  auto hw_type = GENERATE(cereal::PandaState::PandaType::DOS, cereal::PandaState::PandaType::RED_PANDA);
+  PandaTest test(0, 200, hw_type);
+  const auto read = test.usb_read();
+  std::vector<can_recv_frame> frames;
+  frames.reserve(RECV_MAX_FRAMES);
+  PooledMessageBuilder msg;
+
+  // the message builder grows to fit the first messages
+  for (int i = 0; i < 3; ++i) {
+    REQUIRE(test.recv_cycle(read, frames, msg));
+  }
+
+  bool ok = true;
+  alloc_count = 0;
+  count_allocs = true;
+  for (int i = 0; i < 100; ++i) {
+    ok &= test.recv_cycle(read, frames, msg);
+  }
+  count_allocs = false;
+  REQUIRE(ok);
+  REQUIRE(frames.size() == 200);
+  REQUIRE(alloc_count == 0);
+}
+
+TEST_CASE("recv CAN packets benchmark", "[.][benchmark]") {
+  for (auto hw_type : {cereal::PandaState::PandaType::DOS, cereal::PandaState::PandaType::RED_PANDA}) {
+    PandaTest test(0, 200, hw_type);
+    const auto read = test.usb_read();
+    std::vector<can_recv_frame> frames;
+    frames.reserve(RECV_MAX_FRAMES);
+    PooledMessageBuilder msg;
+
+    const int cycles = 100000;
+    size_t frame_count = 0;
+    alloc_count = 0;
+    count_allocs = true;
+    double start = millis_since_boot();
+    for (int i = 0; i < cycles; ++i) {
+      test.recv_cycle(read, frames, msg);
+      frame_count += frames.size();
+    }
+    const double ms = millis_since_boot() - start;
+    count_allocs = false;
+    printf("%s: %zu bytes per read, %.2f M frames/s, %.3f allocations per cycle\n",
+           hw_type == cereal::PandaState::PandaType::DOS ? "CAN 2.0" : "CAN FD", read.size(),
+           frame_count / ms / 1e3, (double)alloc_count / cycles);
+  }
+}
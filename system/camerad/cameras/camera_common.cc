@@ -134,7 +134,9 @@ bool CameraBuf::acquire() {
 }
 
 void CameraBuf::queue(size_t buf_idx) {
-  safe_queue.push(buf_idx);
+  if (!safe_queue.try_push(buf_idx)) {
+    LOGE("frame queue full, dropping buffer %zu", buf_idx);
+  }
 }
 
 // common functions
@@ -53,7 +53,7 @@ private:
   ImgProc *imgproc = nullptr;
   VisionStreamType stream_type;
   int cur_buf_idx;
-  SafeQueue<int> safe_queue;
+  SpscQueue<int, 16> safe_queue;
   int frame_buf_count;
 
 public:
@@ -948,7 +948,11 @@ void process_road_camera(MultiCameraState *s, CameraState *c, int cnt) {
   if (env_log_raw_frames && c == &s->road_cam && cnt % 100 == 5) {  // no overlap with qlog decimation
     framed.setImage(get_raw_frame_image(b));
   }
-  LOGT(c->buf.cur_frame_data.frame_id, "%s: Image set", c == &s->road_cam ? "RoadCamera" : "WideRoadCamera");
+  if (c == &s->road_cam) {
+    LOGT(c->buf.cur_frame_data.frame_id, "RoadCamera: Image set");
+  } else {
+    LOGT(c->buf.cur_frame_data.frame_id, "WideRoadCamera: Image set");
+  }
 
   c->ci->processRegisters(c, framed);
   s->pm->send(c == &s->road_cam ? "roadCameraState" : "wideRoadCameraState", msg);
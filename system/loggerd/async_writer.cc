@@ -0,0 +1,129 @@
+#include "system/loggerd/async_writer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "common/timing.h"
+#include "common/util.h"
+
+LogWriterThread::LogWriterThread() {
+  blocks.reset(new LogBlock[LOG_BLOCK_COUNT]);
+  for (size_t i = 0; i < LOG_BLOCK_COUNT; ++i) {
+    free_blocks.push(&blocks[i]);
+  }
+  thread = std::thread(&LogWriterThread::run, this);
+}
+
+LogWriterThread::~LogWriterThread() {
+  exit = true;
+  thread.join();
+}
+
+LogBlock *LogWriterThread::acquire() {
+  LogBlock *block = nullptr;
+  if (!free_blocks.try_pop(block)) {
+    // back-pressure: the disk can't keep up
+    uint64_t start = nanos_since_boot();
+    block = free_blocks.pop();
+    ++stall_count;
+    stall_time_ns += nanos_since_boot() - start;
+  }
+  return block;
+}
+
+void LogWriterThread::submit(LogBlock *block) {
+  bool ret = pending_blocks.try_push(block);
+  assert(ret);
+  max_queue_depth = std::max(max_queue_depth, pending_blocks.size());
+}
+
+LogWriterStats LogWriterThread::stats() {
+  LogWriterStats s = {
+    .queue_depth = pending_blocks.size(),
+    .max_queue_depth = max_queue_depth,
+    .queue_capacity = pending_blocks.capacity(),
+    .bytes_written = bytes_written,
+    .max_write_latency_ms = max_write_latency_ns.exchange(0) / 1e6,
+    .stall_count = stall_count,
+    .stall_time_ms = stall_time_ns / 1e6,
+  };
+  max_queue_depth = 0;
+  stall_count = 0;
+  stall_time_ns = 0;
+  return s;
+}
+
+void LogWriterThread::run() {
+  util::set_thread_name("loggerd_writer");
+
+  LogBlock *block = nullptr;
+  while (true) {
+    // read exit before popping, so nothing submitted before exit is missed
+    const bool exiting = exit;
+    if (!pending_blocks.try_pop(block, exiting ? 0 : 100)) {
+      if (exiting) break;
+      continue;
+    }
+
+    uint64_t start = nanos_since_boot();
+    if (block->size > 0) {
+      block->file->write(block->data, block->size);
+    }
+    if (block->close) {
+      delete block->file;
+      if (!block->lock_file.empty()) {
+        std::remove(block->lock_file.c_str());
+      }
+    }
+    uint64_t latency = nanos_since_boot() - start;
+
+    uint64_t prev_max = max_write_latency_ns;
+    while (latency > prev_max && !max_write_latency_ns.compare_exchange_weak(prev_max, latency)) {}
+    bytes_written += block->size;
+
+    block->file = nullptr;
+    block->size = 0;
+    block->close = false;
+    block->lock_file.clear();
+    free_blocks.push(block);
+  }
+}
+
+AsyncLogFile::AsyncLogFile(LogWriterThread *io_, LogFileWriter *file_, const std::string &lock_file_)
+    : io(io_), file(file_), lock_file(lock_file_) {}
+
+AsyncLogFile::~AsyncLogFile() {
+  if (!block) {
+    block = io->acquire();
+    block->file = file;
+  }
+  block->close = true;
+  block->lock_file = lock_file;
+  io->submit(block);
+}
+
+void AsyncLogFile::write(void* data, size_t size) {
+  const uint8_t *src = (const uint8_t *)data;
+  while (size > 0) {
+    if (!block) {
+      block = io->acquire();
+      block->file = file;
+    }
+    size_t n = std::min(size, LOG_BLOCK_SIZE - block->size);
+    memcpy(block->data + block->size, src, n);
+    block->size += n;
+    src += n;
+    size -= n;
+
+    if (block->size == LOG_BLOCK_SIZE) {
+      flush();
+    }
+  }
+}
+
+void AsyncLogFile::flush() {
+  if (block) {
+    io->submit(block);
+    block = nullptr;
+  }
+}
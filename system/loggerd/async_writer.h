@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "common/queue.h"
+#include "system/loggerd/logger.h"
+
+// loggerd copies log data into preallocated blocks, which a separate thread
+// writes to disk. LOG_BLOCK_COUNT * LOG_BLOCK_SIZE bounds the memory in flight.
+const size_t LOG_BLOCK_SIZE = 128 * 1024;
+const size_t LOG_BLOCK_COUNT = 64;
+
+struct LogBlock {
+  LogFileWriter *file = nullptr;
+  size_t size = 0;
+  bool close = false;     // delete the file once this block is written
+  std::string lock_file;  // removed after the file is closed
+  uint8_t data[LOG_BLOCK_SIZE];
+};
+
+struct LogWriterStats {
+  size_t queue_depth, max_queue_depth, queue_capacity;
+  uint64_t bytes_written;
+  double max_write_latency_ms;
+  uint32_t stall_count;
+  double stall_time_ms;
+};
+
+class LogWriterThread {
+public:
+  LogWriterThread();
+  ~LogWriterThread();
+  // waits for a free block if all of them are in flight
+  LogBlock *acquire();
+  void submit(LogBlock *block);
+  // interval maxima and stall counters are reset on every call
+  LogWriterStats stats();
+
+private:
+  void run();
+
+  std::unique_ptr<LogBlock[]> blocks;
+  SpscQueue<LogBlock *, LOG_BLOCK_COUNT> free_blocks, pending_blocks;
+  std::atomic<bool> exit{false};
+  std::atomic<uint64_t> bytes_written{0}, max_write_latency_ns{0};
+  // only touched by the producer
+  size_t max_queue_depth = 0;
+  uint32_t stall_count = 0;
+  uint64_t stall_time_ns = 0;
+  std::thread thread;
+};
+
+// LogFileWriter front end that hands the data to a LogWriterThread.
+// Takes ownership of file, which is closed on the writer thread.
+class AsyncLogFile : public LogFileWriter {
+public:
+  AsyncLogFile(LogWriterThread *io, LogFileWriter *file, const std::string &lock_file = "");
+  ~AsyncLogFile();
+  void write(void* data, size_t size) override;
+  using LogFileWriter::write;
+  // submit the partially filled block
+  void flush();
+
+private:
+  LogWriterThread *io;
+  LogFileWriter *file;
+  std::string lock_file;
+  LogBlock *block = nullptr;
+};
@@ -17,8 +17,7 @@ VideoEncoder::VideoEncoder(const EncoderInfo &encoder_info, int in_width, int in
 void VideoEncoder::publisher_publish(VideoEncoder *e, int segment_num, uint32_t idx, VisionIpcBufExtra &extra,
                                      unsigned int flags, kj::ArrayPtr<capnp::byte> header, kj::ArrayPtr<capnp::byte> dat) {
   // broadcast packet
-  MessageBuilder msg;
-  auto event = msg.initEvent(true);
+  auto event = e->msg_builder.initEvent(true);
   auto edat = (event.*(e->encoder_info.init_encode_data_func))();
   auto edata = edat.initIdx();
   struct timespec ts;
@@ -38,13 +37,7 @@ void VideoEncoder::publisher_publish(VideoEncoder *e, int segment_num, uint32_t
   edat.setHeight(out_height);
   if (flags & V4L2_BUF_FLAG_KEYFRAME) edat.setHeader(header);
 
-  uint32_t bytes_size = capnp::computeSerializedSizeInWords(msg) * sizeof(capnp::word);
-  if (e->msg_cache.size() < bytes_size) {
-    e->msg_cache.resize(bytes_size);
-  }
-  kj::ArrayOutputStream output_stream(kj::ArrayPtr<capnp::byte>(e->msg_cache.data(), bytes_size));
-  capnp::writeMessage(output_stream, msg);
-  e->pm->send(e->encoder_info.publish_name, e->msg_cache.data(), bytes_size);
+  e->pm->send(e->encoder_info.publish_name, e->msg_builder);
 
   // Publish keyframe thumbnail
   if ((flags & V4L2_BUF_FLAG_KEYFRAME) && e->encoder_info.thumbnail_name != NULL) {
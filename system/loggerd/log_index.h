@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// loggerd writes a side index next to each log (rlog.idx, qlog.idx) when the segment is closed.
+// Events are grouped by Event::Which and time bucket, so a reader can map only the services
+// and time window it needs. Offsets are in words into the uncompressed event stream.
+//
+// layout: LogIndexHeader | LogIndexGroup[num_groups] | LogIndexEvent[num_events]
+// groups are sorted by (which, bucket), the events of a group are contiguous and in log order.
+
+const uint32_t LOG_INDEX_MAGIC = 0x5844494c;  // "LIDX"
+const uint32_t LOG_INDEX_VERSION = 1;
+const uint64_t LOG_INDEX_BUCKET_NS = 1000000000ULL;
+
+struct LogIndexHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t bucket_ns;
+  uint64_t start_mono_time;  // start of bucket 0
+  uint64_t log_size;         // bytes of the uncompressed log
+  uint32_t num_groups;
+  uint32_t num_events;
+};
+
+struct LogIndexGroup {
+  uint16_t which;
+  uint16_t reserved;
+  uint32_t bucket;
+  uint32_t first_event;
+  uint32_t num_events;
+};
+
+struct LogIndexEvent {
+  uint64_t mono_time;
+  uint32_t offset_words;
+  uint32_t size_words;
+};
+
+class LogIndexBuilder {
+public:
+  // events must be added in the order they are written to the log
+  void add(uint16_t which, uint64_t mono_time, size_t size) {
+    events.push_back({which, mono_time, offset, size});
+    offset += size;
+  }
+
+  std::string finish(uint64_t bucket_ns = LOG_INDEX_BUCKET_NS) const {
+    uint64_t start = UINT64_MAX;
+    for (auto &e : events) start = std::min(start, e.mono_time);
+    if (events.empty()) start = 0;
+
+    auto bucket = [&](const Entry &e) { return (uint32_t)((e.mono_time - start) / bucket_ns); };
+    std::vector<uint32_t> order(events.size());
+    for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+      const Entry &l = events[a], &r = events[b];
+      return l.which < r.which || (l.which == r.which && bucket(l) < bucket(r));
+    });
+
+    std::vector<LogIndexGroup> groups;
+    std::vector<LogIndexEvent> index_events;
+    index_events.reserve(order.size());
+    for (uint32_t i : order) {
+      const Entry &e = events[i];
+      uint32_t b = bucket(e);
+      if (groups.empty() || groups.back().which != e.which || groups.back().bucket != b) {
+        groups.push_back({e.which, 0, b, (uint32_t)index_events.size(), 0});
+      }
+      ++groups.back().num_events;
+      index_events.push_back({e.mono_time, (uint32_t)(e.offset / 8), (uint32_t)(e.size / 8)});
+    }
+
+    LogIndexHeader header = {LOG_INDEX_MAGIC, LOG_INDEX_VERSION, bucket_ns, start, offset,
+                             (uint32_t)groups.size(), (uint32_t)index_events.size()};
+    std::string out;
+    out.append((const char *)&header, sizeof(header));
+    out.append((const char *)groups.data(), groups.size() * sizeof(LogIndexGroup));
+    out.append((const char *)index_events.data(), index_events.size() * sizeof(LogIndexEvent));
+    return out;
+  }
+
+  void clear() {
+    events.clear();
+    offset = 0;
+  }
+
+private:
+  struct Entry {
+    uint16_t which;
+    uint64_t mono_time;
+    uint64_t offset, size;
+  };
+  std::vector<Entry> events;
+  uint64_t offset = 0;
+};
+
+// points into the serialized index, which must outlive the view
+struct LogIndexView {
+  bool parse(const std::string &data) {
+    if (data.size() < sizeof(LogIndexHeader)) return false;
+    header = (const LogIndexHeader *)data.data();
+    if (header->magic != LOG_INDEX_MAGIC || header->version != LOG_INDEX_VERSION || header->bucket_ns == 0) return false;
+    if (data.size() != sizeof(LogIndexHeader) + header->num_groups * sizeof(LogIndexGroup) +
+                       header->num_events * sizeof(LogIndexEvent)) return false;
+
+    groups = (const LogIndexGroup *)(data.data() + sizeof(LogIndexHeader));
+    events = (const LogIndexEvent *)(groups + header->num_groups);
+    for (uint32_t i = 0; i < header->num_groups; ++i) {
+      if ((uint64_t)groups[i].first_event + groups[i].num_events > header->num_events) return false;
+    }
+    for (uint32_t i = 0; i < header->num_events; ++i) {
+      if (((uint64_t)events[i].offset_words + events[i].size_words) * 8 > header->log_size) return false;
+    }
+    return true;
+  }
+
+  const LogIndexHeader *header = nullptr;
+  const LogIndexGroup *groups = nullptr;
+  const LogIndexEvent *events = nullptr;
+};
@@ -1,5 +1,6 @@
 #include "system/loggerd/logger.h"
 
+#include <cstring>
 #include <fstream>
 #include <map>
 #include <vector>
@@ -7,9 +8,13 @@
 #include <sstream>
 #include <random>
 
+#include <capnp/schema.h>
+
 #include "common/params.h"
 #include "common/swaglog.h"
 #include "common/version.h"
+#include "system/loggerd/async_writer.h"
+#include "system/loggerd/zstd_writer.h"
 
 // ***** log metadata *****
 kj::Array<capnp::word> logger_build_init_data() {
@@ -125,19 +130,21 @@ LoggerState::LoggerState(const std::string &log_root) {
   route_name = logger_get_identifier("RouteCount");
   route_path = log_root + "/" + route_name;
   init_data = logger_build_init_data();
+  io.reset(new LogWriterThread());
 }
 
 LoggerState::~LoggerState() {
   if (rlog) {
+    // the lock file is removed by the writer thread once rlog is closed
     log_sentinel(this, SentinelType::END_OF_ROUTE, exit_signal);
-    std::remove(lock_file.c_str());
+    writeIndex();
   }
 }
 
 bool LoggerState::next() {
   if (rlog) {
     log_sentinel(this, SentinelType::END_OF_SEGMENT);
-    std::remove(lock_file.c_str());
+    writeIndex();
   }
 
   segment_path = route_path + "--" + std::to_string(++part);
@@ -148,8 +155,14 @@ bool LoggerState::next() {
   lock_file = rlog_path + ".lock";
   std::ofstream{lock_file};
 
-  rlog.reset(new RawFile(rlog_path));
-  qlog.reset(new RawFile(segment_path + "/qlog"));
+  const std::string qlog_path = segment_path + "/qlog";
+  if (LOG_COMPRESSION) {
+    rlog.reset(new AsyncLogFile(io.get(), new ZstdFileWriter(rlog_path + ".zst", LOG_COMPRESSION_LEVEL), lock_file));
+    qlog.reset(new AsyncLogFile(io.get(), new ZstdFileWriter(qlog_path + ".zst", LOG_COMPRESSION_LEVEL)));
+  } else {
+    rlog.reset(new AsyncLogFile(io.get(), new RawFile(rlog_path), lock_file));
+    qlog.reset(new AsyncLogFile(io.get(), new RawFile(qlog_path)));
+  }
 
   // log init data & sentinel type.
   write(init_data.asBytes(), true);
@@ -157,7 +170,74 @@ bool LoggerState::next() {
   return true;
 }
 
+// Reads the type and logMonoTime of an event straight from its root struct, without setting up a
+// message reader for every event loggerd writes. Returns false for a message it can't read that way.
+static bool read_event_header(const uint8_t *data, size_t size, uint16_t &which, uint64_t &mono_time) {
+  static const size_t which_offset = capnp::Schema::from<cereal::Event>().getProto().getStruct().getDiscriminantOffset() * sizeof(uint16_t);
+
+  uint32_t segments;
+  if (size < sizeof(capnp::word)) return false;
+  memcpy(&segments, data, sizeof(segments));
+  // the segment table is padded to a word, the root pointer starts the first segment
+  const size_t root = ((segments + 1) / 2 + 1) * sizeof(capnp::word);
+  uint64_t ptr;
+  if (segments > 512 || root + sizeof(ptr) > size) return false;
+  memcpy(&ptr, data + root, sizeof(ptr));
+  if ((ptr & 3) != 0) return false;  // not a struct pointer in the first segment
+
+  const int64_t begin = root + sizeof(ptr) + (int64_t)((int32_t)ptr >> 2) * sizeof(capnp::word);
+  const size_t data_size = ((ptr >> 32) & 0xffff) * sizeof(capnp::word);
+  if (begin < (int64_t)(root + sizeof(ptr)) || begin + data_size > size) return false;
+
+  // fields beyond the data section are zero
+  which = 0;
+  mono_time = 0;
+  if (data_size >= sizeof(mono_time)) memcpy(&mono_time, data + begin, sizeof(mono_time));
+  if (data_size >= which_offset + sizeof(which)) memcpy(&which, data + begin + which_offset, sizeof(which));
+  return true;
+}
+
 void LoggerState::write(uint8_t* data, size_t size, bool in_qlog) {
   rlog->write(data, size);
   if (in_qlog) qlog->write(data, size);
+
+  // the index maps raw logs, there is none for compressed ones
+  if (LOG_COMPRESSION) return;
+
+  uint16_t which;
+  uint64_t mono_time;
+  if (!read_event_header(data, size, which, mono_time)) {
+    // msgq buffers are word aligned, copy anything else before reading the event
+    auto words = ((uintptr_t)data % sizeof(capnp::word)) == 0
+                     ? kj::ArrayPtr<const capnp::word>((const capnp::word *)data, size / sizeof(capnp::word))
+                     : aligned_buf.align((const char *)data, size);
+    capnp::FlatArrayMessageReader reader(words);
+    auto event = reader.getRoot<cereal::Event>();
+    which = event.which();
+    mono_time = event.getLogMonoTime();
+  }
+  rlog_index.add(which, mono_time, size);
+  if (in_qlog) qlog_index.add(which, mono_time, size);
+}
+
+void LoggerState::writeIndex() {
+  if (LOG_COMPRESSION) return;
+
+  // queued on the writer thread ahead of closing rlog, so the index is complete once the lock file is gone
+  for (auto [index, name] : {std::pair{&rlog_index, "/rlog.idx"}, std::pair{&qlog_index, "/qlog.idx"}}) {
+    std::string data = index->finish();
+    AsyncLogFile(io.get(), new RawFile(segment_path + name)).write(data.data(), data.size());
+    index->clear();
+  }
+}
+
+void LoggerState::flush() {
+  if (rlog) {
+    rlog->flush();
+    qlog->flush();
+  }
+}
+
+LogWriterStats LoggerState::writerStats() {
+  return io->stats();
 }
@@ -7,8 +7,20 @@
 #include "cereal/messaging/messaging.h"
 #include "common/util.h"
 #include "system/hardware/hw.h"
+#include "system/loggerd/log_index.h"
 
-class RawFile {
+// set LOG_COMPRESSION to write zstd compressed rlog.zst/qlog.zst instead of raw logs
+const bool LOG_COMPRESSION = getenv("LOG_COMPRESSION");
+const int LOG_COMPRESSION_LEVEL = 10;
+
+class LogFileWriter {
+ public:
+  virtual ~LogFileWriter() {}
+  virtual void write(void* data, size_t size) = 0;
+  inline void write(kj::ArrayPtr<capnp::byte> array) { write(array.begin(), array.size()); }
+};
+
+class RawFile : public LogFileWriter {
  public:
   RawFile(const std::string &path) {
     file = util::safe_fopen(path.c_str(), "wb");
@@ -19,11 +31,11 @@ class RawFile {
     int err = fclose(file);
     assert(err == 0);
   }
-  inline void write(void* data, size_t size) {
+  void write(void* data, size_t size) override {
     int written = util::safe_fwrite(data, 1, size, file);
     assert(written == size);
   }
-  inline void write(kj::ArrayPtr<capnp::byte> array) { write(array.begin(), array.size()); }
+  using LogFileWriter::write;
 
  private:
   FILE* file = nullptr;
@@ -31,6 +43,10 @@ class RawFile {
 
 typedef cereal::Sentinel::SentinelType SentinelType;
 
+class AsyncLogFile;
+class LogWriterThread;
+struct LogWriterStats;
+
 
 class LoggerState {
 public:
@@ -43,12 +59,22 @@ public:
   inline const std::string& routeName() const { return route_name; }
   inline void write(kj::ArrayPtr<kj::byte> bytes, bool in_qlog) { write(bytes.begin(), bytes.size(), in_qlog); }
   inline void setExitSignal(int signal) { exit_signal = signal; }
+  // hand partially filled blocks to the writer thread
+  void flush();
+  LogWriterStats writerStats();
 
 protected:
+  // write rlog.idx/qlog.idx of the current segment
+  void writeIndex();
+
   int part = -1, exit_signal = 0;
   std::string route_path, route_name, segment_path, lock_file;
   kj::Array<capnp::word> init_data;
-  std::unique_ptr<RawFile> rlog, qlog;
+  AlignedBuffer aligned_buf;
+  LogIndexBuilder rlog_index, qlog_index;
+  // declared before the files, which must be closed before the writer thread exits
+  std::unique_ptr<LogWriterThread> io;
+  std::unique_ptr<AsyncLogFile> rlog, qlog;
 };
 
 kj::Array<capnp::word> logger_build_init_data();
@@ -7,6 +7,7 @@
 #include <vector>
 
 #include "common/params.h"
+#include "system/loggerd/async_writer.h"
 #include "system/loggerd/encoder/encoder.h"
 #include "system/loggerd/loggerd.h"
 #include "system/loggerd/video_writer.h"
@@ -197,6 +198,28 @@ void handle_user_flag(LoggerdState *s) {
   prev_segment = s->logger.segment();
 }
 
+void publish_stats(LoggerdState *s, PubMaster *pm, double dt_secs, uint64_t *prev_bytes_written) {
+  // submit partially filled blocks, so slow logs like qlog reach the disk regularly
+  s->logger.flush();
+
+  LogWriterStats stats = s->logger.writerStats();
+  MessageBuilder msg;
+  auto ls = msg.initEvent().initLoggerdStats();
+  ls.setQueueDepth(stats.queue_depth);
+  ls.setMaxQueueDepth(stats.max_queue_depth);
+  ls.setQueueCapacity(stats.queue_capacity);
+  ls.setMaxWriteLatencyMs(stats.max_write_latency_ms);
+  ls.setWriteBytesPerSec((stats.bytes_written - *prev_bytes_written) / dt_secs);
+  ls.setStallCount(stats.stall_count);
+  ls.setStallTimeMs(stats.stall_time_ms);
+  pm->send("loggerdStats", msg);
+
+  if (stats.stall_count > 0) {
+    LOGW("log writer stalled %u times for %.2f ms", stats.stall_count, stats.stall_time_ms);
+  }
+  *prev_bytes_written = stats.bytes_written;
+}
+
 void loggerd_thread() {
   // setup messaging
   typedef struct ServiceState {
@@ -209,6 +232,7 @@ void loggerd_thread() {
 
   std::unique_ptr<Context> ctx(Context::create());
   std::unique_ptr<Poller> poller(Poller::create());
+  PubMaster pm({"loggerdStats"});
 
   // subscribe to all socks
   for (const auto& [_, it] : services) {
@@ -242,8 +266,9 @@ void loggerd_thread() {
     }
   }
 
-  uint64_t msg_count = 0, bytes_count = 0;
+  uint64_t msg_count = 0, bytes_count = 0, bytes_written = 0;
   double start_ts = millis_since_boot();
+  double last_stats_ts = start_ts;
   while (!do_exit) {
     // poll for new messages on all sockets
     for (auto sock : poller->poll(1000)) {
@@ -282,6 +307,12 @@ void loggerd_thread() {
         }
       }
     }
+
+    double cur_ts = millis_since_boot();
+    if (cur_ts - last_stats_ts >= 1000) {
+      publish_stats(&s, &pm, (cur_ts - last_stats_ts) / 1000.0, &bytes_written);
+      last_stats_ts = cur_ts;
+    }
   }
 
   LOGW("closing logger");
@@ -1,8 +1,45 @@
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+
+#include <zstd.h>
+
+#include <ctime>
+#include <fstream>
+#include <set>
+
 #include "catch2/catch.hpp"
+#include "system/loggerd/async_writer.h"
 #include "system/loggerd/logger.h"
+#include "system/loggerd/zstd_writer.h"
 
 typedef cereal::Sentinel::SentinelType SentinelType;
 
+void verify_index(const std::string &log, const std::string &index_data, int total_events) {
+  LogIndexView index;
+  REQUIRE(index.parse(index_data));
+  REQUIRE(index.header->log_size == log.size());
+  REQUIRE(index.header->num_events == total_events);
+
+  const capnp::word *words = (const capnp::word *)log.data();
+  std::set<uint32_t> offsets;
+  for (uint32_t i = 0; i < index.header->num_groups; ++i) {
+    const LogIndexGroup &group = index.groups[i];
+    if (i > 0) {
+      const LogIndexGroup &prev = index.groups[i - 1];
+      REQUIRE((prev.which < group.which || (prev.which == group.which && prev.bucket < group.bucket)));
+    }
+    for (uint32_t j = group.first_event; j < group.first_event + group.num_events; ++j) {
+      const LogIndexEvent &e = index.events[j];
+      capnp::FlatArrayMessageReader reader(kj::arrayPtr(words + e.offset_words, e.size_words));
+      auto event = reader.getRoot<cereal::Event>();
+      REQUIRE(event.which() == group.which);
+      REQUIRE(event.getLogMonoTime() == e.mono_time);
+      REQUIRE((e.mono_time - index.header->start_mono_time) / index.header->bucket_ns == group.bucket);
+      offsets.insert(e.offset_words);
+    }
+  }
+  REQUIRE(offsets.size() == total_events);
+}
+
 void verify_segment(const std::string &route_path, int segment, int max_segment, int required_event_cnt) {
   const std::string segment_path = route_path + "--" + std::to_string(segment);
   SentinelType begin_sentinel = segment == 0 ? SentinelType::START_OF_ROUTE : SentinelType::START_OF_SEGMENT;
@@ -43,6 +80,7 @@ void verify_segment(const std::string &route_path, int segment, int max_segment,
       }
     }
     REQUIRE(event_cnt == required_event_cnt);
+    verify_index(log, util::read_file(log_file + ".idx"), i);
   }
 }
 
@@ -72,3 +110,129 @@ TEST_CASE("logger") {
     verify_segment(log_root + "/" + route_name, i, segment_cnt, 1);
   }
 }
+
+TEST_CASE("AsyncLogFile") {
+  const std::string path = "/tmp/test_async_log_file";
+  const std::string lock_file = path + ".lock";
+  std::ofstream{lock_file};
+
+  // write more than all blocks can hold, so the writer has to recycle them
+  std::string expected;
+  {
+    LogWriterThread io;
+    AsyncLogFile f(&io, new RawFile(path), lock_file);
+    std::string msg;
+    for (int i = 0; expected.size() < 2 * LOG_BLOCK_COUNT * LOG_BLOCK_SIZE; ++i) {
+      msg = std::to_string(i) + std::string(i % 5000, 'a' + (i % 26));
+      f.write(msg.data(), msg.size());
+      expected += msg;
+      if (i % 1000 == 0) f.flush();
+    }
+    LogWriterStats stats = io.stats();
+    REQUIRE(stats.queue_capacity == LOG_BLOCK_COUNT);
+    REQUIRE(stats.queue_depth <= LOG_BLOCK_COUNT);
+  }
+  REQUIRE(util::read_file(path) == expected);
+  REQUIRE(!util::file_exists(lock_file));
+  std::remove(path.c_str());
+}
+
+std::string decompress_zst(const std::string &in) {
+  ZSTD_DCtx *dctx = ZSTD_createDCtx();
+  std::string out, buf(ZSTD_DStreamOutSize(), '\0');
+  ZSTD_inBuffer input = {in.data(), in.size(), 0};
+  while (input.pos < input.size) {
+    ZSTD_outBuffer output = {&buf[0], buf.size(), 0};
+    size_t ret = ZSTD_decompressStream(dctx, &output, &input);
+    REQUIRE(!ZSTD_isError(ret));
+    out.append(buf.data(), output.pos);
+  }
+  ZSTD_freeDCtx(dctx);
+  return out;
+}
+
+// a segment's worth of CAN traffic, roughly what pandad publishes in 60 seconds
+std::vector<kj::Array<capnp::word>> build_segment_msgs() {
+  std::vector<kj::Array<capnp::word>> msgs;
+  for (int i = 0; i < 60 * 100; ++i) {
+    MessageBuilder msg;
+    auto can = msg.initEvent().initCan(60);
+    for (int j = 0; j < can.size(); ++j) {
+      uint64_t dat = ((uint64_t)i << 16) | (j * 0x1f);
+      can[j].setAddress(0x100 + j * 8);
+      can[j].setSrc(j % 3);
+      can[j].setDat(kj::arrayPtr((capnp::byte *)&dat, sizeof(dat)));
+    }
+    msgs.push_back(capnp::messageToFlatArray(msg));
+  }
+  return msgs;
+}
+
+TEST_CASE("ZstdFileWriter") {
+  const std::string path = "/tmp/test_zstd_writer.zst";
+  std::string raw;
+  auto msgs = build_segment_msgs();
+
+  SECTION("round trip") {
+    {
+      ZstdFileWriter writer(path, LOG_COMPRESSION_LEVEL);
+      for (auto &m : msgs) {
+        writer.write(m.asBytes());
+        raw.append((const char *)m.asBytes().begin(), m.asBytes().size());
+      }
+    }
+    REQUIRE(decompress_zst(util::read_file(path)) == raw);
+  }
+  SECTION("unclosed file is readable up to the last flushed block") {
+    ZstdFileWriter writer(path, LOG_COMPRESSION_LEVEL);
+    for (auto &m : msgs) {
+      writer.write(m.asBytes());
+      raw.append((const char *)m.asBytes().begin(), m.asBytes().size());
+    }
+    std::string partial = decompress_zst(util::read_file(path));
+    REQUIRE(partial.size() > 0);
+    REQUIRE(raw.size() - partial.size() <= ZSTD_CStreamInSize());
+    REQUIRE(raw.compare(0, partial.size(), partial) == 0);
+  }
+  std::remove(path.c_str());
+}
+
+TEST_CASE("log writer throughput", "[.][benchmark]") {
+  const std::string path = "/tmp/test_log_writer_bench";
+  auto msgs = build_segment_msgs();
+  size_t raw_size = 0;
+  for (auto &m : msgs) raw_size += m.asBytes().size();
+
+  auto write_segment = [&](int level) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    {
+      std::unique_ptr<LogFileWriter> writer;
+      if (level > 0) {
+        writer.reset(new ZstdFileWriter(path, level));
+      } else {
+        writer.reset(new RawFile(path));
+      }
+      for (auto &m : msgs) writer->write(m.asBytes());
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
+    double cpu_ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) * 1e-6;
+    size_t written = util::read_file(path).size();
+    printf("%-8s level %2d: cpu %8.2f ms/segment, wrote %10zu bytes (%.2fx)\n",
+           level > 0 ? "zstd" : "raw", level, cpu_ms, written, (double)raw_size / written);
+  };
+
+  for (int level : {0, 1, 3, 6, LOG_COMPRESSION_LEVEL, 15}) {
+    write_segment(level);
+  }
+
+  BENCHMARK("raw") {
+    RawFile writer(path);
+    for (auto &m : msgs) writer.write(m.asBytes());
+  };
+  BENCHMARK("zstd") {
+    ZstdFileWriter writer(path, LOG_COMPRESSION_LEVEL);
+    for (auto &m : msgs) writer.write(m.asBytes());
+  };
+  std::remove(path.c_str());
+}
@@ -0,0 +1,58 @@
+#include "system/loggerd/zstd_writer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "common/util.h"
+
+ZstdFileWriter::ZstdFileWriter(const std::string &path, int compression_level) {
+  cctx = ZSTD_createCCtx();
+  assert(cctx != nullptr);
+  size_t ret = ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, compression_level);
+  assert(!ZSTD_isError(ret));
+
+  input_buf.resize(ZSTD_CStreamInSize());
+  output_buf.resize(ZSTD_CStreamOutSize());
+
+  file = util::safe_fopen(path.c_str(), "wb");
+  assert(file != nullptr);
+}
+
+ZstdFileWriter::~ZstdFileWriter() {
+  compress(ZSTD_e_end);
+  util::safe_fflush(file);
+  int err = fclose(file);
+  assert(err == 0);
+  ZSTD_freeCCtx(cctx);
+}
+
+void ZstdFileWriter::write(void* data, size_t size) {
+  const uint8_t *src = (const uint8_t *)data;
+  while (size > 0) {
+    size_t n = std::min(size, input_buf.size() - input_size);
+    memcpy(input_buf.data() + input_size, src, n);
+    input_size += n;
+    src += n;
+    size -= n;
+
+    if (input_size == input_buf.size()) {
+      compress(ZSTD_e_flush);
+      util::safe_fflush(file);
+    }
+  }
+}
+
+void ZstdFileWriter::compress(ZSTD_EndDirective mode) {
+  ZSTD_inBuffer input = {input_buf.data(), input_size, 0};
+  size_t remaining = 0;
+  do {
+    ZSTD_outBuffer output = {output_buf.data(), output_buf.size(), 0};
+    remaining = ZSTD_compressStream2(cctx, &output, &input, mode);
+    assert(!ZSTD_isError(remaining));
+
+    size_t written = util::safe_fwrite(output_buf.data(), 1, output.pos, file);
+    assert(written == output.pos);
+  } while (remaining != 0);
+  input_size = 0;
+}
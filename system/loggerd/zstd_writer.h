@@ -0,0 +1,27 @@
+#pragma once
+
+#include <zstd.h>
+
+#include <string>
+#include <vector>
+
+#include "system/loggerd/logger.h"
+
+// Streams data into a single zstd frame. Input is compressed in blocks of
+// ZSTD_CStreamInSize() and each block is flushed to the file as soon as it is
+// full, so a crash loses at most one block and the file stays decodable.
+class ZstdFileWriter : public LogFileWriter {
+public:
+  ZstdFileWriter(const std::string &path, int compression_level);
+  ~ZstdFileWriter();
+  void write(void* data, size_t size) override;
+  using LogFileWriter::write;
+
+private:
+  void compress(ZSTD_EndDirective mode);
+
+  ZSTD_CCtx *cctx = nullptr;
+  std::vector<uint8_t> input_buf, output_buf;
+  size_t input_size = 0;
+  FILE* file = nullptr;
+};
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "system/ubloxd/ubx_framer.h"
+
+static std::string ubx_frame(uint8_t msg_class, uint8_t msg_id, const std::string &payload) {
+  std::string msg = {(char)ublox::PREAMBLE1, (char)ublox::PREAMBLE2, (char)msg_class, (char)msg_id,
+                     (char)(payload.size() & 0xff), (char)(payload.size() >> 8)};
+  msg += payload;
+  uint8_t ck_a = 0, ck_b = 0;
+  for (size_t i = 2; i < msg.size(); i++) {
+    ck_a += msg[i];
+    ck_b += ck_a;
+  }
+  msg.push_back(ck_a);
+  msg.push_back(ck_b);
+  return msg;
+}
+
+// a false preamble holds back the frames after it until its length worth of data arrives,
+// zeros after a stream flush them out
+static const std::string idle(ublox::UBLOX_HEADER_SIZE + 0xffff + ublox::UBLOX_CHECKSUM_SIZE, '\0');
+
+struct UbxStream {
+  std::string data;
+  // the frames that made it through uncorrupted
+  std::vector<std::string> frames;
+};
+
+// epochs of the messages ubloxd gets, with the given share of frames corrupted,
+// truncated or followed by garbage
+static UbxStream ubx_stream(int epochs, double corrupt_rate, uint32_t seed = 0) {
+  std::mt19937 rng(seed);
+  auto random_bytes = [&](int size) {
+    std::string s(size, '\0');
+    for (auto &c : s) c = rng();
+    return s;
+  };
+  auto chance = [&](double p) { return std::uniform_real_distribution<>(0, 1)(rng) < p; };
+
+  UbxStream stream;
+  for (int i = 0; i < epochs; ++i) {
+    std::vector<std::string> epoch = {
+      ubx_frame(0x01, 0x07, random_bytes(92)),           // NAV-PVT
+      ubx_frame(0x02, 0x15, random_bytes(16 + 32 * 24)),  // RXM-RAWX
+      ubx_frame(0x02, 0x13, random_bytes(8 + 4 * 10)),    // RXM-SFRBX
+      ubx_frame(0x01, 0x35, random_bytes(8 + 12 * 24)),   // NAV-SAT
+      ubx_frame(0x0a, 0x09, random_bytes(60)),            // MON-HW
+    };
+    for (auto &frame : epoch) {
+      if (chance(corrupt_rate)) {
+        frame[rng() % frame.size()] ^= 1 + rng() % 255;
+      } else if (chance(corrupt_rate)) {
+        frame.resize(rng() % frame.size());
+      } else {
+        stream.frames.push_back(frame);
+      }
+      stream.data += frame;
+      if (chance(corrupt_rate)) {
+        // garbage with plenty of preambles in it
+        std::string garbage = random_bytes(rng() % 64);
+        for (auto &c : garbage) {
+          if (chance(0.2)) c = chance(0.5) ? ublox::PREAMBLE1 : ublox::PREAMBLE2;
+        }
+        stream.data += garbage;
+      }
+    }
+  }
+  stream.data += idle;
+  return stream;
+}
+
+// feeds data to the framer like ubloxd does, in chunks of up to max_chunk bytes
+template <class OnFrame>
+static void feed(UbxFramer &framer, const std::string &data, size_t max_chunk, OnFrame on_frame) {
+  std::mt19937 rng(0);
+  for (size_t pos = 0; pos < data.size();) {
+    const size_t chunk_end = std::min(data.size(), pos + 1 + rng() % max_chunk);
+    while (pos < chunk_end) {
+      pos += framer.add_data((const uint8_t *)data.data() + pos, chunk_end - pos);
+      while (framer.next_frame()) {
+        on_frame(framer.frame(), framer.size());
+      }
+    }
+  }
+}
+
+static std::vector<std::string> frame_stream(UbxFramer &framer, const std::string &data, size_t max_chunk) {
+  std::vector<std::string> frames;
+  feed(framer, data, max_chunk, [&](const uint8_t *frame, size_t size) {
+    frames.emplace_back((const char *)frame, size);
+  });
+  return frames;
+}
+
+TEST_CASE("UbxFramer") {
+  auto framer = std::make_unique<UbxFramer>();
+
+  SECTION("clean stream") {
+    auto stream = ubx_stream(200, 0);
+    for (size_t max_chunk : {1, 7, 1024, 65536}) {
+      framer->reset();
+      REQUIRE(frame_stream(*framer, stream.data, max_chunk) == stream.frames);
+    }
+  }
+
+  SECTION("corrupted stream") {
+    auto stream = ubx_stream(200, 0.1, 1);
+    REQUIRE(stream.frames.size() < 200 * 5);
+    for (size_t max_chunk : {1, 7, 1024, 65536}) {
+      framer->reset();
+      REQUIRE(frame_stream(*framer, stream.data, max_chunk) == stream.frames);
+    }
+  }
+
+  SECTION("garbage") {
+    std::string garbage(20000, (char)ublox::PREAMBLE1);
+    for (size_t i = 1; i < garbage.size(); i += 2) garbage[i] = ublox::PREAMBLE2;
+    const std::string frame = ubx_frame(0x01, 0x07, std::string(92, 'x'));
+    REQUIRE(frame_stream(*framer, garbage + frame + idle, 4096) == std::vector<std::string>{frame});
+  }
+
+  SECTION("largest frame") {
+    const std::string frame = ubx_frame(0x02, 0x15, std::string(0xffff, 'x'));
+    const std::string data = "garbage" + frame + frame;
+    REQUIRE(frame_stream(*framer, data, 1000) == std::vector<std::string>{frame, frame});
+  }
+}
+
+TEST_CASE("UbxFramer benchmark", "[.][benchmark]") {
+  auto framer = std::make_unique<UbxFramer>();
+  auto run = [&](const char *name, const std::string &data) {
+    size_t frames = 0;
+    framer->reset();
+    auto start = std::chrono::steady_clock::now();
+    feed(*framer, data, 4096, [&](const uint8_t *frame, size_t size) { ++frames; });
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("%s: %.1f MB, %zu frames, %.1f MB/s\n", name, data.size() / 1e6, frames, data.size() / 1e6 / secs);
+  };
+
+  for (double corrupt_rate : {0.0, 0.01, 0.1, 0.5}) {
+    run((std::to_string(int(corrupt_rate * 100)) + "% corrupted").c_str(), ubx_stream(20000, corrupt_rate).data);
+  }
+
+  std::mt19937 rng(0);
+  std::string noise(64 << 20, '\0');
+  for (auto &c : noise) c = rng();
+  run("random bytes", noise);
+}
@@ -9,95 +9,43 @@
 #include <cstdio>
 #include <cstdlib>
 #include <ctime>
+#include <istream>
+#include <streambuf>
 #include <unordered_map>
 #include <utility>
 
 #include "common/swaglog.h"
 
 const double gpsPi = 3.1415926535898;
-#define UBLOX_MSG_SIZE(hdr) (*(uint16_t *)&hdr[4])
 
 inline static bool bit_to_bool(uint8_t val, int shifts) {
   return (bool)(val & (1 << shifts));
 }
 
-inline int UbloxMsgParser::needed_bytes() {
-  // Msg header incomplete?
-  if (bytes_in_parse_buf < ublox::UBLOX_HEADER_SIZE)
-    return ublox::UBLOX_HEADER_SIZE + ublox::UBLOX_CHECKSUM_SIZE - bytes_in_parse_buf;
-  uint16_t needed = UBLOX_MSG_SIZE(msg_parse_buf) + ublox::UBLOX_HEADER_SIZE + ublox::UBLOX_CHECKSUM_SIZE;
-  // too much data
-  if (needed < (uint16_t)bytes_in_parse_buf)
-    return -1;
-  return needed - (uint16_t)bytes_in_parse_buf;
-}
-
-inline bool UbloxMsgParser::valid_cheksum() {
-  uint8_t ck_a = 0, ck_b = 0;
-  for (int i = 2; i < bytes_in_parse_buf - ublox::UBLOX_CHECKSUM_SIZE; i++) {
-    ck_a = (ck_a + msg_parse_buf[i]) & 0xFF;
-    ck_b = (ck_b + ck_a) & 0xFF;
-  }
-  if (ck_a != msg_parse_buf[bytes_in_parse_buf - 2]) {
-    LOGD("Checksum a mismatch: %02X, %02X", ck_a, msg_parse_buf[6]);
-    return false;
+// reads the message in place, kaitai::kstream would copy a std::string into a std::istringstream
+class FrameBuf : public std::streambuf {
+public:
+  FrameBuf(const uint8_t *data, size_t size) {
+    char *p = (char *)data;
+    setg(p, p, p + size);
   }
-  if (ck_b != msg_parse_buf[bytes_in_parse_buf - 1]) {
-    LOGD("Checksum b mismatch: %02X, %02X", ck_b, msg_parse_buf[7]);
-    return false;
-  }
-  return true;
-}
 
-inline bool UbloxMsgParser::valid() {
-  return bytes_in_parse_buf >= ublox::UBLOX_HEADER_SIZE + ublox::UBLOX_CHECKSUM_SIZE &&
-         needed_bytes() == 0 && valid_cheksum();
-}
-
-inline bool UbloxMsgParser::valid_so_far() {
-  if (bytes_in_parse_buf > 0 && msg_parse_buf[0] != ublox::PREAMBLE1) {
-    return false;
+protected:
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+    char *p = (dir == std::ios_base::beg ? eback() : dir == std::ios_base::cur ? gptr() : egptr()) + off;
+    if (p < eback() || p > egptr()) return pos_type(off_type(-1));
+    setg(eback(), p, egptr());
+    return pos_type(p - eback());
   }
-  if (bytes_in_parse_buf > 1 && msg_parse_buf[1] != ublox::PREAMBLE2) {
-    return false;
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
   }
-  if (needed_bytes() == 0 && !valid()) {
-    return false;
-  }
-  return true;
-}
-
-bool UbloxMsgParser::add_data(float log_time, const uint8_t *incoming_data, uint32_t incoming_data_len, size_t &bytes_consumed) {
-  last_log_time = log_time;
-  int needed = needed_bytes();
-  if (needed > 0) {
-    bytes_consumed = std::min((uint32_t)needed, incoming_data_len);
-    // Add data to buffer
-    memcpy(msg_parse_buf + bytes_in_parse_buf, incoming_data, bytes_consumed);
-    bytes_in_parse_buf += bytes_consumed;
-  } else {
-    bytes_consumed = incoming_data_len;
-  }
-
-  // Validate msg format, detect invalid header and invalid checksum.
-  while (!valid_so_far() && bytes_in_parse_buf != 0) {
-    // Corrupted msg, drop a byte.
-    bytes_in_parse_buf -= 1;
-    if (bytes_in_parse_buf > 0)
-      memmove(&msg_parse_buf[0], &msg_parse_buf[1], bytes_in_parse_buf);
-  }
-
-  // There is redundant data at the end of buffer, reset the buffer.
-  if (needed_bytes() == -1) {
-    bytes_in_parse_buf = 0;
-  }
-  return valid();
-}
-
+};
 
 std::pair<std::string, kj::Array<capnp::word>> UbloxMsgParser::gen_msg() {
-  std::string dat = data();
-  kaitai::kstream stream(dat);
+  FrameBuf frame_buf(framer.frame(), framer.size());
+  std::istream is(&frame_buf);
+  kaitai::kstream stream(&is);
 
   ubx_t ubx_message(&stream);
   auto body = ubx_message.body();
@@ -13,6 +13,7 @@
 #include "system/ubloxd/generated/gps.h"
 #include "system/ubloxd/generated/glonass.h"
 #include "system/ubloxd/generated/ubx.h"
+#include "system/ubloxd/ubx_framer.h"
 
 using namespace std::string_literals;
 
@@ -23,13 +24,6 @@ const int SECS_IN_WEEK = 7 * SECS_IN_DAY;
 
 // protocol constants
 namespace ublox {
-  const uint8_t PREAMBLE1 = 0xb5;
-  const uint8_t PREAMBLE2 = 0x62;
-
-  const int UBLOX_HEADER_SIZE = 6;
-  const int UBLOX_CHECKSUM_SIZE = 2;
-  const int UBLOX_MAX_MSG_SIZE = 65536;
-
   struct ubx_mga_ini_time_utc_t {
     uint8_t type;
     uint8_t version;
@@ -92,10 +86,15 @@ namespace ublox {
 
 class UbloxMsgParser {
   public:
-    bool add_data(float log_time, const uint8_t *incoming_data, uint32_t incoming_data_len, size_t &bytes_consumed);
-    inline void reset() {bytes_in_parse_buf = 0;}
-    inline int needed_bytes();
-    inline std::string data() {return std::string((const char*)msg_parse_buf, bytes_in_parse_buf);}
+    // buffers incoming data, returns how much of it fit. call next_msg() until it returns false to make room.
+    inline size_t add_data(float log_time, const uint8_t *incoming_data, size_t incoming_data_len) {
+      last_log_time = log_time;
+      return framer.add_data(incoming_data, incoming_data_len);
+    }
+    // finds the next complete message in the buffered data, for gen_msg() to decode
+    inline bool next_msg() {return framer.next_frame();}
+    inline void reset() {framer.reset();}
+    inline std::string data() {return std::string((const char*)framer.frame(), framer.size());}
 
     std::pair<std::string, kj::Array<capnp::word>> gen_msg();
     kj::Array<capnp::word> gen_nav_pvt(ubx_t::nav_pvt_t *msg);
@@ -106,18 +105,13 @@ class UbloxMsgParser {
     kj::Array<capnp::word> gen_nav_sat(ubx_t::nav_sat_t *msg);
 
   private:
-    inline bool valid_cheksum();
-    inline bool valid();
-    inline bool valid_so_far();
-
     kj::Array<capnp::word> parse_gps_ephemeris(ubx_t::rxm_sfrbx_t *msg);
     kj::Array<capnp::word> parse_glonass_ephemeris(ubx_t::rxm_sfrbx_t *msg);
 
     std::unordered_map<int, std::unordered_map<int, std::string>> gps_subframes;
 
     float last_log_time = 0.0;
-    size_t bytes_in_parse_buf = 0;
-    uint8_t msg_parse_buf[ublox::UBLOX_HEADER_SIZE + ublox::UBLOX_MAX_MSG_SIZE];
+    UbxFramer framer;
 
     // user range accuracy in meters
     const std::unordered_map<uint8_t, float> glonass_URA_lookup =
@@ -42,9 +42,9 @@ int main() {
     size_t bytes_consumed = 0;
 
     while (bytes_consumed < len && !do_exit) {
-      size_t bytes_consumed_this_time = 0U;
-      if (parser.add_data(log_time, data + bytes_consumed, (uint32_t)(len - bytes_consumed), bytes_consumed_this_time)) {
+      bytes_consumed += parser.add_data(log_time, data + bytes_consumed, len - bytes_consumed);
 
+      while (parser.next_msg()) {
         try {
           auto ublox_msg = parser.gen_msg();
           if (ublox_msg.second.size() > 0) {
@@ -54,10 +54,7 @@ int main() {
         } catch (const std::exception& e) {
           LOGE("Error parsing ublox message %s", e.what());
         }
-
-        parser.reset();
       }
-      bytes_consumed += bytes_consumed_this_time;
     }
   }
 
@@ -0,0 +1,64 @@
+#include "system/ubloxd/ubx_framer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#define UBLOX_MSG_SIZE(hdr) (*(uint16_t *)&hdr[4])
+
+size_t UbxFramer::add_data(const uint8_t *data, size_t len) {
+  len = std::min(len, sizeof(buf) - end);
+  memcpy(buf + end, data, len);
+  end += len;
+  return len;
+}
+
+bool UbxFramer::next_frame() {
+  start += frame_size;
+  frame_size = 0;
+
+  while (start < end) {
+    // skip to the next preamble
+    const uint8_t *p = (const uint8_t *)memchr(buf + start, ublox::PREAMBLE1, end - start);
+    if (p == nullptr) {
+      start = end;
+      break;
+    }
+    start = p - buf;
+
+    const size_t available = end - start;
+    if (available < 2) break;
+    if (buf[start + 1] != ublox::PREAMBLE2) {
+      ++start;
+      continue;
+    }
+    if (available < ublox::UBLOX_HEADER_SIZE) break;
+
+    const size_t size = ublox::UBLOX_HEADER_SIZE + UBLOX_MSG_SIZE((buf + start)) + ublox::UBLOX_CHECKSUM_SIZE;
+    if (available < size) break;
+    if (!valid_checksum(buf + start, size)) {
+      // a corrupted frame, or a preamble that isn't one
+      ++start;
+      continue;
+    }
+
+    frame_size = size;
+    return true;
+  }
+
+  // move what's left of an incomplete frame to the front, to make room for the rest of it
+  if (start > 0) {
+    memmove(buf, buf + start, end - start);
+    end -= start;
+    start = 0;
+  }
+  return false;
+}
+
+bool UbxFramer::valid_checksum(const uint8_t *msg, size_t len) const {
+  uint8_t ck_a = 0, ck_b = 0;
+  for (size_t i = 2; i < len - ublox::UBLOX_CHECKSUM_SIZE; i++) {
+    ck_a += msg[i];
+    ck_b += ck_a;
+  }
+  return ck_a == msg[len - 2] && ck_b == msg[len - 1];
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// protocol framing constants
+namespace ublox {
+  const uint8_t PREAMBLE1 = 0xb5;
+  const uint8_t PREAMBLE2 = 0x62;
+
+  const int UBLOX_HEADER_SIZE = 6;
+  const int UBLOX_CHECKSUM_SIZE = 2;
+  const int UBLOX_MAX_MSG_SIZE = 65536;
+}
+
+// Splits a stream of UBX bytes into frames with a valid checksum, skipping anything in between.
+// The frames are left in the buffer, so they are decoded in place.
+class UbxFramer {
+  public:
+    // appends data to the buffered stream, returns how much of it fit. frame() stays valid.
+    size_t add_data(const uint8_t *data, size_t len);
+    // moves on to the next valid frame in the buffered stream, false if there is no complete one yet
+    bool next_frame();
+    inline void reset() { start = end = frame_size = 0; }
+
+    // the current frame, from the preamble to the checksum
+    inline const uint8_t *frame() const { return buf + start; }
+    inline size_t size() const { return frame_size; }
+
+  private:
+    bool valid_checksum(const uint8_t *msg, size_t len) const;
+
+    // the buffered stream is buf[start, end), it starts with the current frame if there is one
+    size_t start = 0;
+    size_t end = 0;
+    size_t frame_size = 0;
+    uint8_t buf[ublox::UBLOX_HEADER_SIZE + ublox::UBLOX_MAX_MSG_SIZE + ublox::UBLOX_CHECKSUM_SIZE];
+};
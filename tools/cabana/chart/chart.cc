@@ -1,6 +1,7 @@
 #include "tools/cabana/chart/chart.h"
 
 #include <algorithm>
+#include <cmath>
 #include <limits>
 
 #include <QActionGroup>
@@ -17,6 +18,7 @@
 #include <QRubberBand>
 #include <QScreen>
 #include <QWindow>
+#include <QtConcurrent>
 
 #include "tools/cabana/chart/chartswidget.h"
 
@@ -25,7 +27,6 @@ const int AXIS_X_TOP_MARGIN = 4;
 const double MIN_ZOOM_SECONDS = 0.01; // 10ms
 // Define a small value of epsilon to compare double values
 const float EPSILON = 0.000001;
-static inline bool xLessThan(const QPointF &p, float x) { return p.x() < (x - EPSILON); }
 
 ChartView::ChartView(const std::pair<double, double> &x_range, ChartsWidget *parent)
     : charts_widget(parent), QChartView(parent) {
@@ -47,10 +48,12 @@ ChartView::ChartView(const std::pair<double, double> &x_range, ChartsWidget *par
   setMouseTracking(true);
   setTheme(settings.theme == DARK_THEME ? QChart::QChart::ChartThemeDark : QChart::ChartThemeLight);
   signal_value_font.setPointSize(9);
+  lod_watcher = new QFutureWatcher<LodPoints>(this);
 
   QObject::connect(axis_y, &QValueAxis::rangeChanged, this, &ChartView::resetChartCache);
   QObject::connect(axis_y, &QAbstractAxis::titleTextChanged, this, &ChartView::resetChartCache);
   QObject::connect(window()->windowHandle(), &QWindow::screenChanged, this, &ChartView::resetChartCache);
+  QObject::connect(lod_watcher, &QFutureWatcher<LodPoints>::finished, this, &ChartView::lodPointsReady);
 
   QObject::connect(dbc(), &DBCManager::signalRemoved, this, &ChartView::signalRemoved);
   QObject::connect(dbc(), &DBCManager::signalUpdated, this, &ChartView::signalUpdated);
@@ -199,6 +202,7 @@ void ChartView::resizeEvent(QResizeEvent *event) {
     updatePlotArea(align_to, true);
   }
   QChartView::resizeEvent(event);
+  updateLod();
 }
 
 void ChartView::updatePlotArea(int left_pos, bool force) {
@@ -220,6 +224,7 @@ void ChartView::updatePlotArea(int left_pos, bool force) {
     chart()->setPlotArea(rect().adjusted(align_to + left, adjust_top + top, -x_label_size.width() / 2 - right, -x_label_size.height() - bottom));
     chart()->layout()->invalidate();
     resetChartCache();
+    updateLod();
   }
 }
 
@@ -250,6 +255,7 @@ void ChartView::updatePlot(double cur, double min, double max) {
   if (min != axis_x->min() || max != axis_x->max()) {
     axis_x->setRange(min, max);
     updateAxisY();
+    updateLod();
     updateSeriesPoints();
     // update tooltip
     if (tooltip_x >= 0) {
@@ -263,12 +269,13 @@ void ChartView::updatePlot(double cur, double min, double max) {
 void ChartView::updateSeriesPoints() {
   // Show points when zoomed in enough
   for (auto &s : sigs) {
-    auto begin = std::lower_bound(s.vals.cbegin(), s.vals.cend(), axis_x->min(), xLessThan);
-    auto end = std::lower_bound(begin, s.vals.cend(), axis_x->max(), xLessThan);
+    const auto &vals = values(s);
+    int begin = vals.lowerBound(axis_x->min() - EPSILON);
+    int end = vals.lowerBound(axis_x->max() - EPSILON);
     if (begin != end) {
       int num_points = std::max<int>((end - begin), 1);
-      QPointF right_pt = end == s.vals.cend() ? s.vals.back() : *end;
-      double pixels_per_point = (chart()->mapToPosition(right_pt).x() - chart()->mapToPosition(*begin).x()) / num_points;
+      double right_x = vals.ts(end == vals.size() ? end - 1 : end);
+      double pixels_per_point = (chart()->mapToPosition({right_x, 0}).x() - chart()->mapToPosition({vals.ts(begin), 0}).x()) / num_points;
 
       if (series_type == SeriesType::Scatter) {
         qreal size = std::clamp(pixels_per_point / 2.0, 2.0, 8.0);
@@ -283,50 +290,72 @@ void ChartView::updateSeriesPoints() {
   }
 }
 
-void ChartView::appendCanEvents(const cabana::Signal *sig, const std::vector<const CanEvent *> &events,
-                                std::vector<QPointF> &vals, std::vector<QPointF> &step_vals) {
-  vals.reserve(vals.size() + events.capacity());
-  step_vals.reserve(step_vals.size() + events.capacity() * 2);
+static QVector<QPointF> stepPoints(const QVector<QPointF> &points) {
+  QVector<QPointF> step;
+  step.reserve(points.size() * 2);
+  for (const auto &pt : points) {
+    if (!step.empty()) {
+      step.push_back({pt.x(), step.back().y()});
+    }
+    step.push_back(pt);
+  }
+  return step;
+}
 
-  double value = 0;
-  const uint64_t begin_mono_time = can->routeStartTime() * 1e9;
-  for (const CanEvent *e : events) {
-    if (sig->getValue(e->dat, e->size, &value)) {
-      const double ts = (e->mono_time - std::min(e->mono_time, begin_mono_time)) / 1e9;
-      vals.emplace_back(ts, value);
-      if (!step_vals.empty())
-        step_vals.emplace_back(ts, step_vals.back().y());
-      step_vals.emplace_back(ts, value);
+// half a chart on either side, so scrolling does not need new points right away
+ChartView::LodRange ChartView::lodRange() const {
+  const double span = axis_x->max() - axis_x->min();
+  const int width = std::max<int>(chart()->plotArea().width(), 100);
+  return {axis_x->min() - span / 2, axis_x->max() + span / 2, width * 2};
+}
+
+bool ChartView::decimated(const SigItem &s, const LodRange &range) const {
+  const auto &vals = values(s);
+  return vals.lowerBound(range.max) - vals.lowerBound(range.min) > range.columns * 2;
+}
+
+QVector<QPointF> ChartView::seriesPoints(const SigItem &s, const LodRange &range) const {
+  QVector<QPointF> points;
+  if (decimated(s, range)) {
+    points = s.lod->envelope(range.min, range.max, range.columns);
+  } else {
+    // all points in the range, and the ones on either side so lines run to the edges
+    const auto &vals = values(s);
+    const int first = std::max(vals.lowerBound(range.min) - 1, 0);
+    const int last = std::min<int>(vals.lowerBound(range.max) + 1, vals.size());
+    points.reserve(last - first);
+    for (int i = first; i < last; ++i) {
+      if (!std::isnan(vals.values[i])) {
+        points.push_back({vals.ts(i), vals.values[i]});
+      }
     }
   }
+  return series_type == SeriesType::StepLine ? stepPoints(points) : points;
+}
+
+// new_events went to the end of the column the pyramid was built from
+bool ChartView::appended(const SigItem &s, const std::vector<const CanEvent *> &new_events) const {
+  const auto &events = can->events(s.msg_id);
+  return !new_events.empty() && values(s).size() == s.lod->size() + new_events.size() &&
+         events.size() >= new_events.size() && std::equal(new_events.cbegin(), new_events.cend(), events.cend() - new_events.size());
 }
 
 void ChartView::updateSeries(const cabana::Signal *sig, const MessageEventsMap *msg_new_events) {
+  if (lod_range.columns == 0) {
+    lod_range = lodRange();
+  }
   for (auto &s : sigs) {
-    if (!sig || s.sig == sig) {
-      if (!msg_new_events) {
-        s.vals.clear();
-        s.step_vals.clear();
-      }
-      auto events = msg_new_events ? msg_new_events : &can->eventsMap();
-      auto it = events->find(s.msg_id);
-      if (it == events->end() || it->second.empty()) continue;
-
-      if (s.vals.empty() || (it->second.back()->mono_time / 1e9 - can->routeStartTime()) > s.vals.back().x()) {
-        appendCanEvents(s.sig, it->second, s.vals, s.step_vals);
+    if ((!sig || s.sig == sig) && (!msg_new_events || msg_new_events->count(s.msg_id))) {
+      // the columns are shared by all charts and only decode new events
+      const auto &vals = values(s);
+      if (msg_new_events && s.lod && appended(s, msg_new_events->at(s.msg_id))) {
+        // an envelope may still be built from the pyramid, it is extended in a copy then
+        if (s.lod.use_count() > 1) s.lod = std::make_shared<LodPyramid>(*s.lod);
+        s.lod->append(vals);
       } else {
-        std::vector<QPointF> vals, step_vals;
-        appendCanEvents(s.sig, it->second, vals, step_vals);
-        s.vals.insert(std::lower_bound(s.vals.begin(), s.vals.end(), vals.front().x(), xLessThan),
-                      vals.begin(), vals.end());
-        s.step_vals.insert(std::lower_bound(s.step_vals.begin(), s.step_vals.end(), step_vals.front().x(), xLessThan),
-                           step_vals.begin(), step_vals.end());
-      }
-
-      if (!can->liveStreaming()) {
-        s.segment_tree.build(s.vals);
+        s.lod = std::make_shared<LodPyramid>(vals);
       }
-      s.series->replace(QVector<QPointF>::fromStdVector(series_type == SeriesType::StepLine ? s.step_vals : s.vals));
+      s.series->replace(seriesPoints(s, lod_range));
     }
   }
   updateAxisY();
@@ -334,6 +363,60 @@ void ChartView::updateSeries(const cabana::Signal *sig, const MessageEventsMap *
   QMetaObject::invokeMethod(this, &ChartView::resetChartCache, Qt::QueuedConnection);
 }
 
+// decimate the series for the visible range again once it is zoomed or scrolled out of the
+// points they hold. The envelopes are built off the ui thread from the pyramids, which merged
+// events only extend when nothing else holds them, and are dropped if a series was updated in the meantime.
+void ChartView::updateLod() {
+  if (lod_watcher->isRunning()) {
+    lod_pending = true;
+    return;
+  }
+
+  const LodRange range = lodRange();
+  const double zoom = (range.max - range.min) / (lod_range.max - lod_range.min);
+  if (range.columns == lod_range.columns && axis_x->min() >= lod_range.min && axis_x->max() <= lod_range.max &&
+      std::abs(zoom - 1) < 0.25) {
+    return;
+  }
+
+  lod_range = range;
+  std::vector<std::shared_ptr<const LodPyramid>> pyramids;
+  for (auto &s : sigs) {
+    if (decimated(s, range)) {
+      pyramids.push_back(s.lod);
+    } else {
+      s.series->replace(seriesPoints(s, range));
+    }
+  }
+  if (!pyramids.empty()) {
+    const bool step = series_type == SeriesType::StepLine;
+    lod_watcher->setFuture(QtConcurrent::run([pyramids, range, step]() {
+      LodPoints ret = {.step = step};
+      for (const auto &lod : pyramids) {
+        auto points = lod->envelope(range.min, range.max, range.columns);
+        ret.series.emplace_back(lod, step ? stepPoints(points) : points);
+      }
+      return ret;
+    }));
+  }
+}
+
+void ChartView::lodPointsReady() {
+  const LodPoints result = lod_watcher->result();
+  if (result.step == (series_type == SeriesType::StepLine)) {
+    for (const auto &[lod, points] : result.series) {
+      auto it = std::find_if(sigs.begin(), sigs.end(), [&lod = lod](auto &s) { return s.lod == lod; });
+      if (it != sigs.end()) {
+        it->series->replace(points);
+      }
+    }
+    resetChartCache();
+  }
+  if (std::exchange(lod_pending, false)) {
+    updateLod();
+  }
+}
+
 // auto zoom on yaxis
 void ChartView::updateAxisY() {
   if (sigs.empty()) return;
@@ -350,18 +433,10 @@ void ChartView::updateAxisY() {
       unit.clear();
     }
 
-    auto first = std::lower_bound(s.vals.cbegin(), s.vals.cend(), axis_x->min(), xLessThan);
-    auto last = std::lower_bound(first, s.vals.cend(), axis_x->max(), xLessThan);
-    s.min = std::numeric_limits<double>::max();
-    s.max = std::numeric_limits<double>::lowest();
-    if (can->liveStreaming()) {
-      for (auto it = first; it != last; ++it) {
-        if (it->y() < s.min) s.min = it->y();
-        if (it->y() > s.max) s.max = it->y();
-      }
-    } else {
-      std::tie(s.min, s.max) = s.segment_tree.minmax(std::distance(s.vals.cbegin(), first), std::distance(s.vals.cbegin(), last));
-    }
+    const auto &vals = values(s);
+    int first = vals.lowerBound(axis_x->min() - EPSILON);
+    int last = vals.lowerBound(axis_x->max() - EPSILON);
+    std::tie(s.min, s.max) = s.lod->minmax(vals, first, last);
     min = std::min(min, s.min);
     max = std::max(max, s.max);
   }
@@ -579,12 +654,11 @@ void ChartView::showTip(double sec) {
   for (auto &s : sigs) {
     if (s.series->isVisible()) {
       QString value = "--";
-      // use reverse iterator to find last item <= sec.
-      auto it = std::lower_bound(s.vals.crbegin(), s.vals.crend(), sec, [](auto &p, double x) { return p.x() > x; });
-      if (it != s.vals.crend() && it->x() >= axis_x->min()) {
-        value = s.sig->formatValue(it->y(), false);
-        s.track_pt = *it;
-        x = std::max(x, chart()->mapToPosition(*it).x());
+      const auto &vals = values(s);
+      if (int i = vals.lastValueAt(sec); i >= 0 && vals.ts(i) >= axis_x->min()) {
+        value = s.sig->formatValue(vals.values[i], false);
+        s.track_pt = {vals.ts(i), vals.values[i]};
+        x = std::max(x, chart()->mapToPosition(s.track_pt).x());
       }
       QString name = sigs.size() > 1 ? s.sig->name + ": " : "";
       QString min = s.min == std::numeric_limits<double>::max() ? "--" : QString::number(s.min);
@@ -717,11 +791,13 @@ void ChartView::drawForeground(QPainter *painter, const QRectF &rect) {
   painter->setPen(Qt::NoPen);
   for (auto &s : sigs) {
     if (s.series->useOpenGL() && s.series->isVisible() && s.series->pointsVisible()) {
-      auto first = std::lower_bound(s.vals.cbegin(), s.vals.cend(), axis_x->min(), xLessThan);
-      auto last = std::lower_bound(first, s.vals.cend(), axis_x->max(), xLessThan);
+      const auto &vals = values(s);
+      int last = vals.lowerBound(axis_x->max() - EPSILON);
       painter->setBrush(s.series->color());
-      for (auto it = first; it != last; ++it) {
-        painter->drawEllipse(chart()->mapToPosition(*it), 4, 4);
+      for (int i = vals.lowerBound(axis_x->min() - EPSILON); i < last; ++i) {
+        if (!std::isnan(vals.values[i])) {
+          painter->drawEllipse(chart()->mapToPosition({vals.ts(i), vals.values[i]}), 4, 4);
+        }
       }
     }
   }
@@ -773,9 +849,9 @@ void ChartView::drawSignalValue(QPainter *painter) {
   painter->setPen(chart()->legend()->labelColor());
   int i = 0;
   for (auto &s : sigs) {
-    auto it = std::lower_bound(s.vals.crbegin(), s.vals.crend(), cur_sec,
-                               [](auto &p, double x) { return p.x() > x + EPSILON; });
-    QString value = (it != s.vals.crend() && it->x() >= axis_x->min()) ? s.sig->formatValue(it->y()) : "--";
+    const auto &vals = values(s);
+    int i = vals.lastValueAt(cur_sec + EPSILON);
+    QString value = (i >= 0 && vals.ts(i) >= axis_x->min()) ? s.sig->formatValue(vals.values[i]) : "--";
     QRectF marker_rect = legend_markers[i++]->sceneBoundingRect();
     QRectF value_rect(marker_rect.bottomLeft() - QPoint(0, 1), marker_rect.size());
     QString elided_val = painter->fontMetrics().elidedText(value, Qt::ElideRight, value_rect.width());
@@ -848,7 +924,7 @@ void ChartView::setSeriesType(SeriesType type) {
     }
     for (auto &s : sigs) {
       s.series = createSeries(series_type, s.sig->color);
-      s.series->replace(QVector<QPointF>::fromStdVector(series_type == SeriesType::StepLine ? s.step_vals : s.vals));
+      s.series->replace(seriesPoints(s, lod_range));
     }
     updateSeriesPoints();
     updateTitle();
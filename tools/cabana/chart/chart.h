@@ -1,9 +1,11 @@
 #pragma once
 
+#include <memory>
 #include <tuple>
 #include <utility>
 #include <vector>
 
+#include <QFutureWatcher>
 #include <QMenu>
 #include <QGraphicsPixmapItem>
 #include <QGraphicsProxyWidget>
@@ -14,6 +16,7 @@
 #include <QtCharts/QValueAxis>
 using namespace QtCharts;
 
+#include "tools/cabana/chart/lod.h"
 #include "tools/cabana/chart/tiplabel.h"
 #include "tools/cabana/dbc/dbcmanager.h"
 #include "tools/cabana/streams/abstractstream.h"
@@ -44,10 +47,8 @@ public:
     MessageId msg_id;
     const cabana::Signal *sig = nullptr;
     QXYSeries *series = nullptr;
-    std::vector<QPointF> vals;
-    std::vector<QPointF> step_vals;
     QPointF track_pt{};
-    SegmentTree segment_tree;
+    std::shared_ptr<LodPyramid> lod;
     double min = 0;
     double max = 0;
   };
@@ -62,10 +63,25 @@ private slots:
   void msgUpdated(MessageId id);
   void msgRemoved(MessageId id) { removeIf([=](auto &s) { return s.msg_id.address == id.address && !dbc()->msg(id); }); }
   void signalRemoved(const cabana::Signal *sig) { removeIf([=](auto &s) { return s.sig == sig; }); }
+  void lodPointsReady();
 
 private:
-  void appendCanEvents(const cabana::Signal *sig, const std::vector<const CanEvent *> &events,
-                       std::vector<QPointF> &vals, std::vector<QPointF> &step_vals);
+  // the x range the series hold points for, at most ~2 points per column
+  struct LodRange {
+    double min = 0, max = 0;
+    int columns = 0;
+  };
+  struct LodPoints {
+    bool step = false;
+    std::vector<std::pair<std::shared_ptr<const LodPyramid>, QVector<QPointF>>> series;
+  };
+
+  inline const SignalValues &values(const SigItem &s) const { return can->signalValues(s.msg_id, s.sig); }
+  QVector<QPointF> seriesPoints(const SigItem &s, const LodRange &range) const;
+  bool decimated(const SigItem &s, const LodRange &range) const;
+  bool appended(const SigItem &s, const std::vector<const CanEvent *> &new_events) const;
+  LodRange lodRange() const;
+  void updateLod();
   void createToolButtons();
   void addSeries(QXYSeries *series);
   void contextMenuEvent(QContextMenuEvent *event) override;
@@ -118,6 +134,9 @@ private:
   bool can_drop = false;
   double tooltip_x = -1;
   QFont signal_value_font;
+  LodRange lod_range;
+  QFutureWatcher<LodPoints> *lod_watcher;
+  bool lod_pending = false;
   ChartsWidget *charts_widget;
   friend class ChartsWidget;
 };
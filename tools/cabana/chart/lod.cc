@@ -0,0 +1,135 @@
+#include "tools/cabana/chart/lod.h"
+
+#include <algorithm>
+#include <limits>
+
+static const double EMPTY_MIN = std::numeric_limits<double>::max();
+static const double EMPTY_MAX = std::numeric_limits<double>::lowest();
+
+template <typename T>
+static inline void merge(T &bucket, const T &other) {
+  if (other.min < bucket.min) {
+    bucket.min = other.min;
+    bucket.min_ts = other.min_ts;
+  }
+  if (other.max > bucket.max) {
+    bucket.max = other.max;
+    bucket.max_ts = other.max_ts;
+  }
+}
+
+void LodPyramid::append(const SignalValues &vals) {
+  if (vals.size() <= size_) return;
+
+  // the last bucket of each level may have been partial, it is built again with the new values
+  size_t dirty = size_ / BUCKET_SIZE;
+  size_ = vals.size();
+  if (levels_.empty()) levels_.emplace_back();
+  auto &base = levels_[0];
+  base.resize((size_ + BUCKET_SIZE - 1) / BUCKET_SIZE);
+  for (size_t b = dirty; b < base.size(); ++b) {
+    const size_t first = b * BUCKET_SIZE, last = std::min(first + BUCKET_SIZE, size_);
+    // an empty bucket keeps the time of its first entry
+    Bucket &bucket = base[b];
+    bucket = {EMPTY_MIN, EMPTY_MAX, vals.ts(first), vals.ts(first)};
+    for (size_t i = first; i < last; ++i) {
+      // NaN values of multiplexed signals fail both comparisons
+      const double v = vals.values[i];
+      if (v < bucket.min) {
+        bucket.min = v;
+        bucket.min_ts = vals.ts(i);
+      }
+      if (v > bucket.max) {
+        bucket.max = v;
+        bucket.max_ts = vals.ts(i);
+      }
+    }
+  }
+
+  for (size_t k = 1; levels_[k - 1].size() > 1; ++k) {
+    if (k == levels_.size()) levels_.emplace_back();
+    const auto &prev = levels_[k - 1];
+    auto &level = levels_[k];
+    dirty /= 2;
+    level.resize((prev.size() + 1) / 2);
+    for (size_t b = dirty; b < level.size(); ++b) {
+      level[b] = prev[2 * b];
+      if (2 * b + 1 < prev.size()) merge(level[b], prev[2 * b + 1]);
+    }
+  }
+}
+
+std::pair<double, double> LodPyramid::minmax(const SignalValues &vals, int first, int last) const {
+  std::pair<double, double> ret = {EMPTY_MIN, EMPTY_MAX};
+  auto add = [&ret](double min, double max) {
+    if (min < ret.first) ret.first = min;
+    if (max > ret.second) ret.second = max;
+  };
+
+  // the values outside of whole buckets, then the fewest buckets covering the rest
+  last = std::min<int>(last, size_);
+  for (; first < last && first % BUCKET_SIZE; ++first) add(vals.values[first], vals.values[first]);
+  for (; last > first && last % BUCKET_SIZE; --last) add(vals.values[last - 1], vals.values[last - 1]);
+  int lo = first / BUCKET_SIZE, hi = last / BUCKET_SIZE;
+  for (int level = 0; lo < hi; ++level, lo >>= 1, hi >>= 1) {
+    const auto &buckets = levels_[level];
+    if (lo & 1) {
+      add(buckets[lo].min, buckets[lo].max);
+      ++lo;
+    }
+    if (hi & 1) {
+      --hi;
+      add(buckets[hi].min, buckets[hi].max);
+    }
+  }
+  return ret;
+}
+
+QVector<QPointF> LodPyramid::envelope(double min_x, double max_x, int columns) const {
+  QVector<QPointF> points;
+  if (levels_.empty() || columns <= 0 || max_x <= min_x) return points;
+
+  auto key_less = [](const Bucket &b, double x) { return b.key() < x; };
+  // the coarsest level that still has two buckets per column
+  const auto &base = levels_[0];
+  const int n = std::lower_bound(base.cbegin(), base.cend(), max_x, key_less) -
+                std::lower_bound(base.cbegin(), base.cend(), min_x, key_less);
+  int level = 0;
+  while (level + 1 < levels_.size() && (n >> (level + 2)) >= columns) ++level;
+
+  const auto &buckets = levels_[level];
+  auto it = std::lower_bound(buckets.cbegin(), buckets.cend(), min_x, key_less);
+  if (it != buckets.cbegin()) --it;
+
+  points.reserve((columns + 2) * 2);
+  Bucket cur = {EMPTY_MIN, EMPTY_MAX, 0, 0};
+  auto flush = [&]() {
+    if (cur.min > cur.max) return;
+    if (cur.min_ts == cur.max_ts) {
+      points.push_back({cur.min_ts, cur.min});
+    } else if (cur.min_ts < cur.max_ts) {
+      points.push_back({cur.min_ts, cur.min});
+      points.push_back({cur.max_ts, cur.max});
+    } else {
+      points.push_back({cur.max_ts, cur.max});
+      points.push_back({cur.min_ts, cur.min});
+    }
+  };
+
+  const double scale = columns / (max_x - min_x);
+  int cur_column = -2;
+  for (; it != buckets.cend(); ++it) {
+    const double key = it->key();
+    const int column = key < min_x ? -1 : (key > max_x ? columns : std::min<int>((key - min_x) * scale, columns - 1));
+    if (column != cur_column) {
+      flush();
+      cur = *it;
+      cur_column = column;
+    } else {
+      merge(cur, *it);
+    }
+    if (key > max_x) break;
+  }
+  flush();
+  return points;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <QPointF>
+#include <QVector>
+
+#include "tools/cabana/streams/signalcache.h"
+
+// Min/max envelope of a signal column at power-of-two resolutions. Level k has one bucket
+// per (LodPyramid::BUCKET_SIZE << k) values, so any time range can be drawn with a number
+// of points bounded by the width of the chart instead of the number of values.
+// A pyramid does not reference the column it was built from, and only changes in append().
+class LodPyramid {
+public:
+  static const int BUCKET_SIZE = 8;
+
+  LodPyramid(const SignalValues &vals) { append(vals); }
+  // extends the pyramid with the values appended to vals since it was built,
+  // the values it was built from must be unchanged
+  void append(const SignalValues &vals);
+  // min and max of vals.values[first, last), vals must be the column the pyramid was built from
+  std::pair<double, double> minmax(const SignalValues &vals, int first, int last) const;
+  // the min and the max of each of the columns of [min_x, max_x] in time order, and
+  // of the buckets on either side so lines run to the edges
+  QVector<QPointF> envelope(double min_x, double max_x, int columns) const;
+  inline size_t size() const { return size_; }
+
+private:
+  struct Bucket {
+    double min, max;  // min > max if the bucket has no values
+    double min_ts, max_ts;
+    // buckets are in time order by their earliest point
+    inline double key() const { return std::min(min_ts, max_ts); }
+  };
+
+  std::vector<std::vector<Bucket>> levels_;
+  size_t size_ = 0;
+};
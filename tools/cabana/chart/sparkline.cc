@@ -19,9 +19,10 @@ void Sparkline::update(const MessageId &msg_id, const cabana::Signal *sig, doubl
   }
 
   points.clear();
+  const cabana::SignalDecoder decoder(*sig);
   double value = 0;
   for (auto it = first; it != last; ++it) {
-    if (sig->getValue((*it)->dat, (*it)->size, &value)) {
+    if (decoder.getValue((*it)->dat, (*it)->size, &value)) {
       points.emplace_back(((*it)->mono_time - (*first)->mono_time) / 1e9, value);
     }
   }
@@ -1,7 +1,10 @@
 #include "tools/cabana/dbc/dbc.h"
 
 #include <algorithm>
+#include <cstring>
+#include <iterator>
 
+#include "tools/cabana/dbc/canevent.h"
 #include "tools/cabana/utils/util.h"
 
 uint qHash(const MessageId &item) {
@@ -176,9 +179,9 @@ bool cabana::Signal::operator==(const cabana::Signal &other) const {
          multiplex_value == other.multiplex_value && type == other.type && receiver_name == other.receiver_name;
 }
 
-// helper functions
+// cabana::SignalDecoder
 
-double get_raw_value(const uint8_t *data, size_t data_size, const cabana::Signal &sig) {
+static int64_t get_raw_bits(const uint8_t *data, size_t data_size, const cabana::Signal &sig) {
   int64_t val = 0;
 
   int i = sig.msb / 8;
@@ -197,7 +200,76 @@ double get_raw_value(const uint8_t *data, size_t data_size, const cabana::Signal
   if (sig.is_signed) {
     val -= ((val >> (sig.size - 1)) & 0x1) ? (1ULL << sig.size) : 0;
   }
-  return val * sig.factor + sig.offset;
+  return val;
+}
+
+cabana::SignalDecoder::SignalDecoder(const cabana::Signal &sig)
+    : sig(sig), is_little_endian(sig.is_little_endian), is_signed(sig.is_signed), size(sig.size),
+      factor(sig.factor), offset(sig.offset), multiplex_value(sig.multiplex_value) {
+  first_byte = (is_little_endian ? sig.lsb : sig.msb) / 8;
+  last_byte = (is_little_endian ? sig.msb : sig.lsb) / 8;
+  fast = size > 0 && size <= 64 && first_byte >= 0 && last_byte - first_byte < 8;
+  mask = size >= 64 ? ~0ULL : (1ULL << size) - 1;
+  // a big endian load is byte swapped, which puts the first byte of the load at the top
+  shift = is_little_endian ? sig.lsb : 56 - 8 * (sig.lsb / 8) + sig.lsb % 8;
+  shift_per_byte = is_little_endian ? -8 : 8;
+  if (sig.multiplexor) {
+    multiplexor = std::make_shared<SignalDecoder>(*sig.multiplexor);
+  }
+}
+
+inline int64_t cabana::SignalDecoder::extract(const uint8_t *data, size_t data_size) const {
+  // the 8 bytes starting at the signal, or ending at the message end if the signal is near it
+  uint64_t v = 0;
+  int pos = 0;
+  if (data_size >= 8) {
+    pos = std::min<int>(first_byte, data_size - 8);
+    memcpy(&v, data + pos, 8);
+  } else {
+    memcpy(&v, data, data_size);
+  }
+  if (!is_little_endian) {
+    v = __builtin_bswap64(v);
+  }
+  v = (v >> (shift + pos * shift_per_byte)) & mask;
+  if (is_signed && size < 64) {
+    return (int64_t)(v << (64 - size)) >> (64 - size);
+  }
+  return v;
+}
+
+int64_t cabana::SignalDecoder::raw(const uint8_t *data, size_t data_size) const {
+  return fast && last_byte < data_size ? extract(data, data_size) : get_raw_bits(data, data_size, sig);
+}
+
+void cabana::SignalDecoder::decode(const CanEvent *const *events, size_t count, double *values) const {
+  // extract a block of raw values first, so scaling them is a plain loop the compiler can vectorize
+  int64_t raw_values[256];
+  for (size_t begin = 0; begin < count; begin += std::size(raw_values)) {
+    const size_t n = std::min(count - begin, std::size(raw_values));
+    const CanEvent *const *e = events + begin;
+    for (size_t i = 0; i < n; ++i) {
+      raw_values[i] = fast && last_byte < e[i]->size ? extract(e[i]->dat, e[i]->size) : get_raw_bits(e[i]->dat, e[i]->size, sig);
+    }
+    double *v = values + begin;
+    const double f = factor, o = offset;
+    for (size_t i = 0; i < n; ++i) {
+      v[i] = raw_values[i] * f + o;
+    }
+    if (multiplexor) {
+      for (size_t i = 0; i < n; ++i) {
+        if (multiplexor->value(e[i]->dat, e[i]->size) != multiplex_value) {
+          v[i] = std::numeric_limits<double>::quiet_NaN();
+        }
+      }
+    }
+  }
+}
+
+// helper functions
+
+double get_raw_value(const uint8_t *data, size_t data_size, const cabana::Signal &sig) {
+  return get_raw_bits(data, data_size, sig) * sig.factor + sig.offset;
 }
 
 void updateMsbLsb(cabana::Signal &s) {
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <limits>
+#include <memory>
 #include <utility>
 #include <vector>
 
@@ -47,6 +49,8 @@ struct std::hash<MessageId> {
 
 typedef std::vector<std::pair<double, QString>> ValueDescription;
 
+struct CanEvent;
+
 namespace cabana {
 
 class Signal {
@@ -111,6 +115,39 @@ public:
   cabana::Signal *multiplexor = nullptr;
 };
 
+// A signal compiled for decoding it from many messages: one unaligned 64-bit load, a byte swap
+// for big endian signals, a shift and a mask. Signals spanning more than 8 bytes and messages
+// too short to hold the signal are decoded by get_raw_value(). Must not outlive the signal.
+class SignalDecoder {
+public:
+  SignalDecoder(const Signal &sig);
+  // same as get_raw_value()
+  inline double value(const uint8_t *data, size_t data_size) const { return raw(data, data_size) * factor + offset; }
+  // same as Signal::getValue()
+  inline bool getValue(const uint8_t *data, size_t data_size, double *val) const {
+    if (multiplexor && multiplexor->value(data, data_size) != multiplex_value) return false;
+    *val = value(data, data_size);
+    return true;
+  }
+  // the values of the signal in events, NaN where a multiplexed signal is not present
+  void decode(const CanEvent *const *events, size_t count, double *values) const;
+
+private:
+  int64_t raw(const uint8_t *data, size_t data_size) const;
+  int64_t extract(const uint8_t *data, size_t data_size) const;
+
+  const Signal &sig;
+  bool fast;
+  bool is_little_endian, is_signed;
+  int size, first_byte, last_byte;
+  // the shift of the signal in a load at byte 0, and its change per byte the load is moved by
+  int shift, shift_per_byte;
+  uint64_t mask;
+  double factor, offset;
+  int multiplex_value;
+  std::shared_ptr<SignalDecoder> multiplexor;
+};
+
 }  // namespace cabana
 
 // Helper functions
@@ -1,8 +1,9 @@
 #include "tools/cabana/dbc/dbcfile.h"
 
+#include <cstring>
+
 #include <QFile>
 #include <QFileInfo>
-#include <QRegularExpression>
 
 DBCFile::DBCFile(const QString &dbc_file_name) {
   QFile file(dbc_file_name);
@@ -80,46 +81,151 @@ cabana::Signal *DBCFile::signal(uint32_t address, const QString name) {
   return m ? (cabana::Signal *)m->sig(name) : nullptr;
 }
 
+namespace {
+
+inline bool isDigit(ushort c) { return c >= '0' && c <= '9'; }
+// \w of the regular expressions the parser replaced, which only matched ASCII
+inline bool isWordChar(ushort c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || isDigit(c) || c == '_'; }
+inline bool isNumberChar(ushort c) { return isDigit(c) || c == '.' || c == '+' || c == '-' || c == 'e' || c == 'E'; }
+inline bool isSpace(ushort c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+// Reads the tokens of a statement in place. A statement matches if every token matched,
+// tokens read after one that did not match are empty.
+class Tokenizer {
+public:
+  Tokenizer(const QStringRef &s) : Tokenizer(*s.string(), s.position(), s.position() + s.size()) {}
+  Tokenizer(const QString &s, int pos, int end) : s(s), pos(pos), end(end) {}
+  inline bool ok() const { return ok_; }
+  inline int position() const { return pos; }
+
+  // str, which must be there
+  void expect(const char *str) {
+    if (ok_ && !accept(str)) ok_ = false;
+  }
+  // str, if it is there
+  bool accept(const char *str) {
+    int i = 0;
+    for (; str[i]; ++i) {
+      if (pos + i >= end || s[pos + i].unicode() != (uchar)str[i]) return false;
+    }
+    pos += i;
+    return true;
+  }
+  // any number of c
+  void skip(ushort c) {
+    while (pos < end && s[pos].unicode() == c) ++pos;
+  }
+  // any number of white spaces, line breaks included
+  void skipSpaces() {
+    while (pos < end && isSpace(s[pos].unicode())) ++pos;
+  }
+  // one or more characters of a class
+  QStringRef word() { return take(isWordChar); }
+  QStringRef digits() { return take(isDigit); }
+  QStringRef number() { return take(isNumberChar); }
+  QStringRef spaces() { return take(isSpace); }
+  // a string in double quotes, escaped characters are kept as they are
+  QStringRef quoted() {
+    expect("\"");
+    const int first = pos;
+    while (ok_ && pos < end && s[pos] != '"') {
+      pos += s[pos] == '\\' ? 2 : 1;
+    }
+    if (pos >= end) ok_ = false;
+    if (!ok_) return {};
+    ++pos;
+    return s.midRef(first, pos - first - 1);
+  }
+  // the first of chars
+  QStringRef oneOf(const char *chars) {
+    if (ok_ && pos < end && s[pos].unicode() < 128 && strchr(chars, s[pos].unicode())) return s.midRef(pos++, 1);
+    ok_ = false;
+    return {};
+  }
+  // up to the next c after n characters, which must be there
+  void find(QChar c, int n = 0) {
+    if (!ok_) return;
+    pos += n;
+    skipUntil(c);
+    if (pos >= end) ok_ = false;
+  }
+  // up to the next c, or to the end if there is none
+  void skipUntil(QChar c) {
+    while (pos < end && s[pos] != c) ++pos;
+  }
+  QStringRef rest() {
+    const int first = pos;
+    pos = end;
+    return ok_ ? s.midRef(first, end - first) : QStringRef();
+  }
+
+private:
+  template <typename Pred>
+  QStringRef take(Pred pred) {
+    const int first = pos;
+    while (ok_ && pos < end && pred(s[pos].unicode())) ++pos;
+    if (pos == first) ok_ = false;
+    return ok_ ? s.midRef(first, pos - first) : QStringRef();
+  }
+
+  const QString &s;
+  int pos, end;
+  bool ok_ = true;
+};
+
+}  // namespace
+
 void DBCFile::parse(const QString &content) {
   msgs.clear();
 
   int line_num = 0;
-  QString line;
   cabana::Msg *current_msg = nullptr;
   int multiplexor_cnt = 0;
   bool seen_first = false;
-  QTextStream stream((QString *)&content);
 
-  while (!stream.atEnd()) {
+  for (int pos = 0; pos < content.size();) {
     ++line_num;
-    QString raw_line = stream.readLine();
-    line = raw_line.trimmed();
+    int line_end = content.indexOf('\n', pos);
+    if (line_end == -1) line_end = content.size();
+    int next_line = line_end + 1;
+    // without the line break, \r\n included
+    const bool crlf = line_end < content.size() && line_end > pos && content[line_end - 1] == '\r';
+    const QStringRef raw_line = content.midRef(pos, line_end - pos - crlf);
+    const QStringRef line = raw_line.trimmed();
 
     bool seen = true;
     try {
-      if (line.startsWith("BO_ ")) {
+      int statement_end = -1;
+      if (line.startsWith(QLatin1String("BO_ "))) {
         multiplexor_cnt = 0;
         current_msg = parseBO(line);
-      } else if (line.startsWith("SG_ ")) {
+      } else if (line.startsWith(QLatin1String("SG_ "))) {
         parseSG(line, current_msg, multiplexor_cnt);
-      } else if (line.startsWith("VAL_ ")) {
+      } else if (line.startsWith(QLatin1String("VAL_ "))) {
         parseVAL(line);
-      } else if (line.startsWith("CM_ BO_")) {
-        parseCM_BO(line, content, raw_line, stream);
-      } else if (line.startsWith("CM_ SG_ ")) {
-        parseCM_SG(line, content, raw_line, stream);
+      } else if (line.startsWith(QLatin1String("CM_ BO_"))) {
+        statement_end = parseCM_BO(content, line.position());
+      } else if (line.startsWith(QLatin1String("CM_ SG_ "))) {
+        statement_end = parseCM_SG(content, line.position());
       } else {
         seen = false;
       }
+      // continue after the last line of a multiple line comment
+      if (statement_end > line_end) {
+        line_num += content.midRef(line_end, statement_end - line_end).count('\n');
+        next_line = content.indexOf('\n', statement_end);
+        next_line = next_line == -1 ? content.size() : next_line + 1;
+      }
     } catch (std::exception &e) {
-      throw std::runtime_error(QString("[%1:%2]%3: %4").arg(filename).arg(line_num).arg(e.what()).arg(line).toStdString());
+      throw std::runtime_error(QString("[%1:%2]%3: %4").arg(filename).arg(line_num).arg(e.what()).arg(line.toString()).toStdString());
     }
 
     if (seen) {
       seen_first = true;
     } else if (!seen_first) {
-      header += raw_line + "\n";
+      header += raw_line.toString() + "\n";
     }
+    pos = next_line;
   }
 
   for (auto &[_, m] : msgs) {
@@ -127,66 +233,94 @@ void DBCFile::parse(const QString &content) {
   }
 }
 
-cabana::Msg *DBCFile::parseBO(const QString &line) {
-  static QRegularExpression bo_regexp(R"(^BO_ (?<address>\w+) (?<name>\w+) *: (?<size>\w+) (?<transmitter>\w+))");
-
-  QRegularExpressionMatch match = bo_regexp.match(line);
-  if (!match.hasMatch())
+cabana::Msg *DBCFile::parseBO(const QStringRef &line) {
+  // BO_ <address> <name> *: <size> <transmitter>
+  Tokenizer t(line);
+  t.expect("BO_ ");
+  auto address_str = t.word();
+  t.expect(" ");
+  auto name = t.word();
+  t.skip(' ');
+  t.expect(": ");
+  auto size = t.word();
+  t.expect(" ");
+  auto transmitter = t.word();
+  if (!t.ok())
     throw std::runtime_error("Invalid BO_ line format");
 
-  uint32_t address = match.captured("address").toUInt();
+  uint32_t address = address_str.toUInt();
   if (msgs.count(address) > 0)
     throw std::runtime_error(QString("Duplicate message address: %1").arg(address).toStdString());
 
   // Create a new message object
   cabana::Msg *msg = &msgs[address];
   msg->address = address;
-  msg->name = match.captured("name");
-  msg->size = match.captured("size").toULong();
-  msg->transmitter = match.captured("transmitter").trimmed();
+  msg->name = name.toString();
+  msg->size = size.toULong();
+  msg->transmitter = transmitter.toString();
   return msg;
 }
 
-void DBCFile::parseCM_BO(const QString &line, const QString &content, const QString &raw_line, const QTextStream &stream) {
-  static QRegularExpression msg_comment_regexp(R"(^CM_ BO_ *(?<address>\w+) *\"(?<comment>(?:[^"\\]|\\.)*)\"\s*;)");
-
-  QString parse_line = line;
-  if (!parse_line.endsWith("\";")) {
-    int pos = stream.pos() - raw_line.length() - 1;
-    parse_line = content.mid(pos, content.indexOf("\";", pos));
-  }
-  auto match = msg_comment_regexp.match(parse_line);
-  if (!match.hasMatch())
+int DBCFile::parseCM_BO(const QString &content, int pos) {
+  // CM_ BO_ *<address> *"<comment>" *;
+  Tokenizer t(content, pos, content.size());
+  t.expect("CM_ BO_");
+  t.skip(' ');
+  auto address = t.word();
+  t.skip(' ');
+  auto comment = t.quoted();
+  t.skipSpaces();
+  t.expect(";");
+  if (!t.ok())
     throw std::runtime_error("Invalid message comment format");
 
-  if (auto m = (cabana::Msg *)msg(match.captured("address").toUInt()))
-    m->comment = match.captured("comment").trimmed().replace("\\\"", "\"");
+  if (auto m = (cabana::Msg *)msg(address.toUInt()))
+    m->comment = comment.trimmed().toString().replace("\\\"", "\"");
+  return t.position();
 }
 
-void DBCFile::parseSG(const QString &line, cabana::Msg *current_msg, int &multiplexor_cnt) {
-  static QRegularExpression sg_regexp(R"(^SG_ (\w+) : (\d+)\|(\d+)@(\d+)([\+|\-]) \(([0-9.+\-eE]+),([0-9.+\-eE]+)\) \[([0-9.+\-eE]+)\|([0-9.+\-eE]+)\] \"(.*)\" (.*))");
-  static QRegularExpression sgm_regexp(R"(^SG_ (\w+) (\w+) *: (\d+)\|(\d+)@(\d+)([\+|\-]) \(([0-9.+\-eE]+),([0-9.+\-eE]+)\) \[([0-9.+\-eE]+)\|([0-9.+\-eE]+)\] \"(.*)\" (.*))");
-
+void DBCFile::parseSG(const QStringRef &line, cabana::Msg *current_msg, int &multiplexor_cnt) {
   if (!current_msg)
     throw std::runtime_error("No Message");
 
-  int offset = 0;
-  auto match = sg_regexp.match(line);
-  if (!match.hasMatch()) {
-    match = sgm_regexp.match(line);
-    offset = 1;
+  // SG_ <name> [<multiplexer indicator> *]: <start bit>|<size>@<endianness><sign> (<factor>,<offset>) [<min>|<max>] "<unit>" <receiver>
+  Tokenizer t(line);
+  t.expect("SG_ ");
+  auto name = t.word();
+  QStringRef indicator;
+  if (!t.accept(" : ")) {
+    t.expect(" ");
+    indicator = t.word();
+    t.skip(' ');
+    t.expect(": ");
   }
-  if (!match.hasMatch())
+  auto start_bit = t.digits();
+  t.expect("|");
+  auto size = t.digits();
+  t.expect("@");
+  auto endianness = t.digits();
+  auto sign = t.oneOf("+|-");
+  t.expect(" (");
+  auto factor = t.number();
+  t.expect(",");
+  auto offset = t.number();
+  t.expect(") [");
+  auto min = t.number();
+  t.expect("|");
+  auto max = t.number();
+  t.expect("] \"");
+  // the unit runs to the last quote followed by a space
+  auto rest = t.rest();
+  const int unit_end = rest.lastIndexOf(QLatin1String("\" "));
+  if (!t.ok() || unit_end == -1)
     throw std::runtime_error("Invalid SG_ line format");
 
-  QString name = match.captured(1);
-  if (current_msg->sig(name) != nullptr)
+  if (current_msg->sig(name.toString()) != nullptr)
     throw std::runtime_error("Duplicate signal name");
 
   cabana::Signal s{};
-  if (offset == 1) {
-    auto indicator = match.captured(2);
-    if (indicator == "M") {
+  if (!indicator.isNull()) {
+    if (indicator == QLatin1String("M")) {
       ++multiplexor_cnt;
       // Only one signal within a single message can be the multiplexer switch.
       if (multiplexor_cnt >= 2)
@@ -198,46 +332,65 @@ void DBCFile::parseSG(const QString &line, cabana::Msg *current_msg, int &multip
       s.multiplex_value = indicator.mid(1).toInt();
     }
   }
-  s.name = name;
-  s.start_bit = match.captured(offset + 2).toInt();
-  s.size = match.captured(offset + 3).toInt();
-  s.is_little_endian = match.captured(offset + 4).toInt() == 1;
-  s.is_signed = match.captured(offset + 5) == "-";
-  s.factor = match.captured(offset + 6).toDouble();
-  s.offset = match.captured(offset + 7).toDouble();
-  s.min = match.captured(8 + offset).toDouble();
-  s.max = match.captured(9 + offset).toDouble();
-  s.unit = match.captured(10 + offset);
-  s.receiver_name = match.captured(11 + offset).trimmed();
+  s.name = name.toString();
+  s.start_bit = start_bit.toInt();
+  s.size = size.toInt();
+  s.is_little_endian = endianness.toInt() == 1;
+  s.is_signed = sign == QLatin1String("-");
+  s.factor = factor.toDouble();
+  s.offset = offset.toDouble();
+  s.min = min.toDouble();
+  s.max = max.toDouble();
+  s.unit = rest.left(unit_end).toString();
+  s.receiver_name = rest.mid(unit_end + 2).trimmed().toString();
   current_msg->sigs.push_back(new cabana::Signal(s));
 }
 
-void DBCFile::parseCM_SG(const QString &line, const QString &content, const QString &raw_line, const QTextStream &stream) {
-  static QRegularExpression sg_comment_regexp(R"(^CM_ SG_ *(\w+) *(\w+) *\"((?:[^"\\]|\\.)*)\"\s*;)");
-
-  QString parse_line = line;
-  if (!parse_line.endsWith("\";")) {
-    int pos = stream.pos() - raw_line.length() - 1;
-    parse_line = content.mid(pos, content.indexOf("\";", pos));
-  }
-  auto match = sg_comment_regexp.match(parse_line);
-  if (!match.hasMatch())
+int DBCFile::parseCM_SG(const QString &content, int pos) {
+  // CM_ SG_ *<address> *<signal name> *"<comment>" *;
+  Tokenizer t(content, pos, content.size());
+  t.expect("CM_ SG_");
+  t.skip(' ');
+  auto address = t.word();
+  t.skip(' ');
+  auto name = t.word();
+  t.skip(' ');
+  auto comment = t.quoted();
+  t.skipSpaces();
+  t.expect(";");
+  if (!t.ok())
     throw std::runtime_error("Invalid CM_ SG_ line format");
 
-  if (auto s = signal(match.captured(1).toUInt(), match.captured(2))) {
-    s->comment = match.captured(3).trimmed().replace("\\\"", "\"");
+  if (auto s = signal(address.toUInt(), name.toString())) {
+    s->comment = comment.trimmed().toString().replace("\\\"", "\"");
   }
+  return t.position();
 }
 
-void DBCFile::parseVAL(const QString &line) {
-  static QRegularExpression val_regexp(R"(VAL_ (\w+) (\w+) (\s*[-+]?[0-9]+\s+\".+?\"[^;]*))");
-
-  auto match = val_regexp.match(line);
-  if (!match.hasMatch())
+void DBCFile::parseVAL(const QStringRef &line) {
+  // VAL_ <address> <signal name> <value> "<description>" ... *;
+  Tokenizer t(line);
+  t.expect("VAL_ ");
+  auto address = t.word();
+  t.expect(" ");
+  auto name = t.word();
+  t.expect(" ");
+  // at least one value and description, up to the ;
+  const int first = t.position();
+  t.skipSpaces();
+  t.accept("-") || t.accept("+");
+  t.digits();
+  t.spaces();
+  // a description of at least one character
+  t.expect("\"");
+  t.find('"', 1);
+  t.expect("\"");
+  t.skipUntil(';');
+  if (!t.ok())
     throw std::runtime_error("invalid VAL_ line format");
 
-  if (auto s = signal(match.captured(1).toUInt(), match.captured(2))) {
-    QStringList desc_list = match.captured(3).trimmed().split('"');
+  if (auto s = signal(address.toUInt(), name.toString())) {
+    QStringList desc_list = line.mid(first - line.position(), t.position() - first).toString().trimmed().split('"');
     for (int i = 0; i < desc_list.size(); i += 2) {
       auto val = desc_list[i].trimmed();
       if (!val.isEmpty() && (i + 1) < desc_list.size()) {
@@ -1,7 +1,7 @@
 #pragma once
 
 #include <map>
-#include <QTextStream>
+#include <QString>
 
 #include "tools/cabana/dbc/dbc.h"
 
@@ -36,11 +36,12 @@ public:
 
 private:
   void parse(const QString &content);
-  cabana::Msg *parseBO(const QString &line);
-  void parseSG(const QString &line, cabana::Msg *current_msg, int &multiplexor_cnt);
-  void parseCM_BO(const QString &line, const QString &content, const QString &raw_line, const QTextStream &stream);
-  void parseCM_SG(const QString &line, const QString &content, const QString &raw_line, const QTextStream &stream);
-  void parseVAL(const QString &line);
+  cabana::Msg *parseBO(const QStringRef &line);
+  void parseSG(const QStringRef &line, cabana::Msg *current_msg, int &multiplexor_cnt);
+  // comments can span lines, both return the position after the statement
+  int parseCM_BO(const QString &content, int pos);
+  int parseCM_SG(const QString &content, int pos);
+  void parseVAL(const QStringRef &line);
 
   QString header;
   std::map<uint32_t, cabana::Msg> msgs;
@@ -1,5 +1,6 @@
 #include "tools/cabana/historylog.h"
 
+#include <cmath>
 #include <functional>
 
 #include <QFileDialog>
@@ -14,7 +15,10 @@ QVariant HistoryLogModel::data(const QModelIndex &index, int role) const {
   const int col = index.column();
   if (role == Qt::DisplayRole) {
     if (col == 0) return QString::number((m.mono_time / (double)1e9) - can->routeStartTime(), 'f', 3);
-    if (!isHexMode()) return sigs[col - 1]->formatValue(m.sig_values[col - 1], false);
+    if (!isHexMode()) {
+      const double value = m.sig_values[col - 1];
+      return std::isnan(value) ? "--" : sigs[col - 1]->formatValue(value, false);
+    }
   } else if (role == Qt::TextAlignmentRole) {
     return (uint32_t)(Qt::AlignRight | Qt::AlignVCenter);
   }
@@ -100,13 +104,20 @@ void HistoryLogModel::fetchData(std::deque<Message>::iterator insert_pos, uint64
     return ts > e->mono_time;
   });
 
+  // values come from the decoded columns shared with the charts
+  std::vector<const SignalValues *> columns;
+  if (!isHexMode() || filter_cmp) {
+    for (auto sig : sigs) columns.push_back(&can->signalValues(msg_id, sig));
+  }
+
   std::vector<HistoryLogModel::Message> msgs;
   std::vector<double> values(sigs.size());
   msgs.reserve(batch_size);
   for (; first != events.rend() && (*first)->mono_time > min_time; ++first) {
     const CanEvent *e = *first;
-    for (int i = 0; i < sigs.size(); ++i) {
-      sigs[i]->getValue(e->dat, e->size, &values[i]);
+    const size_t idx = std::distance(first, events.rend()) - 1;
+    for (int i = 0; i < columns.size(); ++i) {
+      values[i] = columns[i]->values[idx];
     }
     if (!filter_cmp || filter_cmp(values[filter_sig_idx], filter_value)) {
        msgs.emplace_back(Message{e->mono_time, values, {e->dat, e->dat + e->size}});
@@ -25,6 +25,11 @@ AbstractStream::AbstractStream(QObject *parent) : QObject(parent) {
   QObject::connect(this, &AbstractStream::seekedTo, this, &AbstractStream::updateLastMsgsTo);
   QObject::connect(dbc(), &DBCManager::DBCFileChanged, this, &AbstractStream::updateMasks);
   QObject::connect(dbc(), &DBCManager::maskUpdated, this, &AbstractStream::updateMasks);
+  QObject::connect(dbc(), &DBCManager::DBCFileChanged, this, [this]() { signal_cache_.clear(); });
+  QObject::connect(dbc(), &DBCManager::signalRemoved, this, [this](const cabana::Signal *sig) { signal_cache_.remove(sig); });
+  QObject::connect(dbc(), &DBCManager::msgRemoved, this, [this](MessageId id) {
+    for (auto s : sources) signal_cache_.remove(MessageId{.source = (uint8_t)s, .address = id.address});
+  });
   QObject::connect(this, &AbstractStream::streamStarted, [this]() {
     emit StreamNotifier::instance()->changingStream();
     delete can;
@@ -120,6 +125,10 @@ const std::vector<const CanEvent *> &AbstractStream::events(const MessageId &id)
   return it != events_.end() ? it->second : empty_events;
 }
 
+const SignalValues &AbstractStream::signalValues(const MessageId &id, const cabana::Signal *sig) {
+  return signal_cache_.get(id, sig, events(id), routeStartTime() * 1e9);
+}
+
 const CanData &AbstractStream::lastMessage(const MessageId &id) {
   static CanData empty_data = {};
   auto it = last_msgs.find(id);
@@ -174,6 +183,24 @@ const CanEvent *AbstractStream::newEvent(uint64_t mono_time, const cereal::CanDa
   return e;
 }
 
+// new_events and events are in time order. new_events go after the events at the same time,
+// returns false if they are not a block in events once merged.
+static bool insertEvents(std::vector<const CanEvent *> &events, const std::vector<const CanEvent *> &new_events) {
+  const size_t pos = std::upper_bound(events.cbegin(), events.cend(), new_events.front()->mono_time, CompareCanEvent()) - events.cbegin();
+  if (pos == events.size() || new_events.back()->mono_time < events[pos]->mono_time) {
+    // appended in amortized O(1) in live streams, segments of a route don't overlap either
+    events.insert(events.begin() + pos, new_events.cbegin(), new_events.cend());
+    return true;
+  }
+
+  // overlaps the events after pos, e.g. a bus with a clock behind the others
+  const size_t size = events.size();
+  events.insert(events.end(), new_events.cbegin(), new_events.cend());
+  std::inplace_merge(events.begin() + pos, events.begin() + size, events.end(),
+                     [](const CanEvent *l, const CanEvent *r) { return l->mono_time < r->mono_time; });
+  return false;
+}
+
 void AbstractStream::mergeEvents(const std::vector<const CanEvent *> &events) {
   static MessageEventsMap msg_events;
   std::for_each(msg_events.begin(), msg_events.end(), [](auto &e) { e.second.clear(); });
@@ -182,17 +209,22 @@ void AbstractStream::mergeEvents(const std::vector<const CanEvent *> &events) {
   for (auto e : events) {
     msg_events[{.source = e->src, .address = e->address}].push_back(e);
   }
+  // only pass on the messages with new events, the others keep their charts
+  for (auto it = msg_events.begin(); it != msg_events.end();) {
+    it = it->second.empty() ? msg_events.erase(it) : std::next(it);
+  }
 
   if (!events.empty()) {
     for (const auto &[id, new_e] : msg_events) {
-      if (!new_e.empty()) {
-        auto &e = events_[id];
-        auto pos = std::upper_bound(e.cbegin(), e.cend(), new_e.front()->mono_time, CompareCanEvent());
-        e.insert(pos, new_e.cbegin(), new_e.cend());
+      auto &e = events_[id];
+      if (insertEvents(e, new_e)) {
+        signal_cache_.merge(id, new_e, e);
+      } else {
+        // decoded again on the next get()
+        signal_cache_.remove(id);
       }
     }
-    auto pos = std::upper_bound(all_events_.cbegin(), all_events_.cend(), events.front()->mono_time, CompareCanEvent());
-    all_events_.insert(pos, events.cbegin(), events.cend());
+    insertEvents(all_events_, events);
     emit eventsMerged(msg_events);
   }
   lastest_event_ts = all_events_.empty() ? 0 : all_events_.back()->mono_time;
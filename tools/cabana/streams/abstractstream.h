@@ -11,7 +11,9 @@
 #include <QDateTime>
 
 #include "cereal/messaging/messaging.h"
+#include "tools/cabana/dbc/canevent.h"
 #include "tools/cabana/dbc/dbcmanager.h"
+#include "tools/cabana/streams/signalcache.h"
 #include "tools/cabana/utils/util.h"
 #include "tools/replay/util.h"
 
@@ -36,19 +38,6 @@ struct CanData {
   double last_freq_update_ts = 0;
 };
 
-struct CanEvent {
-  uint8_t src;
-  uint32_t address;
-  uint64_t mono_time;
-  uint8_t size;
-  uint8_t dat[];
-};
-
-struct CompareCanEvent {
-  constexpr bool operator()(const CanEvent *const e, uint64_t ts) const { return e->mono_time < ts; }
-  constexpr bool operator()(uint64_t ts, const CanEvent *const e) const { return ts < e->mono_time; }
-};
-
 struct BusConfig {
   int can_speed_kbps = 500;
   int data_speed_kbps = 2000;
@@ -83,6 +72,8 @@ public:
   inline const std::vector<const CanEvent *> &allEvents() const { return all_events_; }
   const CanData &lastMessage(const MessageId &id);
   const std::vector<const CanEvent *> &events(const MessageId &id) const;
+  // decoded values of sig, one per event of id
+  const SignalValues &signalValues(const MessageId &id, const cabana::Signal *sig);
 
   size_t suppressHighlighted();
   void clearSuppressed();
@@ -118,6 +109,7 @@ private:
   void updateMasks();
 
   MessageEventsMap events_;
+  SignalCache signal_cache_;
   std::unordered_map<MessageId, CanData> last_msgs;
   std::unique_ptr<MonotonicBuffer> event_buffer_;
 
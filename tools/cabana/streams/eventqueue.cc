@@ -0,0 +1,18 @@
+#include "tools/cabana/streams/eventqueue.h"
+
+bool EventQueue::flush() {
+  if (pending_.empty()) return true;
+  if (!chunks_.try_push(std::move(pending_))) return false;
+  pending_.clear();
+  free_chunks_.try_pop(pending_);
+  return true;
+}
+
+void EventQueue::pop(std::vector<const CanEvent *> &events) {
+  std::vector<const CanEvent *> chunk;
+  while (chunks_.try_pop(chunk)) {
+    events.insert(events.end(), chunk.cbegin(), chunk.cend());
+    chunk.clear();
+    free_chunks_.try_push(std::move(chunk));
+  }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+
+#include "common/queue.h"
+
+struct CanEvent;
+
+// Hands events from a stream thread to the ui thread without a lock. The stream thread
+// pushes events and publishes them in chunks, the ui thread takes all published chunks
+// at once. Chunks go back to the stream thread once they are read, so neither side
+// allocates once their capacity has grown.
+// There must be one thread pushing and one thread popping.
+class EventQueue {
+public:
+  // called in the stream thread
+  inline void push(const CanEvent *e) { pending_.push_back(e); }
+  // publishes the events pushed since the last flush, keeps them for the next flush if the queue is full
+  bool flush();
+
+  // called in the ui thread, appends the published events in the order they were pushed
+  void pop(std::vector<const CanEvent *> &events);
+
+private:
+  std::vector<const CanEvent *> pending_;
+  SpscQueue<std::vector<const CanEvent *>, 64> chunks_;
+  // read chunks, returned to the stream thread
+  SpscQueue<std::vector<const CanEvent *>, 64> free_chunks_;
+};
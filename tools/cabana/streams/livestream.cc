@@ -79,21 +79,20 @@ void LiveStream::handleEvent(kj::ArrayPtr<capnp::word> data) {
   auto event = reader.getRoot<cereal::Event>();
   if (event.which() == cereal::Event::Which::CAN) {
     const uint64_t mono_time = event.getLogMonoTime();
-    std::lock_guard lk(lock);
     for (const auto &c : event.getCan()) {
-      received_events_.push_back(newEvent(mono_time, c));
+      event_queue_.push(newEvent(mono_time, c));
     }
+    // kept for the next event if the ui thread is behind
+    event_queue_.flush();
   }
 }
 
 void LiveStream::timerEvent(QTimerEvent *event) {
   if (event->timerId() == timer_id) {
-    {
-      // merge events received from live stream thread.
-      std::lock_guard lk(lock);
-      mergeEvents(received_events_);
-      received_events_.clear();
-    }
+    // merge events received from live stream thread.
+    event_queue_.pop(received_events_);
+    mergeEvents(received_events_);
+    received_events_.clear();
     if (!all_events_.empty()) {
       begin_event_ts = all_events_.front()->mono_time;
       updateEvents();
@@ -6,6 +6,7 @@
 #include <QBasicTimer>
 
 #include "tools/cabana/streams/abstractstream.h"
+#include "tools/cabana/streams/eventqueue.h"
 
 class LiveStream : public AbstractStream {
   Q_OBJECT
@@ -32,8 +33,8 @@ private:
   void timerEvent(QTimerEvent *event) override;
   void updateEvents();
 
-  std::mutex lock;
   QThread *stream_thread;
+  EventQueue event_queue_;
   std::vector<const CanEvent *> received_events_;
 
   int timer_id;
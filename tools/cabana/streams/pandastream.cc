@@ -42,7 +42,8 @@ bool PandaStream::connect() {
 }
 
 void PandaStream::streamThread() {
-  std::vector<can_frame> raw_can_data;
+  std::vector<can_recv_frame> raw_can_data;
+  raw_can_data.reserve(RECV_MAX_FRAMES);
 
   while (!QThread::currentThread()->isInterruptionRequested()) {
     QThread::msleep(1);
@@ -66,8 +67,7 @@ void PandaStream::streamThread() {
     auto canData = evt.initCan(raw_can_data.size());
     for (uint i = 0; i<raw_can_data.size(); i++) {
       canData[i].setAddress(raw_can_data[i].address);
-      canData[i].setBusTime(raw_can_data[i].busTime);
-      canData[i].setDat(kj::arrayPtr((uint8_t*)raw_can_data[i].dat.data(), raw_can_data[i].dat.size()));
+      canData[i].setDat(kj::arrayPtr(raw_can_data[i].dat, raw_can_data[i].len));
       canData[i].setSrc(raw_can_data[i].src);
     }
 
@@ -0,0 +1,113 @@
+#include "tools/cabana/streams/signalcache.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "tools/cabana/streams/abstractstream.h"
+
+static inline double to_seconds(uint64_t mono_time, uint64_t start_time) {
+  return (mono_time - std::min(mono_time, start_time)) / 1e9;
+}
+
+// SignalValues
+
+int SignalValues::lowerBound(double sec) const {
+  return std::lower_bound(timestamps->cbegin(), timestamps->cend(), sec) - timestamps->cbegin();
+}
+
+int SignalValues::lastValueAt(double sec) const {
+  int i = std::upper_bound(timestamps->cbegin(), timestamps->cend(), sec) - timestamps->cbegin() - 1;
+  while (i >= 0 && std::isnan(values[i])) --i;
+  return i;
+}
+
+// SignalCache
+
+const SignalValues &SignalCache::get(const MessageId &id, const cabana::Signal *sig, const std::vector<const CanEvent *> &events,
+                                     uint64_t start_time) {
+  std::lock_guard lk(mutex_);
+  auto &m = messages_[id];
+  if (m.ts.size() != events.size() || m.start_time != start_time) {
+    m.start_time = start_time;
+    m.ts.resize(events.size());
+    std::transform(events.cbegin(), events.cend(), m.ts.begin(), [=](auto e) { return to_seconds(e->mono_time, start_time); });
+    m.columns.clear();
+  }
+
+  auto &c = m.columns[sig];
+  if (!valid(c, sig, m.ts.size())) {
+    c.sig = sig;
+    c.decoding = *sig;
+    c.multiplexed = sig->multiplexor != nullptr;
+    c.multiplexor = c.multiplexed ? Decoding(*sig->multiplexor) : Decoding();
+    c.multiplex_value = sig->multiplex_value;
+    c.values.values.clear();
+    decode(c, events, 0);
+  }
+  c.values.timestamps = &m.ts;
+  return c.values;
+}
+
+void SignalCache::merge(const MessageId &id, const std::vector<const CanEvent *> &new_events,
+                        const std::vector<const CanEvent *> &events) {
+  std::lock_guard lk(mutex_);
+  auto it = messages_.find(id);
+  if (it == messages_.end() || new_events.empty()) return;
+
+  auto &m = it->second;
+  if (m.ts.size() + new_events.size() != events.size()) {
+    // out of sync, decoded again on the next get()
+    messages_.erase(it);
+    return;
+  }
+  // the block goes where the stream inserted it, after the events at the same time
+  const double front_ts = to_seconds(new_events.front()->mono_time, m.start_time);
+  const size_t pos = std::upper_bound(m.ts.cbegin(), m.ts.cend(), front_ts) - m.ts.cbegin();
+  auto ts_it = m.ts.insert(m.ts.begin() + pos, new_events.size(), 0);
+  for (auto e : new_events) {
+    *ts_it++ = to_seconds(e->mono_time, m.start_time);
+  }
+  for (auto &[_, c] : m.columns) {
+    decode(c, new_events, pos);
+  }
+}
+
+void SignalCache::decode(Column &c, const std::vector<const CanEvent *> &events, size_t pos) {
+  auto value_it = c.values.values.insert(c.values.values.begin() + pos, events.size(), 0);
+  cabana::SignalDecoder(*c.sig).decode(events.data(), events.size(), &*value_it);
+}
+
+bool SignalCache::valid(const Column &c, const cabana::Signal *sig, size_t size) const {
+  return c.sig && c.values.size() == size && c.decoding == Decoding(*sig) &&
+         c.multiplexed == (sig->multiplexor != nullptr) &&
+         (!c.multiplexed || (c.multiplexor == Decoding(*sig->multiplexor) && c.multiplex_value == sig->multiplex_value));
+}
+
+void SignalCache::remove(const cabana::Signal *sig) {
+  std::lock_guard lk(mutex_);
+  for (auto &[_, m] : messages_) {
+    m.columns.erase(sig);
+  }
+}
+
+void SignalCache::remove(const MessageId &id) {
+  std::lock_guard lk(mutex_);
+  messages_.erase(id);
+}
+
+void SignalCache::clear() {
+  std::lock_guard lk(mutex_);
+  messages_.clear();
+}
+
+size_t SignalCache::memoryUsage() const {
+  std::lock_guard lk(mutex_);
+  size_t bytes = 0;
+  for (const auto &[_, m] : messages_) {
+    bytes += m.ts.capacity() * sizeof(double);
+    for (const auto &[_, c] : m.columns) {
+      bytes += c.values.values.capacity() * sizeof(double);
+    }
+  }
+  return bytes;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "tools/cabana/dbc/dbc.h"
+
+struct CanEvent;
+
+// Decoded values of a signal, one entry per event of its message.
+// values are NaN in the events a multiplexed signal is not present in.
+struct SignalValues {
+  std::vector<double> values;
+  // seconds since the route start, shared by the signals of the message
+  const std::vector<double> *timestamps = nullptr;
+
+  inline size_t size() const { return values.size(); }
+  inline double ts(int i) const { return (*timestamps)[i]; }
+  // the first entry at or after sec
+  int lowerBound(double sec) const;
+  // the last entry with a value at or before sec, -1 if there is none
+  int lastValueAt(double sec) const;
+};
+
+// Columns of decoded signal values shared by the charts, the history log and the exporter.
+// A column is decoded on first use, extended as events are merged, and decoded again only
+// when the definition of its signal changes. The charts look up columns from their worker threads.
+class SignalCache {
+public:
+  const SignalValues &get(const MessageId &id, const cabana::Signal *sig, const std::vector<const CanEvent *> &events,
+                          uint64_t start_time);
+  // new_events were inserted into events as one block, in time order
+  void merge(const MessageId &id, const std::vector<const CanEvent *> &new_events,
+             const std::vector<const CanEvent *> &events);
+  void remove(const cabana::Signal *sig);
+  void remove(const MessageId &id);
+  void clear();
+  size_t memoryUsage() const;
+
+private:
+  // the fields decoding depends on
+  struct Decoding {
+    Decoding() = default;
+    Decoding(const cabana::Signal &s) : msb(s.msb), lsb(s.lsb), size(s.size), is_signed(s.is_signed),
+        is_little_endian(s.is_little_endian), factor(s.factor), offset(s.offset) {}
+    inline bool operator==(const Decoding &o) const {
+      return std::tie(msb, lsb, size, is_signed, is_little_endian, factor, offset) ==
+             std::tie(o.msb, o.lsb, o.size, o.is_signed, o.is_little_endian, o.factor, o.offset);
+    }
+    int msb = 0, lsb = 0, size = 0;
+    bool is_signed = false, is_little_endian = false;
+    double factor = 1.0, offset = 0;
+  };
+
+  struct Column {
+    SignalValues values;
+    const cabana::Signal *sig = nullptr;
+    Decoding decoding, multiplexor;
+    bool multiplexed = false;
+    int multiplex_value = 0;
+  };
+
+  struct MessageColumns {
+    std::vector<double> ts;
+    uint64_t start_time = 0;
+    std::map<const cabana::Signal *, Column> columns;
+  };
+
+  bool valid(const Column &c, const cabana::Signal *sig, size_t size) const;
+  void decode(Column &c, const std::vector<const CanEvent *> &events, size_t pos);
+
+  mutable std::mutex mutex_;
+  std::unordered_map<MessageId, MessageColumns> messages_;
+};
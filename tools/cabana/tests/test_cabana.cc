@@ -1,9 +1,23 @@
 
 #undef INFO
 #include <QDir>
+#include <QFile>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <thread>
 
 #include "catch2/catch.hpp"
+#include "common/timing.h"
+#include "common/util.h"
+#include "tools/cabana/chart/lod.h"
 #include "tools/cabana/dbc/dbcmanager.h"
+#include "tools/cabana/streams/abstractstream.h"
+#include "tools/cabana/streams/eventqueue.h"
+#include "tools/cabana/tools/bitplanes.h"
+#include "tools/replay/logreader.h"
 
 const std::string TEST_RLOG_URL = "https://commadataci.blob.core.windows.net/openpilotci/0c94aa1e1296d7c6/2021-05-05--19-48-37/0/rlog.bz2";
 
@@ -142,6 +156,117 @@ CM_ SG_ 162 signal_1 "signal comment with \"escaped quotes\"";
   REQUIRE(msg->sigs[0]->comment == "signal comment with \"escaped quotes\"");
 }
 
+TEST_CASE("parse_dbc - line breaks") {
+  QString content = R"(BO_ 160 message_1: 8 EON
+ SG_ signal_1 : 0|12@1+ (1,0) [0|4095] "unit" XXX
+
+CM_ SG_ 160 signal_1 "multiple line comment
+BO_ 161 message_2: 8 EON
+";
+CM_ BO_ 160 "message comment";
+)";
+  DBCFile file("", content);
+  DBCFile crlf_file("", QString(content).replace("\n", "\r\n"));
+  for (auto f : {&file, &crlf_file}) {
+    REQUIRE(f->getMessages().size() == 1);
+    REQUIRE(f->msg(160)->comment == "message comment");
+    REQUIRE(QString(f->msg(160)->sigs[0]->comment).remove('\r') == "multiple line comment\nBO_ 161 message_2: 8 EON");
+  }
+}
+
+TEST_CASE("parse_dbc - non-ascii names") {
+  // names are matched like \w was, which only matched ASCII letters and digits
+  REQUIRE_THROWS_WITH(DBCFile("", "BO_ 160 Nachricht_ä: 8 EON\n"), Catch::Contains("Invalid BO_ line format"));
+  QString content = R"(BO_ 160 message: 8 EON
+ SG_ Größe : 0|12@1+ (1,0) [0|4095] "unit" XXX
+)";
+  REQUIRE_THROWS_WITH(DBCFile("", content), Catch::Contains("Invalid SG_ line format"));
+}
+
+TEST_CASE("DBCFile::parse - round trip") {
+  auto pick = [](const QStringList &l) { return l[util::random_int(0, l.size() - 1)]; };
+  auto escape = [](QString s) { return s.replace("\"", "\\\""); };
+
+  for (int n = 0; n < 100; ++n) {
+    // random messages, written with the spacing and the line breaks the parser allows
+    DBCFile origin("", "");
+    QString content, comments, val_descs;
+    for (int i = 0, msg_count = util::random_int(1, 20); i < msg_count; ++i) {
+      const uint32_t address = i * 100 + util::random_int(0, 99);
+      const QString msg_comment = pick({"", "comment", "comment with \"quotes\"", "multiple\nline comment"});
+      origin.updateMsg({.address = address}, QString("message_%1").arg(i), util::random_int(1, 64), pick({"XXX", "EON"}), msg_comment);
+      content += QString("BO_ %1 message_%2%3: %4 %5\n").arg(address).arg(i).arg(pick({"", " "})).arg(origin.msg(address)->size).arg(origin.msg(address)->transmitter);
+      if (!msg_comment.isEmpty()) {
+        comments += QString("CM_ BO_ %1 \"%2\"%3;\n").arg(address).arg(escape(msg_comment)).arg(pick({"", " "}));
+      }
+
+      for (int j = 0, sig_count = util::random_int(0, 10); j < sig_count; ++j) {
+        cabana::Signal sig = {};
+        sig.name = QString("signal_%1").arg(j);
+        sig.type = j == 0 && util::random_int(0, 1) ? cabana::Signal::Type::Multiplexor
+                                                    : (cabana::Signal::Type)util::random_int(0, 1);
+        sig.multiplex_value = sig.type == cabana::Signal::Type::Multiplexed ? util::random_int(0, 15) : 0;
+        sig.start_bit = util::random_int(0, 63);
+        sig.size = util::random_int(1, 32);
+        sig.is_little_endian = util::random_int(0, 1);
+        sig.is_signed = util::random_int(0, 1);
+        sig.factor = pick({"1", "0.5", "-0.01", "1e-05", "100"}).toDouble();
+        sig.offset = pick({"0", "-40", "0.25"}).toDouble();
+        sig.min = pick({"0", "-1.5", "-327.68"}).toDouble();
+        sig.max = pick({"1", "4095", "1e+06"}).toDouble();
+        sig.unit = pick({"", "km/h", "deg C"});
+        sig.receiver_name = pick({"XXX", "EON,NEO"});
+        sig.comment = pick({"", "comment", "comment with \"quotes\"", "multiple\nline comment"});
+        if (util::random_int(0, 1)) {
+          sig.val_desc = {{0, "off"}, {1, "on"}, {-2, "two words"}};
+        }
+        origin.msg(address)->addSignal(sig);
+
+        QString indicator = sig.type == cabana::Signal::Type::Multiplexor ? "M" : QString("m%1").arg(sig.multiplex_value);
+        content += QString("%1SG_ %2 %3: %4|%5@%6%7 (%8,%9) [%10|%11] \"%12\" %13%14\n")
+                       .arg(pick({" ", "  ", "\t"}))
+                       .arg(sig.name)
+                       .arg(sig.type == cabana::Signal::Type::Normal ? "" : indicator + pick({" ", ""}))
+                       .arg(sig.start_bit)
+                       .arg(sig.size)
+                       .arg(sig.is_little_endian ? '1' : '0')
+                       .arg(sig.is_signed ? '-' : '+')
+                       .arg(doubleToString(sig.factor))
+                       .arg(doubleToString(sig.offset))
+                       .arg(doubleToString(sig.min))
+                       .arg(doubleToString(sig.max))
+                       .arg(sig.unit)
+                       .arg(sig.receiver_name)
+                       .arg(pick({"", " "}));
+        if (!sig.comment.isEmpty()) {
+          comments += QString("CM_ SG_ %1 %2 \"%3\"%4;\n").arg(address).arg(sig.name).arg(escape(sig.comment)).arg(pick({"", " "}));
+        }
+        if (!sig.val_desc.empty()) {
+          val_descs += QString("VAL_ %1 %2 0 \"off\"  1 \"on\" -2 \"two words\"%3;\n").arg(address).arg(sig.name).arg(pick({"", " "}));
+        }
+      }
+      content += "\n";
+    }
+
+    DBCFile parsed("", content + comments + val_descs);
+    REQUIRE(parsed.getMessages().size() == origin.getMessages().size());
+    for (auto &[address, m] : origin.getMessages()) {
+      auto parsed_m = parsed.msg(address);
+      REQUIRE(parsed_m != nullptr);
+      REQUIRE(parsed_m->name == m.name);
+      REQUIRE(parsed_m->size == m.size);
+      REQUIRE(parsed_m->transmitter == m.transmitter);
+      REQUIRE(parsed_m->comment == m.comment);
+      REQUIRE(parsed_m->sigs.size() == m.sigs.size());
+      for (int i = 0; i < m.sigs.size(); ++i) {
+        REQUIRE(*parsed_m->sigs[i] == *m.sigs[i]);
+      }
+    }
+    REQUIRE(parsed.generateDBC() == origin.generateDBC());
+    REQUIRE(DBCFile("", parsed.generateDBC()).generateDBC() == parsed.generateDBC());
+  }
+}
+
 TEST_CASE("parse_opendbc") {
   QDir dir(OPENDBC_FILE_PATH);
   QStringList errors;
@@ -155,3 +280,520 @@ TEST_CASE("parse_opendbc") {
   INFO(errors.join("\n").toStdString());
   REQUIRE(errors.empty());
 }
+
+TEST_CASE("DBCFile::parse benchmark", "[.][benchmark]") {
+  QDir dir(OPENDBC_FILE_PATH);
+  std::vector<QString> contents;
+  size_t bytes = 0;
+  for (auto fn : dir.entryList({"*.dbc"}, QDir::Files, QDir::Name)) {
+    QFile file(dir.filePath(fn));
+    REQUIRE(file.open(QIODevice::ReadOnly));
+    contents.push_back(file.readAll());
+    bytes += contents.back().size();
+  }
+
+  const int rounds = 10;
+  double start = millis_since_boot();
+  for (int i = 0; i < rounds; ++i) {
+    for (const auto &content : contents) {
+      DBCFile dbc("", content);
+    }
+  }
+  const double ms = (millis_since_boot() - start) / rounds;
+  printf("%zu DBC files, %.2f MB: %.2f ms, %.2f MB/s\n", contents.size(), bytes / 1e6, ms, bytes / 1e3 / ms);
+}
+
+// events of message 162 at 100Hz, the first byte cycles through the multiplexor values 0-7
+std::vector<const CanEvent *> build_can_events(MonotonicBuffer &buffer, uint64_t begin_time, int count) {
+  std::vector<const CanEvent *> events;
+  events.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    CanEvent *e = (CanEvent *)buffer.allocate(sizeof(CanEvent) + 8);
+    e->src = 0;
+    e->address = 162;
+    e->mono_time = begin_time + i * 10000000ULL;
+    e->size = 8;
+    e->dat[0] = i % 8;
+    for (int j = 1; j < 8; ++j) e->dat[j] = util::random_int(0, 255);
+    events.push_back(e);
+  }
+  return events;
+}
+
+const QString SIGNAL_CACHE_DBC = R"(
+BO_ 162 message_1: 8 XXX
+  SG_ mux M : 0|8@1+ (1,0) [0|7] "" XXX
+  SG_ sig_m4 m4 : 8|12@1+ (1,0) [0|4095] "" XXX
+  SG_ sig_1 : 20|16@1- (0.5,-10) [0|0] "" XXX
+  SG_ sig_2 : 39|8@0+ (1,0) [0|255] "" XXX
+)";
+
+TEST_CASE("SignalCache") {
+  DBCFile file("", SIGNAL_CACHE_DBC);
+  auto msg = file.msg(162);
+  REQUIRE(msg->sigs.size() == 4);
+  const MessageId id = {.source = 0, .address = 162};
+  const uint64_t start_time = 1000000000ULL;
+
+  MonotonicBuffer buffer(1024 * 1024);
+  auto events = build_can_events(buffer, start_time, 1000);
+  auto verify = [&](SignalCache &cache, const std::vector<const CanEvent *> &events) {
+    for (auto sig : msg->sigs) {
+      const auto &vals = cache.get(id, sig, events, start_time);
+      REQUIRE(vals.size() == events.size());
+      for (int i = 0; i < events.size(); ++i) {
+        double value = 0;
+        REQUIRE(vals.ts(i) == (events[i]->mono_time - start_time) / 1e9);
+        if (sig->getValue(events[i]->dat, events[i]->size, &value)) {
+          REQUIRE(vals.values[i] == value);
+        } else {
+          REQUIRE(std::isnan(vals.values[i]));
+        }
+      }
+    }
+  };
+
+  SignalCache cache;
+  verify(cache, events);
+
+  SECTION("lookup") {
+    const auto &vals = cache.get(id, msg->sigs[1], events, start_time);
+    REQUIRE(vals.lowerBound(0.5) == 50);
+    REQUIRE(vals.lowerBound(0.505) == 51);
+    // sig_m4 is only present in every 8th event
+    REQUIRE(vals.lastValueAt(0.5) == 44);
+    REQUIRE(vals.lastValueAt(0.03) == -1);
+  }
+  SECTION("merge") {
+    // a block at the end, then one in the middle with events at the same time as existing ones
+    auto tail = build_can_events(buffer, start_time + 1000 * 10000000ULL, 100);
+    auto middle = build_can_events(buffer, start_time + 500 * 10000000ULL, 10);
+    for (auto &block : {tail, middle}) {
+      auto pos = std::upper_bound(events.cbegin(), events.cend(), block.front()->mono_time, CompareCanEvent());
+      events.insert(pos, block.cbegin(), block.cend());
+      cache.merge(id, block, events);
+      verify(cache, events);
+    }
+  }
+  SECTION("signal definition changed") {
+    const auto &vals = cache.get(id, msg->sigs[2], events, start_time);
+    const double value = vals.values[10];
+    msg->sigs[2]->factor = 2;
+    REQUIRE(cache.get(id, msg->sigs[2], events, start_time).values[10] == (value + 10) / 0.5 * 2 - 10);
+    verify(cache, events);
+  }
+}
+
+TEST_CASE("SignalCache benchmark", "[.][benchmark]") {
+  DBCFile file("", SIGNAL_CACHE_DBC);
+  auto msg = file.msg(162);
+  const MessageId id = {.source = 0, .address = 162};
+  MonotonicBuffer buffer(64 * 1024 * 1024);
+  // one hour at 100Hz
+  auto events = build_can_events(buffer, 0, 3600 * 100);
+
+  // what charts used to keep per signal: the points, the step points and the series copy
+  double start = millis_since_boot();
+  size_t points_bytes = 0;
+  for (auto sig : msg->sigs) {
+    std::vector<QPointF> vals, step_vals;
+    double value = 0;
+    for (auto e : events) {
+      if (sig->getValue(e->dat, e->size, &value)) {
+        vals.emplace_back(e->mono_time / 1e9, value);
+        if (!step_vals.empty()) step_vals.emplace_back(e->mono_time / 1e9, step_vals.back().y());
+        step_vals.emplace_back(e->mono_time / 1e9, value);
+      }
+    }
+    auto series = QVector<QPointF>::fromStdVector(vals);
+    points_bytes += (vals.capacity() + step_vals.capacity() + series.capacity()) * sizeof(QPointF);
+  }
+  printf("points:  %zu signals, %.2f ms, %.2f MB\n", msg->sigs.size(), millis_since_boot() - start, points_bytes / 1e6);
+
+  SignalCache cache;
+  for (bool cached : {false, true}) {
+    start = millis_since_boot();
+    size_t series_bytes = 0;
+    for (auto sig : msg->sigs) {
+      const auto &vals = cache.get(id, sig, events, 0);
+      QVector<QPointF> series;
+      series.reserve(vals.size());
+      for (int i = 0; i < vals.size(); ++i) {
+        if (!std::isnan(vals.values[i])) series.push_back({vals.ts(i), vals.values[i]});
+      }
+      series_bytes += series.capacity() * sizeof(QPointF);
+    }
+    printf("columns: %zu signals, %s %.2f ms, %.2f MB + %.2f MB series\n", msg->sigs.size(), cached ? "cached" : "decoded",
+           millis_since_boot() - start, cache.memoryUsage() / 1e6, series_bytes / 1e6);
+  }
+}
+
+TEST_CASE("LodPyramid") {
+  DBCFile file("", SIGNAL_CACHE_DBC);
+  auto msg = file.msg(162);
+  const MessageId id = {.source = 0, .address = 162};
+  MonotonicBuffer buffer(1024 * 1024);
+  SignalCache cache;
+
+  for (int count : {1, 7, 8, 9, 1000, 10000}) {
+    auto events = build_can_events(buffer, 0, count);
+    for (auto sig : {msg->sigs[1], msg->sigs[2]}) {
+      const auto &vals = cache.get(id, sig, events, 0);
+      LodPyramid lod(vals);
+      REQUIRE(lod.size() == vals.size());
+
+      for (int i = 0; i < 100; ++i) {
+        int first = util::random_int(0, count), last = util::random_int(0, count);
+        if (first > last) std::swap(first, last);
+        double min = std::numeric_limits<double>::max(), max = std::numeric_limits<double>::lowest();
+        for (int j = first; j < last; ++j) {
+          if (vals.values[j] < min) min = vals.values[j];
+          if (vals.values[j] > max) max = vals.values[j];
+        }
+        REQUIRE(lod.minmax(vals, first, last) == std::pair{min, max});
+      }
+
+      for (int columns : {1, 10, 100, 1000}) {
+        const double min_x = util::random_int(0, count) / 100.0, max_x = min_x + util::random_int(1, count) / 100.0;
+        auto points = lod.envelope(min_x, max_x, columns);
+        REQUIRE(points.size() <= (columns + 2) * 2);
+        // points of the signal in time order, with its min and max in the range
+        double min = std::numeric_limits<double>::max(), max = std::numeric_limits<double>::lowest();
+        for (int j = 0; j < points.size(); ++j) {
+          const int idx = vals.lowerBound(points[j].x());
+          REQUIRE(idx < vals.size());
+          REQUIRE(vals.values[idx] == points[j].y());
+          REQUIRE((j == 0 || points[j].x() > points[j - 1].x()));
+          min = std::min(min, points[j].y());
+          max = std::max(max, points[j].y());
+        }
+        for (int j = vals.lowerBound(min_x); j < vals.size() && vals.ts(j) <= max_x; ++j) {
+          if (!std::isnan(vals.values[j])) {
+            REQUIRE((vals.values[j] >= min && vals.values[j] <= max));
+          }
+        }
+      }
+
+      // extended as events are appended, the same as built at once
+      SignalValues part = {.timestamps = vals.timestamps};
+      LodPyramid extended(part);
+      for (int size = 0; size < count;) {
+        size = std::min(size + util::random_int(1, 300), count);
+        part.values.assign(vals.values.begin(), vals.values.begin() + size);
+        extended.append(part);
+        REQUIRE(extended.size() == size);
+      }
+      for (int i = 0; i < 100; ++i) {
+        int first = util::random_int(0, count), last = util::random_int(0, count);
+        if (first > last) std::swap(first, last);
+        REQUIRE(extended.minmax(vals, first, last) == lod.minmax(vals, first, last));
+      }
+      for (int columns : {1, 10, 100, 1000}) {
+        REQUIRE(extended.envelope(0, count / 100.0, columns) == lod.envelope(0, count / 100.0, columns));
+      }
+    }
+  }
+}
+
+TEST_CASE("SignalDecoder") {
+  MonotonicBuffer buffer(1024 * 1024);
+  std::vector<const CanEvent *> events;
+  for (int size : {1, 3, 7, 8, 12, 32, 64}) {
+    for (int i = 0; i < 20; ++i) {
+      CanEvent *e = (CanEvent *)buffer.allocate(sizeof(CanEvent) + size);
+      e->size = size;
+      for (int j = 0; j < size; ++j) e->dat[j] = util::random_int(0, 255);
+      events.push_back(e);
+    }
+  }
+
+  // every position and size in both byte orders, including signals past the end of short messages
+  std::vector<double> values(events.size());
+  for (bool is_little_endian : {true, false}) {
+    for (bool is_signed : {false, true}) {
+      for (int size = 1; size <= 64; ++size) {
+        for (int start_bit = 0; start_bit < 64 * 8; ++start_bit) {
+          cabana::Signal sig;
+          sig.start_bit = start_bit;
+          sig.size = size;
+          sig.factor = 0.5;
+          sig.offset = -3;
+          sig.is_signed = is_signed;
+          sig.is_little_endian = is_little_endian;
+          updateMsbLsb(sig);
+          if (sig.lsb < 0 || (is_signed && size == 64)) continue;
+
+          cabana::SignalDecoder decoder(sig);
+          decoder.decode(events.data(), events.size(), values.data());
+          int mismatches = 0;
+          for (int i = 0; i < events.size(); ++i) {
+            const double expected = get_raw_value(events[i]->dat, events[i]->size, sig);
+            mismatches += decoder.value(events[i]->dat, events[i]->size) != expected || values[i] != expected;
+          }
+          REQUIRE(mismatches == 0);
+        }
+      }
+    }
+  }
+
+  SECTION("multiplexed") {
+    DBCFile file("", SIGNAL_CACHE_DBC);
+    auto msg = file.msg(162);
+    auto can_events = build_can_events(buffer, 0, 100);
+    values.resize(can_events.size());
+    for (auto sig : msg->sigs) {
+      cabana::SignalDecoder(*sig).decode(can_events.data(), can_events.size(), values.data());
+      for (int i = 0; i < can_events.size(); ++i) {
+        double value = 0;
+        if (sig->getValue(can_events[i]->dat, can_events[i]->size, &value)) {
+          REQUIRE(values[i] == value);
+        } else {
+          REQUIRE(std::isnan(values[i]));
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("SignalDecoder benchmark", "[.][benchmark]") {
+  LogReader log;
+  REQUIRE(log.load(TEST_RLOG_URL));
+  MonotonicBuffer buffer(64 * 1024 * 1024);
+  std::unordered_map<MessageId, std::vector<const CanEvent *>> messages;
+  size_t total = 0;
+  for (const Event &e : log.events) {
+    if (e.which == cereal::Event::Which::CAN) {
+      capnp::FlatArrayMessageReader reader(e.data);
+      for (const auto &c : reader.getRoot<cereal::Event>().getCan()) {
+        auto dat = c.getDat();
+        CanEvent *ev = (CanEvent *)buffer.allocate(sizeof(CanEvent) + dat.size());
+        ev->src = c.getSrc();
+        ev->address = c.getAddress();
+        ev->mono_time = e.mono_time;
+        ev->size = dat.size();
+        memcpy(ev->dat, dat.begin(), dat.size());
+        messages[{.source = ev->src, .address = ev->address}].push_back(ev);
+        ++total;
+      }
+    }
+  }
+
+  // the signals FindSignal searches: every 8 and 16 bit signal of every message
+  std::vector<std::pair<MessageId, cabana::Signal>> sigs;
+  for (const auto &[id, events] : messages) {
+    for (int size : {8, 16}) {
+      for (int start_bit = 0; start_bit + size <= events.back()->size * 8; ++start_bit) {
+        cabana::Signal sig;
+        sig.start_bit = start_bit;
+        sig.size = size;
+        sig.is_signed = true;
+        sig.is_little_endian = start_bit % 2 == 0;
+        updateMsbLsb(sig);
+        sigs.push_back({id, sig});
+      }
+    }
+  }
+
+  std::vector<double> values;
+  values.reserve(total);
+  double sum[2] = {};
+  double start = millis_since_boot();
+  for (const auto &[id, sig] : sigs) {
+    const auto &events = messages[id];
+    values.resize(events.size());
+    for (int i = 0; i < events.size(); ++i) values[i] = get_raw_value(events[i]->dat, events[i]->size, sig);
+    sum[0] += values.back();
+  }
+  const double get_raw_value_ms = millis_since_boot() - start;
+
+  start = millis_since_boot();
+  for (const auto &[id, sig] : sigs) {
+    const auto &events = messages[id];
+    values.resize(events.size());
+    cabana::SignalDecoder(sig).decode(events.data(), events.size(), values.data());
+    sum[1] += values.back();
+  }
+  const double decoder_ms = millis_since_boot() - start;
+  REQUIRE(sum[0] == sum[1]);
+  printf("%zu can events, %zu messages, %zu signals\n", total, messages.size(), sigs.size());
+  printf("get_raw_value: %.2f ms\nSignalDecoder: %.2f ms (%.1fx)\n", get_raw_value_ms, decoder_ms, get_raw_value_ms / decoder_ms);
+}
+
+// events of a message whose bytes change now and then, like most signals do
+std::vector<const CanEvent *> build_slow_can_events(MonotonicBuffer &buffer, int count) {
+  std::vector<const CanEvent *> events;
+  events.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    CanEvent *e = (CanEvent *)buffer.allocate(sizeof(CanEvent) + 8);
+    e->mono_time = i * 10000000ULL;
+    e->size = 8;
+    for (int j = 0; j < 8; ++j) {
+      e->dat[j] = i == 0 || util::random_int(0, 50) == 0 ? util::random_int(0, 255) : events.back()->dat[j];
+    }
+    events.push_back(e);
+  }
+  return events;
+}
+
+TEST_CASE("BitPlanes") {
+  MonotonicBuffer buffer(1024 * 1024);
+  auto events = build_slow_can_events(buffer, 1000);
+  BitPlanes planes(events);
+  REQUIRE(planes.size() == events.size());
+  REQUIRE(planes.bits() == 64);
+  REQUIRE(planes.upperBound(events[10]->mono_time) == 11);
+  for (int i = 0; i < events.size(); ++i) {
+    for (int bit = 0; bit < 64; ++bit) {
+      REQUIRE(((planes.plane(bit)[i / 64] >> (i % 64)) & 1) == ((events[i]->dat[bit / 8] >> (bit % 8)) & 1));
+    }
+  }
+
+  // the changes of every signal in the message
+  for (bool is_little_endian : {true, false}) {
+    for (int size = 1; size <= 16; ++size) {
+      for (int start_bit = 0; start_bit < 64; ++start_bit) {
+        cabana::Signal sig;
+        sig.start_bit = start_bit;
+        sig.size = size;
+        sig.is_signed = false;
+        sig.is_little_endian = is_little_endian;
+        updateMsbLsb(sig);
+        if (std::max(sig.lsb, sig.msb) >= 64) continue;
+
+        std::vector<size_t> changes, expected;
+        for (size_t i = planes.nextChange(sig, 0); i < events.size(); i = planes.nextChange(sig, i + 1)) {
+          changes.push_back(i);
+        }
+        for (size_t i = 1; i < events.size(); ++i) {
+          if (get_raw_value(events[i]->dat, 8, sig) != get_raw_value(events[i - 1]->dat, 8, sig)) {
+            expected.push_back(i);
+          }
+        }
+        REQUIRE(changes == expected);
+      }
+    }
+  }
+}
+
+TEST_CASE("EventQueue") {
+  MonotonicBuffer buffer(64 * 1024 * 1024);
+  auto events = build_can_events(buffer, 0, 1000000);
+
+  EventQueue queue;
+  std::thread stream_thread([&]() {
+    for (int i = 0; i < events.size(); ++i) {
+      queue.push(events[i]);
+      if (i % 3 == 0) queue.flush();
+    }
+    while (!queue.flush()) {}
+  });
+
+  std::vector<const CanEvent *> received;
+  while (received.size() < events.size()) {
+    queue.pop(received);
+  }
+  stream_thread.join();
+  REQUIRE(received == events);
+}
+
+// a stream fed by the test instead of a stream thread
+class TestStream : public AbstractStream {
+public:
+  TestStream(QObject *parent) : AbstractStream(parent) {}
+  QString routeName() const override { return "test"; }
+  void start() override {}
+  using AbstractStream::mergeEvents;
+};
+
+TEST_CASE("AbstractStream::mergeEvents") {
+  DBCFile file("", SIGNAL_CACHE_DBC);
+  auto sig = file.msg(162)->sig("sig_1");
+  const MessageId id = {.source = 0, .address = 162};
+  QObject parent;
+  TestStream stream(&parent);
+  std::vector<MessageId> merged_ids;
+  QObject::connect(&stream, &AbstractStream::eventsMerged, [&](const MessageEventsMap &events_map) {
+    merged_ids.clear();
+    for (const auto &[id, _] : events_map) merged_ids.push_back(id);
+  });
+
+  MonotonicBuffer buffer(1024 * 1024);
+  auto events = build_can_events(buffer, 0, 1000);
+  auto other = build_can_events(buffer, 0, 10);
+  for (auto e : other) ((CanEvent *)e)->address = 163;
+
+  auto check = [&](const std::vector<const CanEvent *> &expected) {
+    REQUIRE(stream.events(id) == expected);
+    const auto &vals = stream.signalValues(id, sig);
+    REQUIRE(vals.size() == expected.size());
+    for (int i = 0; i < expected.size(); ++i) {
+      REQUIRE(vals.values[i] == get_raw_value(expected[i]->dat, expected[i]->size, *sig));
+    }
+  };
+
+  // appended
+  stream.mergeEvents(other);
+  stream.mergeEvents({events.begin() + 500, events.begin() + 600});
+  REQUIRE(merged_ids == std::vector<MessageId>{id});
+  check({events.begin() + 500, events.begin() + 600});
+  stream.mergeEvents({events.begin() + 600, events.begin() + 700});
+  check({events.begin() + 500, events.begin() + 700});
+
+  // a block before the merged events, as the segments of a route
+  stream.mergeEvents({events.begin(), events.begin() + 100});
+  std::vector<const CanEvent *> expected(events.begin(), events.begin() + 100);
+  expected.insert(expected.end(), events.begin() + 500, events.begin() + 700);
+  check(expected);
+
+  // overlapping the merged events
+  std::vector<const CanEvent *> late;
+  for (int i = 101; i < 1000; i += 2) late.push_back(events[i]);
+  stream.mergeEvents(late);
+  expected.insert(expected.end(), late.begin(), late.end());
+  std::stable_sort(expected.begin(), expected.end(), [](auto l, auto r) { return l->mono_time < r->mono_time; });
+  check(expected);
+  REQUIRE(std::is_sorted(stream.allEvents().begin(), stream.allEvents().end(), [](auto l, auto r) { return l->mono_time < r->mono_time; }));
+  REQUIRE(stream.allEvents().size() == expected.size() + other.size());
+}
+
+TEST_CASE("AbstractStream::mergeEvents benchmark", "[.][benchmark]") {
+  DBCFile file("", SIGNAL_CACHE_DBC);
+  auto msg = file.msg(162);
+  QObject parent;
+  TestStream stream(&parent);
+
+  // 10k messages per second on 3 buses, merged 20 times per second for 10 minutes
+  const int fps = 20, msgs_per_update = 10000 / fps, updates = fps * 600;
+  MonotonicBuffer buffer(256 * 1024 * 1024);
+  EventQueue queue;
+  std::vector<const CanEvent *> received;
+  std::vector<double> update_ms;
+  update_ms.reserve(updates);
+  for (int n = 0; n < updates; ++n) {
+    const uint64_t update_time = n * (1000000000ULL / fps);
+    for (int i = 0; i < msgs_per_update; ++i) {
+      CanEvent *e = (CanEvent *)buffer.allocate(sizeof(CanEvent) + 8);
+      e->src = i % 3;
+      e->address = 160 + i % 100 / 3;
+      e->mono_time = update_time + i * (1000000000ULL / fps / msgs_per_update);
+      e->size = 8;
+      for (int j = 0; j < 8; ++j) e->dat[j] = util::random_int(0, 255);
+      queue.push(e);
+    }
+    queue.flush();
+
+    const double start = millis_since_boot();
+    queue.pop(received);
+    stream.mergeEvents(received);
+    received.clear();
+    // a chart of each signal of a message
+    for (auto sig : msg->sigs) stream.signalValues({.source = 0, .address = 162}, sig);
+    update_ms.push_back(millis_since_boot() - start);
+  }
+
+  std::sort(update_ms.begin(), update_ms.end());
+  const double total = std::accumulate(update_ms.begin(), update_ms.end(), 0.0);
+  printf("%d updates of %d events: %.3f ms mean, %.3f ms p99, %.3f ms max\n", updates, msgs_per_update,
+         total / updates, update_ms[updates * 99 / 100], update_ms.back());
+  REQUIRE(stream.allEvents().size() == updates * msgs_per_update);
+}
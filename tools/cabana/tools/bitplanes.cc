@@ -0,0 +1,59 @@
+#include "tools/cabana/tools/bitplanes.h"
+
+#include <algorithm>
+
+#include "tools/cabana/streams/abstractstream.h"
+
+BitPlanes::BitPlanes(const std::vector<const CanEvent *> &events) : events_(events) {
+  words_ = (events_.size() + 63) / 64;
+  for (auto e : events_) {
+    bits_ = std::max<int>(bits_, e->size * 8);
+  }
+  planes_.resize(bits_ * words_);
+  present_.resize(bits_ / 8 * words_);
+  size_changes_.resize(words_);
+
+  for (size_t i = 0; i < events_.size(); ++i) {
+    const CanEvent *e = events_[i];
+    const size_t w = i / 64;
+    const uint64_t mask = 1ULL << (i % 64);
+    if (i > 0 && e->size != events_[i - 1]->size) {
+      size_changes_[w] |= mask;
+    }
+    for (int byte = 0; byte < e->size; ++byte) {
+      present_[byte * words_ + w] |= mask;
+      for (int bit = 0, d = e->dat[byte]; d; ++bit, d >>= 1) {
+        if (d & 1) planes_[(byte * 8 + bit) * words_ + w] |= mask;
+      }
+    }
+  }
+}
+
+size_t BitPlanes::nextChange(const cabana::Signal &sig, size_t from) const {
+  // the bits of the signal, big endian signals are contiguous in flipped bit positions
+  std::vector<const uint64_t *> sig_planes;
+  for (int i = 0; i < sig.size; ++i) {
+    const int bit = sig.is_little_endian ? sig.lsb + i : flipBitPos(flipBitPos(sig.msb) + i);
+    if (bit < bits_) sig_planes.push_back(plane(bit));
+  }
+
+  // the first event has nothing to differ from
+  from = std::max<size_t>(from, 1);
+  for (size_t w = from / 64; w < words_; ++w) {
+    uint64_t changes = size_changes_[w];
+    for (const uint64_t *p : sig_planes) {
+      changes |= p[w] ^ ((p[w] << 1) | (w > 0 ? p[w - 1] >> 63 : 0));
+    }
+    if (w == from / 64) {
+      changes &= ~0ULL << (from % 64);
+    }
+    if (changes) {
+      return std::min(w * 64 + __builtin_ctzll(changes), events_.size());
+    }
+  }
+  return events_.size();
+}
+
+size_t BitPlanes::upperBound(uint64_t mono_time) const {
+  return std::upper_bound(events_.cbegin(), events_.cend(), mono_time, CompareCanEvent()) - events_.cbegin();
+}
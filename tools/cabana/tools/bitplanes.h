@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "tools/cabana/dbc/dbc.h"
+
+struct CanEvent;
+
+// The bits of a run of events of one message, one bitset per bit position with a bit per event,
+// so a question about every event of a message is a few AND/XOR/popcount operations per 64 events.
+// Bit positions are numbered like Signal::lsb and Signal::msb: bit i is bit i % 8 of byte i / 8.
+class BitPlanes {
+public:
+  BitPlanes(const std::vector<const CanEvent *> &events);
+  inline size_t size() const { return events_.size(); }
+  inline int words() const { return words_; }
+  // the largest message size in bits
+  inline int bits() const { return bits_; }
+  inline const std::vector<const CanEvent *> &events() const { return events_; }
+  // the bit in each event, 0 in the events too short to have it
+  inline const uint64_t *plane(int bit) const { return &planes_[bit * words_]; }
+  // the events long enough to have the byte
+  inline const uint64_t *present(int byte) const { return &present_[byte * words_]; }
+  // the first event in [from, size()) whose value of sig can differ from the event before it, size() if there is none
+  size_t nextChange(const cabana::Signal &sig, size_t from) const;
+  // the first event after mono_time
+  size_t upperBound(uint64_t mono_time) const;
+
+private:
+  std::vector<const CanEvent *> events_;
+  int words_ = 0;
+  int bits_ = 0;
+  std::vector<uint64_t> planes_;
+  std::vector<uint64_t> present_;
+  // the events with a different size than the event before them
+  std::vector<uint64_t> size_changes_;
+};
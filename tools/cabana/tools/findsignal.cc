@@ -28,27 +28,68 @@ QVariant FindSignalModel::data(const QModelIndex &index, int role) const {
   return {};
 }
 
-void FindSignalModel::search(std::function<bool(double)> cmp) {
+void FindSignalModel::updateBitPlanes() {
+  auto range = [this](const MessageId &id) {
+    const auto &events = can->events(id);
+    auto first = std::lower_bound(events.cbegin(), events.cend(), first_time, CompareCanEvent());
+    return std::pair{first, std::upper_bound(first, events.cend(), last_time, CompareCanEvent())};
+  };
+
+  // events are only added, so the same number of events in the range is the same events
+  std::vector<std::pair<MessageId, std::shared_ptr<const BitPlanes>>> stale;
+  for (const auto &[id, planes] : bit_planes) {
+    auto [first, last] = range(id);
+    if (!planes || planes->size() != (size_t)(last - first)) stale.push_back({id, nullptr});
+  }
+  QtConcurrent::blockingMap(stale, [&](auto &m) {
+    auto [first, last] = range(m.first);
+    m.second = std::make_shared<BitPlanes>(std::vector<const CanEvent *>(first, last));
+  });
+  for (const auto &[id, planes] : stale) {
+    bit_planes[id] = planes;
+  }
+}
+
+void FindSignalModel::search(Find find, std::function<bool(double, double)> cmp) {
   beginResetModel();
+  updateBitPlanes();
 
   std::mutex lock;
   const auto prev_sigs = !histories.isEmpty() ? histories.back() : initial_signals;
   filtered_signals.clear();
   filtered_signals.reserve(prev_sigs.size());
   QtConcurrent::blockingMap(prev_sigs, [&](auto &s) {
-    const auto &events = can->events(s.id);
-    auto first = std::upper_bound(events.cbegin(), events.cend(), s.mono_time, CompareCanEvent());
-    auto last = events.cend();
-    if (last_time < std::numeric_limits<uint64_t>::max()) {
-      last = std::upper_bound(events.cbegin(), events.cend(), last_time, CompareCanEvent());
+    const BitPlanes &planes = *bit_planes.at(s.id);
+    const auto &events = planes.events();
+    if (events.empty()) return;
+
+    // a value only differs from the event before where one of the bits of the signal changes,
+    // so only those events are decoded
+    const cabana::SignalDecoder decoder(s.sig);
+    auto value = [&](size_t i) { return decoder.value(events[i]->dat, events[i]->size); };
+    const size_t first = planes.upperBound(s.mono_time);
+    const size_t prev = first > 0 ? first - 1 : 0;
+    const double prev_value = value(prev);
+    size_t found = events.size();
+    if (find == Find::NoChange) {
+      if (planes.nextChange(s.sig, prev + 1) == events.size()) found = prev;
+    } else if (find == Find::Value && first < events.size() && cmp(value(first), prev_value)) {
+      found = first;
+    } else {
+      for (size_t i = planes.nextChange(s.sig, std::max(first, prev + 1)); i < events.size(); i = planes.nextChange(s.sig, i + 1)) {
+        if (cmp(value(i), prev_value)) {
+          found = i;
+          break;
+        }
+      }
     }
 
-    auto it = std::find_if(first, last, [&](const CanEvent *e) { return cmp(get_raw_value(e->dat, e->size, s.sig)); });
-    if (it != last) {
+    if (found < events.size()) {
+      const CanEvent *e = events[found];
       auto values = s.values;
-      values += QString("(%1, %2)").arg((*it)->mono_time / 1e9 - can->routeStartTime(), 0, 'f', 2).arg(get_raw_value((*it)->dat, (*it)->size, s.sig));
+      values += QString("(%1, %2)").arg(e->mono_time / 1e9 - can->routeStartTime(), 0, 'f', 2).arg(value(found));
       std::lock_guard lk(lock);
-      filtered_signals.push_back({.id = s.id, .mono_time = (*it)->mono_time, .sig = s.sig, .values = values});
+      filtered_signals.push_back({.id = s.id, .mono_time = e->mono_time, .sig = s.sig, .values = values});
     }
   });
   histories.push_back(filtered_signals);
@@ -71,6 +112,7 @@ void FindSignalModel::reset() {
   histories.clear();
   filtered_signals.clear();
   initial_signals.clear();
+  bit_planes.clear();
   endResetModel();
 }
 
@@ -130,7 +172,7 @@ FindSignalDlg::FindSignalDlg(QWidget *parent) : QDialog(parent, Qt::WindowFlags(
   hlayout->addWidget(reset_btn = new QPushButton(tr("Reset"), this));
   vlayout->addLayout(hlayout);
 
-  compare_cb->addItems({"=", ">", ">=", "!=", "<", "<=", "between"});
+  compare_cb->addItems({"=", ">", ">=", "!=", "<", "<=", "between", "changed", "unchanged", "increased", "decreased"});
   value1->setFocus(Qt::OtherFocusReason);
   value2->setVisible(false);
   to_label->setVisible(false);
@@ -166,8 +208,10 @@ FindSignalDlg::FindSignalDlg(QWidget *parent) : QDialog(parent, Qt::WindowFlags(
     if (index.isValid()) emit openMessage(model->filtered_signals[index.row()].id);
   });
   QObject::connect(compare_cb, qOverload<int>(&QComboBox::currentIndexChanged), [=](int index) {
-    to_label->setVisible(index == compare_cb->count() - 1);
-    value2->setVisible(index == compare_cb->count() - 1);
+    // between takes two values, the changes since the last find none
+    value1->setVisible(index <= 6);
+    to_label->setVisible(index == 6);
+    value2->setVisible(index == 6);
   });
 }
 
@@ -177,22 +221,27 @@ void FindSignalDlg::search() {
   }
   auto v1 = value1->text().toDouble();
   auto v2 = value2->text().toDouble();
-  std::function<bool(double)> cmp = nullptr;
+  auto find = FindSignalModel::Find::Value;
+  std::function<bool(double, double)> cmp = nullptr;
   switch (compare_cb->currentIndex()) {
-    case 0: cmp = [v1](double v) { return v == v1;}; break;
-    case 1: cmp = [v1](double v) { return v > v1;}; break;
-    case 2: cmp = [v1](double v) { return v >= v1;}; break;
-    case 3: cmp = [v1](double v) { return v != v1;}; break;
-    case 4: cmp = [v1](double v) { return v < v1;}; break;
-    case 5: cmp = [v1](double v) { return v <= v1;}; break;
-    case 6: cmp = [v1, v2](double v) { return v >= v1 && v <= v2;}; break;
+    case 0: cmp = [v1](double v, double) { return v == v1;}; break;
+    case 1: cmp = [v1](double v, double) { return v > v1;}; break;
+    case 2: cmp = [v1](double v, double) { return v >= v1;}; break;
+    case 3: cmp = [v1](double v, double) { return v != v1;}; break;
+    case 4: cmp = [v1](double v, double) { return v < v1;}; break;
+    case 5: cmp = [v1](double v, double) { return v <= v1;}; break;
+    case 6: cmp = [v1, v2](double v, double) { return v >= v1 && v <= v2;}; break;
+    case 7: find = FindSignalModel::Find::Change; cmp = [](double v, double prev) { return v != prev;}; break;
+    case 8: find = FindSignalModel::Find::NoChange; break;
+    case 9: find = FindSignalModel::Find::Change; cmp = [](double v, double prev) { return v > prev;}; break;
+    case 10: find = FindSignalModel::Find::Change; cmp = [](double v, double prev) { return v < prev;}; break;
   }
   properties_group->setEnabled(false);
   message_group->setEnabled(false);
   search_btn->setEnabled(false);
   stats_label->setVisible(false);
   search_btn->setText("Finding ....");
-  QTimer::singleShot(0, this, [=]() { model->search(cmp); });
+  QTimer::singleShot(0, this, [=]() { model->search(find, cmp); });
 }
 
 void FindSignalDlg::setInitialSignals() {
@@ -218,17 +267,21 @@ void FindSignalDlg::setInitialSignals() {
   double last_time_val = last_time_edit->text().toDouble();
   auto [first_sec, last_sec] = std::minmax(first_time_val, last_time_val);
   uint64_t first_time = (can->routeStartTime() + first_sec) * 1e9;
+  model->first_time = first_time;
   model->last_time = std::numeric_limits<uint64_t>::max();
   if (last_sec > 0) {
     model->last_time = (can->routeStartTime() + last_sec) * 1e9;
   }
   model->initial_signals.clear();
+  model->bit_planes.clear();
 
   for (const auto &[id, m] : can->lastMessages()) {
     if (buses.isEmpty() || buses.contains(id.source) && (addresses.isEmpty() || addresses.contains(id.address))) {
       const auto &events = can->events(id);
       auto e = std::lower_bound(events.cbegin(), events.cend(), first_time, CompareCanEvent());
       if (e != events.cend()) {
+        // built by the first search
+        model->bit_planes[id] = nullptr;
         const int total_size = m.dat.size() * 8;
         for (int size = min_size->value(); size <= max_size->value(); ++size) {
           for (int start = 0; start <= total_size - size; ++start) {
@@ -2,6 +2,8 @@
 
 #include <algorithm>
 #include <limits>
+#include <memory>
+#include <unordered_map>
 
 #include <QAbstractTableModel>
 #include <QCheckBox>
@@ -11,6 +13,7 @@
 
 #include "tools/cabana/commands.h"
 #include "tools/cabana/settings.h"
+#include "tools/cabana/tools/bitplanes.h"
 
 class FindSignalModel : public QAbstractTableModel {
 public:
@@ -22,19 +25,33 @@ public:
     QStringList values;
   };
 
+  enum class Find {
+    Value,     // the first event where cmp(value, prev_value) is true
+    Change,    // the first change where cmp(value, prev_value) is true
+    NoChange,  // signals that do not change
+  };
+
   FindSignalModel(QObject *parent) : QAbstractTableModel(parent) {}
   QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
   QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
   int columnCount(const QModelIndex &parent = QModelIndex()) const override { return 3; }
   int rowCount(const QModelIndex &parent = QModelIndex()) const override { return std::min(filtered_signals.size(), 300); }
-  void search(std::function<bool(double)> cmp);
+  // prev_value is the value of the signal where it was last found
+  void search(Find find, std::function<bool(double value, double prev_value)> cmp);
   void reset();
   void undo();
 
   QList<SearchSignal> filtered_signals;
   QList<SearchSignal> initial_signals;
   QList<QList<SearchSignal>> histories;
+  uint64_t first_time = 0;
   uint64_t last_time = std::numeric_limits<uint64_t>::max();
+  // the events of the searched messages in [first_time, last_time], null until built
+  std::unordered_map<MessageId, std::shared_ptr<const BitPlanes>> bit_planes;
+
+private:
+  // rebuilds the bit planes of the messages that got events in the time range since they were built
+  void updateBitPlanes();
 };
 
 class FindSignalDlg : public QDialog {
@@ -1,6 +1,8 @@
 #include "tools/cabana/tools/findsimilarbits.h"
 
 #include <algorithm>
+#include <mutex>
+#include <tuple>
 
 #include <QGridLayout>
 #include <QHeaderView>
@@ -9,6 +11,7 @@
 #include <QLabel>
 #include <QPushButton>
 #include <QRadioButton>
+#include <QtConcurrent>
 
 #include "tools/cabana/dbc/dbcmanager.h"
 #include "tools/cabana/streams/abstractstream.h"
@@ -116,45 +119,74 @@ void FindSimilarBitsDlg::find() {
 
 QList<FindSimilarBitsDlg::mismatched_struct> FindSimilarBitsDlg::calcBits(uint8_t bus, uint32_t selected_address, int byte_idx,
                                                                           int bit_idx, uint8_t find_bus, bool equal, int min_msgs_cnt) {
-  QHash<uint32_t, QVector<uint32_t>> mismatches;
-  QHash<uint32_t, uint32_t> msg_count;
-  const auto &events = can->allEvents();
-  int bit_to_find = -1;
-  for (const CanEvent *e : events) {
-    if (e->src == bus) {
-      if (e->address == selected_address && e->size > byte_idx) {
-        bit_to_find = ((e->dat[byte_idx] >> (7 - bit_idx)) & 1) != 0;
-      }
+  // the selected bit, which each event is compared with as of its time
+  std::vector<std::pair<uint64_t, bool>> selected_bits;
+  for (const CanEvent *e : can->events({.source = bus, .address = selected_address})) {
+    if (e->size > byte_idx) {
+      selected_bits.push_back({e->mono_time, ((e->dat[byte_idx] >> (7 - bit_idx)) & 1) != 0});
     }
-    if (e->src == find_bus) {
-      ++msg_count[e->address];
-      if (bit_to_find == -1) continue;
+  }
 
-      auto &mismatched = mismatches[e->address];
-      if (mismatched.size() < e->size * 8) {
-        mismatched.resize(e->size * 8);
-      }
-      for (int i = 0; i < e->size; ++i) {
-        for (int j = 0; j < 8; ++j) {
-          int bit = ((e->dat[i] >> (7 - j)) & 1) != 0;
-          mismatched[i * 8 + j] += equal ? (bit != bit_to_find) : (bit == bit_to_find);
-        }
-      }
+  // the bits of the messages are kept for the next search, events are only added so the same
+  // number of events is the same events
+  std::vector<std::pair<MessageId, std::shared_ptr<const BitPlanes>>> messages;
+  for (const auto &[id, _] : can->lastMessages()) {
+    if (id.source == find_bus) {
+      auto it = bit_planes.find(id);
+      bool cached = it != bit_planes.end() && it->second->size() == can->events(id).size();
+      messages.push_back({id, cached ? it->second : nullptr});
     }
   }
 
+  std::mutex lock;
   QList<mismatched_struct> result;
-  result.reserve(mismatches.size());
-  for (auto it = mismatches.begin(); it != mismatches.end(); ++it) {
-    if (auto cnt = msg_count[it.key()]; cnt > min_msgs_cnt) {
-      auto &mismatched = it.value();
-      for (int i = 0; i < mismatched.size(); ++i) {
-        if (float perc = (mismatched[i] / (double)cnt) * 100; perc < 50) {
-          result.push_back({it.key(), (uint32_t)i / 8, (uint32_t)i % 8, mismatched[i], cnt, perc});
-        }
+  QtConcurrent::blockingMap(messages, [&](auto &m) {
+    if (!m.second) {
+      m.second = std::make_shared<BitPlanes>(can->events(m.first));
+    }
+    const auto &planes = m.second;
+    const uint32_t cnt = planes->size();
+    if (cnt <= min_msgs_cnt) return;
+
+    // the selected bit at each event, and the events after the first selected bit
+    const auto &events = planes->events();
+    std::vector<uint64_t> selected(planes->words()), valid(planes->words());
+    int bytes = 0;
+    auto it = selected_bits.cbegin();
+    bool bit = false;
+    for (size_t i = 0; i < events.size(); ++i) {
+      for (; it != selected_bits.cend() && it->first <= events[i]->mono_time; ++it) {
+        bit = it->second;
+      }
+      if (it != selected_bits.cbegin()) {
+        valid[i / 64] |= 1ULL << (i % 64);
+        selected[i / 64] |= (uint64_t)bit << (i % 64);
+        bytes = std::max<int>(bytes, events[i]->size);
       }
     }
+
+    QList<mismatched_struct> mismatched;
+    for (int i = 0; i < bytes * 8; ++i) {
+      // i counts bits from the MSB of each byte
+      const uint64_t *plane = planes->plane(i / 8 * 8 + 7 - i % 8);
+      const uint64_t *present = planes->present(i / 8);
+      uint32_t mismatches = 0;
+      for (int w = 0; w < planes->words(); ++w) {
+        const uint64_t diff = plane[w] ^ selected[w];
+        mismatches += __builtin_popcountll((equal ? diff : ~diff) & valid[w] & present[w]);
+      }
+      if (float perc = (mismatches / (double)cnt) * 100; perc < 50) {
+        mismatched.push_back({events[0]->address, (uint32_t)i / 8, (uint32_t)i % 8, mismatches, cnt, perc});
+      }
+    }
+    std::lock_guard lk(lock);
+    result.append(mismatched);
+  });
+  for (const auto &[id, planes] : messages) {
+    bit_planes[id] = planes;
   }
-  std::sort(result.begin(), result.end(), [](auto &l, auto &r) { return l.perc < r.perc; });
+  std::sort(result.begin(), result.end(), [](auto &l, auto &r) {
+    return std::tie(l.perc, l.address, l.byte_idx, l.bit_idx) < std::tie(r.perc, r.address, r.byte_idx, r.bit_idx);
+  });
   return result;
 }
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <memory>
+#include <unordered_map>
+
 #include <QComboBox>
 #include <QDialog>
 #include <QLineEdit>
@@ -7,6 +10,7 @@
 #include <QTableWidget>
 
 #include "tools/cabana/dbc/dbcmanager.h"
+#include "tools/cabana/tools/bitplanes.h"
 
 class FindSimilarBitsDlg : public QDialog {
   Q_OBJECT
@@ -31,4 +35,5 @@ private:
   QSpinBox *byte_idx_sb, *bit_idx_sb;
   QPushButton *search_btn;
   QLineEdit *min_msgs;
+  std::unordered_map<MessageId, std::shared_ptr<const BitPlanes>> bit_planes;
 };
@@ -1,5 +1,7 @@
 #include "tools/cabana/utils/export.h"
 
+#include <cmath>
+
 #include <QFile>
 #include <QTextStream>
 
@@ -30,14 +32,21 @@ void exportSignalsToCSV(const QString &file_name, const MessageId &msg_id) {
       stream << "," << s->name;
     stream << "\n";
 
+    std::vector<const SignalValues *> columns;
+    for (auto s : msg->sigs) {
+      columns.push_back(&can->signalValues(msg_id, s));
+    }
+
     const uint64_t start_time = can->routeStartTime();
-    for (auto e : can->events(msg_id)) {
+    const auto &events = can->events(msg_id);
+    for (size_t i = 0; i < events.size(); ++i) {
+      const CanEvent *e = events[i];
       stream << QString::number((e->mono_time / 1e9) - start_time, 'f', 2) << ","
              << "0x" << QString::number(e->address, 16) << "," << e->src;
-      for (auto s : msg->sigs) {
-        double value = 0;
-        s->getValue(e->dat, e->size, &value);
-        stream << "," << QString::number(value, 'f', s->precision);
+      for (int j = 0; j < msg->sigs.size(); ++j) {
+        // multiplexed signals are left empty in the events they are not present in
+        const double value = columns[j]->values[i];
+        stream << "," << (std::isnan(value) ? QString() : QString::number(value, 'f', msg->sigs[j]->precision));
       }
       stream << "\n";
     }
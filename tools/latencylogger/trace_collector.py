@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+import argparse
+import json
+import os
+import time
+
+from openpilot.common.trace import TRACE_NO_FRAME_ID, open_rings
+
+
+def process_alive(pid):
+  try:
+    os.kill(pid, 0)
+  except ProcessLookupError:
+    return False
+  except PermissionError:
+    pass
+  return True
+
+
+def main():
+  parser = argparse.ArgumentParser(description="Drains the binary trace rings of all processes into a Chrome trace (chrome://tracing, ui.perfetto.dev)",
+                                   formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+  parser.add_argument("-o", "--output", default="trace.json")
+  parser.add_argument("--duration", type=float, default=0, help="seconds to collect, 0 until interrupted")
+  parser.add_argument("--interval", type=float, default=0.1, help="seconds between polls")
+  args = parser.parse_args()
+
+  rings = {}
+  events, processes = [], {}
+  lost = 0
+  start = time.monotonic()
+  print(f"collecting into {args.output}, ctrl-c to stop")
+  try:
+    while args.duration == 0 or time.monotonic() - start < args.duration:
+      for path, ring in open_rings().items():
+        rings.setdefault(path, ring)
+
+      for path, ring in list(rings.items()):
+        if not ring.valid():
+          continue
+        pid, process, _, _ = ring.header()
+        processes[pid] = process
+        records, ring_lost = ring.drain()
+        lost += ring_lost
+        for nanos, frame_id, event_id, tid in records:
+          event = {"name": ring.event_name(event_id), "ph": "i", "s": "t", "ts": nanos / 1e3, "pid": pid, "tid": tid}
+          if frame_id != TRACE_NO_FRAME_ID:
+            event["args"] = {"frame_id": frame_id}
+          events.append(event)
+
+        # everything of a process that's gone has been read
+        if not process_alive(pid):
+          ring.close()
+          del rings[path]
+          try:
+            os.unlink(path)
+          except FileNotFoundError:
+            pass
+      time.sleep(args.interval)
+  except KeyboardInterrupt:
+    pass
+
+  metadata = [{"name": "process_name", "ph": "M", "pid": pid, "args": {"name": name}} for pid, name in processes.items()]
+  with open(args.output, "w") as f:
+    json.dump({"traceEvents": metadata + events}, f)
+  print(f"wrote {len(events)} events from {len(processes)} processes to {args.output}, {lost} lost")
+
+
+if __name__ == "__main__":
+  main()
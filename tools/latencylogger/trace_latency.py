@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+import argparse
+import json
+from collections import defaultdict
+
+SERVICES = ['camerad', 'modeld', 'controlsd']
+
+
+def percentile(values, p):
+  values = sorted(values)
+  return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def frame_timelines(trace, services):
+  """frame_id -> [(time_ms, service, event)], relative to the frame's first event"""
+  process_names = {e["pid"]: e["args"]["name"] for e in trace["traceEvents"] if e["ph"] == "M" and e["name"] == "process_name"}
+  frames = defaultdict(list)
+  for e in trace["traceEvents"]:
+    service = process_names.get(e.get("pid"))
+    if e["ph"] == "i" and service in services and "frame_id" in e.get("args", {}):
+      frames[e["args"]["frame_id"]].append((e["ts"] / 1e3, service, e["name"]))
+
+  timelines = {}
+  for frame_id, events in frames.items():
+    events.sort()
+    t0 = events[0][0]
+    timelines[frame_id] = [(t - t0, service, name) for t, service, name in events]
+  return timelines
+
+
+def main():
+  parser = argparse.ArgumentParser(description="Per frame pipeline latency from a trace_collector.py trace",
+                                   formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+  parser.add_argument("trace", help="Chrome trace written by trace_collector.py")
+  parser.add_argument("--services", default=",".join(SERVICES), help="pipeline stages, in order")
+  parser.add_argument("--frames", action="store_true", help="print the events of every frame")
+  args = parser.parse_args()
+
+  services = args.services.split(",")
+  with open(args.trace) as f:
+    timelines = frame_timelines(json.load(f), services)
+  # only frames seen by every stage
+  complete = {fid: tl for fid, tl in timelines.items() if {s for _, s, _ in tl} == set(services)}
+  print(f"{len(complete)} of {len(timelines)} frames went through {' -> '.join(services)}")
+
+  if args.frames:
+    for frame_id in sorted(complete):
+      print("=" * 80)
+      print("Frame ID:", frame_id)
+      for t, service, name in complete[frame_id]:
+        print(f"  {service:<12}{name:<50}{t:10.3f} ms")
+
+  # time of each event since the start of its frame
+  latencies = defaultdict(list)
+  for timeline in complete.values():
+    seen = set()
+    for t, service, name in timeline:
+      if (service, name) not in seen:
+        seen.add((service, name))
+        latencies[(service, name)].append(t)
+
+  print(f"\n{'service':<12}{'event':<50}{'p50 ms':>10}{'p90 ms':>10}{'max ms':>10}")
+  order = {s: i for i, s in enumerate(services)}
+  for (service, name), ts in sorted(latencies.items(), key=lambda kv: (order[kv[0][0]], percentile(kv[1], 50))):
+    print(f"{service:<12}{name:<50}{percentile(ts, 50):10.3f}{percentile(ts, 90):10.3f}{max(ts):10.3f}")
+
+
+if __name__ == "__main__":
+  main()
@@ -1,8 +1,10 @@
 #include "tools/replay/camera.h"
 
 #include <capnp/dynamic.h>
+#include <algorithm>
 #include <cassert>
 
+#include "common/timing.h"
 #include "third_party/linux/include/msm_media_info.h"
 #include "tools/replay/util.h"
 
@@ -17,7 +19,8 @@ std::tuple<size_t, size_t, size_t> get_nv12_info(int width, int height) {
   return {nv12_width, nv12_height, nv12_buffer_size};
 }
 
-CameraServer::CameraServer(std::pair<int, int> camera_size[MAX_CAMERAS]) {
+CameraServer::CameraServer(std::pair<int, int> camera_size[MAX_CAMERAS], size_t frame_cache_budget)
+    : frame_cache_budget_(frame_cache_budget) {
   for (int i = 0; i < MAX_CAMERAS; ++i) {
     std::tie(cameras_[i].width, cameras_[i].height) = camera_size[i];
   }
@@ -37,13 +40,12 @@ CameraServer::~CameraServer() {
 void CameraServer::startVipcServer() {
   vipc_server_.reset(new VisionIpcServer("camerad"));
   for (auto &cam : cameras_) {
-    cam.cached_buf.clear();
-
     if (cam.width > 0 && cam.height > 0) {
       rInfo("camera[%d] frame size %dx%d", cam.type, cam.width, cam.height);
       auto [nv12_width, nv12_height, nv12_buffer_size] = get_nv12_info(cam.width, cam.height);
       vipc_server_->create_buffers_with_sizes(cam.stream_type, BUFFER_COUNT, false, cam.width, cam.height,
                                               nv12_buffer_size, nv12_width, nv12_width * nv12_height);
+      cam.cache.reset(new FrameCache(cam.width, cam.height, frame_cache_budget_));
       if (!cam.thread.joinable()) {
         cam.thread = std::thread(&CameraServer::cameraThread, this, std::ref(cam));
       }
@@ -75,28 +77,34 @@ void CameraServer::cameraThread(Camera &cam) {
       rError("camera[%d] failed to get frame: %lu", cam.type, segment_id);
     }
 
-    // Prefetch the next frame
-    getFrame(cam, fr, segment_id + 1, frame_id + 1);
-
+    if (uint64_t frames = cam.frames; frames % (20 * 60) == 0) {
+      rDebug("camera[%d] frame cache hit rate %.1f%%, decode stall %.2f ms/frame", cam.type,
+             100.0 * cam.hits / frames, cam.stall_ns / 1e6 / frames);
+    }
     --publishing_;
   }
 }
 
 VisionBuf *CameraServer::getFrame(Camera &cam, FrameReader *fr, int32_t segment_id, uint32_t frame_id) {
-  // Check if the frame is cached
-  auto buf_it = std::find_if(cam.cached_buf.begin(), cam.cached_buf.end(),
-                             [frame_id](VisionBuf *buf) { return buf->get_frame_id() == frame_id; });
-  if (buf_it != cam.cached_buf.end()) return *buf_it;
-
   VisionBuf *yuv_buf = vipc_server_->get_buffer(cam.stream_type);
-  if (fr->get(segment_id, yuv_buf)) {
+  bool hit = false;
+  uint64_t start = nanos_since_boot();
+  bool ret = cam.cache->get(fr, segment_id, yuv_buf, &hit);
+  ++cam.frames;
+  cam.hits += hit;
+  cam.stall_ns += nanos_since_boot() - start;
+  if (ret) {
     yuv_buf->set_frame_id(frame_id);
-    cam.cached_buf.insert(yuv_buf);
     return yuv_buf;
   }
   return nullptr;
 }
 
+CameraServer::FrameStats CameraServer::frameStats(CameraType type) const {
+  const Camera &cam = cameras_[type];
+  return {cam.frames, cam.hits, cam.stall_ns / 1e6};
+}
+
 void CameraServer::pushFrame(CameraType type, FrameReader *fr, const Event *event) {
   auto &cam = cameras_[type];
   if (cam.width != fr->width || cam.height != fr->height) {
@@ -115,3 +123,142 @@ void CameraServer::waitForSent() {
     std::this_thread::yield();
   }
 }
+
+// class FrameCache
+
+FrameCache::FrameCache(int width, int height, size_t memory_budget, int decode_ahead) {
+  auto [nv12_width, nv12_height, nv12_buffer_size] = get_nv12_info(width, height);
+  frames_ = std::vector<Frame>(std::max<size_t>(2, memory_budget / nv12_buffer_size));
+  for (auto &f : frames_) {
+    f.buf.allocate(nv12_buffer_size);
+    f.buf.init_yuv(width, height, nv12_width, nv12_width * nv12_height);
+  }
+  // the window ahead of the request must fit, see victim()
+  decode_ahead_ = std::clamp<int>(decode_ahead, 0, frames_.size() - 1);
+  thread_ = std::thread(&FrameCache::decodeThread, this);
+}
+
+FrameCache::~FrameCache() {
+  {
+    std::lock_guard lk(mutex_);
+    exit_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+  for (FrameReader *fr : readers_) {
+    fr->cache = nullptr;
+  }
+  for (auto &f : frames_) {
+    f.buf.free();
+  }
+}
+
+bool FrameCache::get(FrameReader *fr, int idx, VisionBuf *buf, bool *hit) {
+  if (hit) *hit = false;
+  // such a frame never gets decoded, don't wait for it
+  if (idx < 0 || idx >= fr->getFrameCount()) return false;
+
+  std::unique_lock lk(mutex_);
+  if (readers_.insert(fr).second) {
+    fr->cache = this;
+  }
+  Frame *f = find(fr, idx);
+  if (f && !f->ok) {
+    // a failed decode isn't cached, the decoder tries again
+    f->fr = nullptr;
+    f = nullptr;
+  }
+  req_fr_ = fr;
+  req_idx_ = idx;
+  cv_.notify_all();
+
+  if (hit) *hit = f != nullptr;
+  cv_.wait(lk, [&]() { return exit_ || (f = find(fr, idx)) != nullptr; });
+  if (!f || !f->ok) return false;
+
+  f->last_used = ++tick_;
+  memcpy(buf->addr, f->buf.addr, std::min(buf->len, f->buf.len));
+  return true;
+}
+
+void FrameCache::release(FrameReader *fr) {
+  std::unique_lock lk(mutex_);
+  cv_.wait(lk, [&]() { return decoding_fr_ != fr; });
+  for (auto &f : frames_) {
+    if (f.fr == fr) f.fr = nullptr;
+  }
+  if (req_fr_ == fr) req_fr_ = nullptr;
+  if (last_decoded_fr_ == fr) last_decoded_fr_ = nullptr;
+  readers_.erase(fr);
+}
+
+void FrameCache::decodeThread() {
+  std::unique_lock lk(mutex_);
+  while (!exit_) {
+    FrameReader *fr = req_fr_;
+    int target = -1, window_begin = 0, window_end = 0;
+    if (fr) {
+      // the GOP of the request and the frames ahead of it
+      window_begin = fr->keyFrameIndex(req_idx_);
+      window_end = std::min<int>(req_idx_ + decode_ahead_, fr->getFrameCount() - 1);
+      for (int i = req_idx_; i <= window_end; ++i) {
+        if (!find(fr, i)) {
+          target = i;
+          break;
+        }
+      }
+    }
+    Frame *f = target >= 0 ? victim(window_begin, window_end) : nullptr;
+    if (!f) {
+      cv_.wait(lk);
+      continue;
+    }
+
+    // continue decoding sequentially if possible, seeking decodes from the key frame anyway.
+    // the decoder is shared by the readers of a camera, so switching readers starts at a key frame.
+    int key_frame = fr->keyFrameIndex(target);
+    int next = fr->prev_idx + 1;
+    if (fr != last_decoded_fr_ || next > target || next < key_frame) {
+      next = key_frame;
+    }
+    f->fr = nullptr;
+    decoding_fr_ = fr;
+    lk.unlock();
+    bool ok = fr->get(next, &f->buf);
+    lk.lock();
+    decoding_fr_ = nullptr;
+    last_decoded_fr_ = fr;
+
+    // release() waits for the decoder, fr is still valid
+    if (Frame *old = find(fr, next)) {
+      old->fr = nullptr;
+    }
+    f->fr = fr;
+    f->idx = next;
+    f->ok = ok;
+    f->last_used = ++tick_;
+    cv_.notify_all();
+  }
+}
+
+FrameCache::Frame *FrameCache::find(FrameReader *fr, int idx) {
+  for (auto &f : frames_) {
+    if (f.fr == fr && f.idx == idx) return &f;
+  }
+  return nullptr;
+}
+
+// a free frame, the least recently used one outside the window of the request,
+// or the oldest frame of the request's GOP behind it.
+FrameCache::Frame *FrameCache::victim(int window_begin, int window_end) {
+  Frame *lru = nullptr, *behind = nullptr;
+  for (auto &f : frames_) {
+    if (!f.fr) return &f;
+    if (f.fr != req_fr_ || f.idx < window_begin || f.idx > window_end) {
+      if (!lru || f.last_used < lru->last_used) lru = &f;
+    } else if (f.idx < req_idx_) {
+      if (!behind || f.idx < behind->idx) behind = &f;
+    }
+  }
+  return lru ? lru : behind;
+}
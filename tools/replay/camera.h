@@ -1,9 +1,13 @@
 #pragma once
 
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <set>
+#include <thread>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 #include "msgq/visionipc/visionipc_server.h"
 #include "common/queue.h"
@@ -12,13 +16,64 @@
 
 std::tuple<size_t, size_t, size_t> get_nv12_info(int width, int height);
 
+const size_t FRAME_CACHE_DEFAULT_BUDGET = 100 * 1024 * 1024;
+const int FRAME_CACHE_DECODE_AHEAD = 10;
+
+// Decoded NV12 frames of one camera. A background thread decodes the frames following the last
+// request, and keeps the frames of the GOP a seek had to decode anyway, so sequential playback
+// and skips within the cache don't wait for the decoder.
+// The cache is the only user of the decoders of its camera.
+class FrameCache {
+public:
+  FrameCache(int width, int height, size_t memory_budget = FRAME_CACHE_DEFAULT_BUDGET,
+             int decode_ahead = FRAME_CACHE_DECODE_AHEAD);
+  ~FrameCache();
+  // copies frame idx of fr to buf, waits for the decoder if it isn't cached
+  bool get(FrameReader *fr, int idx, VisionBuf *buf, bool *hit = nullptr);
+  // drops the frames of fr, waits until the decode thread is done with it
+  void release(FrameReader *fr);
+  inline size_t capacity() const { return frames_.size(); }
+
+private:
+  struct Frame {
+    FrameReader *fr = nullptr;
+    int idx = -1;
+    bool ok = false;  // a failed decode is only kept to answer the request waiting for it
+    uint64_t last_used = 0;
+    VisionBuf buf;
+  };
+  void decodeThread();
+  Frame *find(FrameReader *fr, int idx);
+  Frame *victim(int window_begin, int window_end);
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<Frame> frames_;
+  // readers pointing back to this cache
+  std::set<FrameReader *> readers_;
+  // the last request
+  FrameReader *req_fr_ = nullptr;
+  int req_idx_ = -1;
+  FrameReader *decoding_fr_ = nullptr, *last_decoded_fr_ = nullptr;
+  int decode_ahead_;
+  uint64_t tick_ = 0;
+  bool exit_ = false;
+  std::thread thread_;
+};
+
 class CameraServer {
 public:
-  CameraServer(std::pair<int, int> camera_size[MAX_CAMERAS] = nullptr);
+  CameraServer(std::pair<int, int> camera_size[MAX_CAMERAS] = nullptr, size_t frame_cache_budget = FRAME_CACHE_DEFAULT_BUDGET);
   ~CameraServer();
   void pushFrame(CameraType type, FrameReader* fr, const Event *event);
   void waitForSent();
 
+  struct FrameStats {
+    uint64_t frames, hits;
+    double stall_ms;  // time spent waiting for the decoder
+  };
+  FrameStats frameStats(CameraType type) const;
+
 protected:
   struct Camera {
     CameraType type;
@@ -26,8 +81,9 @@ protected:
     int width;
     int height;
     std::thread thread;
-    SafeQueue<std::pair<FrameReader*, const Event *>> queue;
-    std::set<VisionBuf *> cached_buf;
+    SpscQueue<std::pair<FrameReader*, const Event *>, 64> queue;
+    std::unique_ptr<FrameCache> cache;
+    std::atomic<uint64_t> frames = 0, hits = 0, stall_ns = 0;
   };
   void startVipcServer();
   void cameraThread(Camera &cam);
@@ -39,5 +95,6 @@ protected:
       {.type = WideRoadCam, .stream_type = VISION_STREAM_WIDE_ROAD},
   };
   std::atomic<int> publishing_ = 0;
+  size_t frame_cache_budget_;
   std::unique_ptr<VisionIpcServer> vipc_server_;
 };
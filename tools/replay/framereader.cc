@@ -1,12 +1,23 @@
 #include "tools/replay/framereader.h"
 
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
 #include <map>
 #include <memory>
+#include <thread>
 #include <tuple>
 #include <utility>
 
 #include "common/util.h"
 #include "third_party/libyuv/include/libyuv.h"
+#include "tools/replay/camera.h"
 #include "tools/replay/util.h"
 
 #ifdef __APPLE__
@@ -29,9 +40,88 @@ enum AVPixelFormat get_hw_format(AVCodecContext *ctx, const enum AVPixelFormat *
   return AV_PIX_FMT_YUV420P;
 }
 
+std::atomic<int> sw_decode_threads = 0;
+std::atomic<int> sw_convert_threads = 2;
+
+// runs the row bands of frame conversions. the calling thread converts bands of its own frame too,
+// so a frame is never queued behind a busy pool and the decoders of all cameras share the workers.
+class ConvertPool {
+public:
+  ConvertPool(int threads) {
+    for (int i = 0; i < threads; ++i) {
+      threads_.emplace_back(&ConvertPool::worker, this);
+    }
+  }
+  ~ConvertPool() {
+    {
+      std::unique_lock lk(mutex_);
+      exit_ = true;
+    }
+    cv_.notify_all();
+    for (auto &t : threads_) t.join();
+  }
+  inline int threads() const { return threads_.size(); }
+
+  void run(int tasks, const std::function<void(int)> &fn) {
+    Job job = {.fn = &fn, .tasks = tasks};
+    std::unique_lock lk(mutex_);
+    jobs_.push_back(&job);
+    cv_.notify_all();
+    while (job.next < job.tasks) {
+      runTask(lk, &job);
+    }
+    done_cv_.wait(lk, [&]() { return job.done == job.tasks; });
+  }
+
+private:
+  struct Job {
+    const std::function<void(int)> *fn;
+    int tasks, next = 0, done = 0;
+  };
+
+  void runTask(std::unique_lock<std::mutex> &lk, Job *job) {
+    int task = job->next++;
+    if (job->next == job->tasks) {
+      jobs_.erase(std::find(jobs_.begin(), jobs_.end(), job));
+    }
+    lk.unlock();
+    (*job->fn)(task);
+    lk.lock();
+    if (++job->done == job->tasks) {
+      done_cv_.notify_all();
+    }
+  }
+
+  void worker() {
+    std::unique_lock lk(mutex_);
+    while (true) {
+      cv_.wait(lk, [this]() { return exit_ || !jobs_.empty(); });
+      if (exit_) break;
+      runTask(lk, jobs_.front());
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_, done_cv_;
+  std::deque<Job *> jobs_;
+  std::vector<std::thread> threads_;
+  bool exit_ = false;
+};
+
+// replaced when the number of threads changes, decoders in the middle of a conversion keep the old one
+std::shared_ptr<ConvertPool> convert_pool() {
+  static std::mutex mutex;
+  static std::shared_ptr<ConvertPool> pool;
+  std::unique_lock lk(mutex);
+  if (!pool || pool->threads() != sw_convert_threads) {
+    pool = std::make_shared<ConvertPool>(sw_convert_threads);
+  }
+  return pool;
+}
+
 struct DecoderManager {
   VideoDecoder *acquire(CameraType type, AVCodecParameters *codecpar, bool hw_decoder) {
-    auto key = std::tuple(type, codecpar->width, codecpar->height);
+    auto key = std::tuple(type, codecpar->width, codecpar->height, sw_decode_threads.load());
     std::unique_lock lock(mutex_);
     if (auto it = decoders_.find(key); it != decoders_.end()) {
       return it->second.get();
@@ -46,18 +136,79 @@ struct DecoderManager {
   }
 
   std::mutex mutex_;
-  std::map<std::tuple<CameraType, int, int>, std::unique_ptr<VideoDecoder>> decoders_;
+  std::map<std::tuple<CameraType, int, int, int>, std::unique_ptr<VideoDecoder>> decoders_;
 };
 
 DecoderManager decoder_manager;
 
+// packet index of a video, stored in the download cache so reloading a video skips reading every packet
+const uint32_t PACKET_INDEX_MAGIC = 0x49544b50;  // "PKTI"
+
+struct PacketIndexHeader {
+  uint32_t magic;
+  uint32_t count;
+  int64_t file_size;
+  int64_t mtime;  // the index is rebuilt if the video changed
+};
+
+std::string packet_index_path(const std::string &file) {
+  return cacheFilePath(file) + ".pkt";
+}
+
+bool video_file_stat(const std::string &file, PacketIndexHeader *header) {
+  struct stat st = {};
+  if (stat(file.c_str(), &st) != 0) return false;
+  *header = {PACKET_INDEX_MAGIC, 0, st.st_size, st.st_mtime};
+  return true;
+}
+
+bool load_packet_index(const std::string &file, std::vector<FrameReader::PacketInfo> &packets) {
+  PacketIndexHeader expected;
+  if (!video_file_stat(file, &expected)) return false;
+
+  std::string data = util::read_file(packet_index_path(file));
+  if (data.size() < sizeof(PacketIndexHeader)) return false;
+  PacketIndexHeader header;
+  memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != expected.magic || header.file_size != expected.file_size || header.mtime != expected.mtime ||
+      header.count == 0 || data.size() != sizeof(header) + header.count * sizeof(FrameReader::PacketInfo)) {
+    return false;
+  }
+  packets.resize(header.count);
+  memcpy(packets.data(), data.data() + sizeof(header), header.count * sizeof(FrameReader::PacketInfo));
+  return true;
+}
+
+void save_packet_index(const std::string &file, const std::vector<FrameReader::PacketInfo> &packets) {
+  PacketIndexHeader header;
+  if (!video_file_stat(file, &header)) return;
+
+  header.count = packets.size();
+  std::string data((const char *)&header, sizeof(header));
+  data.append((const char *)packets.data(), packets.size() * sizeof(FrameReader::PacketInfo));
+  // written to a temporary file first, concurrent readers never see a partial index
+  const std::string index_file = packet_index_path(file);
+  const std::string tmp_file = index_file + "." + std::to_string(getpid()) + ".tmp";
+  if (util::write_file(tmp_file.c_str(), data.data(), data.size(), O_WRONLY | O_CREAT | O_TRUNC) == 0) {
+    std::rename(tmp_file.c_str(), index_file.c_str());
+  } else {
+    std::remove(tmp_file.c_str());
+  }
+}
+
 }  // namespace
 
+void set_decoder_threads(int decode_threads, int convert_threads) {
+  sw_decode_threads = std::max(0, decode_threads);
+  sw_convert_threads = std::max(0, convert_threads);
+}
+
 FrameReader::FrameReader() {
   av_log_set_level(AV_LOG_QUIET);
 }
 
 FrameReader::~FrameReader() {
+  if (cache) cache->release(this);
   if (input_ctx) avformat_close_input(&input_ctx);
 }
 
@@ -87,6 +238,10 @@ bool FrameReader::loadFromFile(CameraType type, const std::string &file, bool no
   width = decoder_->width;
   height = decoder_->height;
 
+  if (load_packet_index(file, packets_info)) {
+    return true;
+  }
+
   AVPacket pkt;
   packets_info.reserve(60 * 20);  // 20fps, one minute
   while (!(abort && *abort) && av_read_frame(input_ctx, &pkt) == 0) {
@@ -94,6 +249,9 @@ bool FrameReader::loadFromFile(CameraType type, const std::string &file, bool no
     av_packet_unref(&pkt);
   }
   avio_seek(input_ctx->pb, 0, SEEK_SET);
+  if (!(abort && *abort) && !packets_info.empty()) {
+    save_packet_index(file, packets_info);
+  }
   return !packets_info.empty();
 }
 
@@ -104,6 +262,15 @@ bool FrameReader::get(int idx, VisionBuf *buf) {
   return decoder_->decode(this, idx, buf);
 }
 
+int FrameReader::keyFrameIndex(int idx) const {
+  for (int i = std::min<int>(idx, packets_info.size() - 1); i >= 0; --i) {
+    if (packets_info[i].flags & AV_PKT_FLAG_KEY) {
+      return i;
+    }
+  }
+  return idx;
+}
+
 // class VideoDecoder
 
 VideoDecoder::VideoDecoder() {
@@ -133,6 +300,11 @@ bool VideoDecoder::open(AVCodecParameters *codecpar, bool hw_decoder) {
   if (hw_decoder && !initHardwareDecoder(HW_DEVICE_TYPE)) {
     rWarning("No device with hardware decoder found. fallback to CPU decoding.");
   }
+  if (!decoder_ctx->hw_device_ctx) {
+    // frame threads decode the following frames while the current one is converted
+    decoder_ctx->thread_count = sw_decode_threads;
+    decoder_ctx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+  }
 
   if (avcodec_open2(decoder_ctx, decoder, nullptr) < 0) {
     rError("Failed to open codec");
@@ -168,67 +340,87 @@ bool VideoDecoder::initHardwareDecoder(AVHWDeviceType hw_device_type) {
 }
 
 bool VideoDecoder::decode(FrameReader *reader, int idx, VisionBuf *buf) {
-  int from_idx = idx;
-  if (idx != reader->prev_idx + 1) {
-    // seeking to the nearest key frame
-    for (int i = idx; i >= 0; --i) {
-      if (reader->packets_info[i].flags & AV_PKT_FLAG_KEY) {
-        from_idx = i;
-        break;
-      }
-    }
-    avio_seek(reader->input_ctx->pb, reader->packets_info[from_idx].pos, SEEK_SET);
+  if (reader != reader_ || idx != reader->prev_idx + 1 || idx != next_frame_) {
+    // seeking to the nearest key frame, dropping the frames in flight
+    next_packet_ = next_frame_ = reader->keyFrameIndex(idx);
+    avio_seek(reader->input_ctx->pb, reader->packets_info[next_packet_].pos, SEEK_SET);
+    avcodec_flush_buffers(decoder_ctx);
+    reader_ = reader;
+    draining_ = false;
   }
   reader->prev_idx = idx;
 
+  // frames carry the index of their packet in pts, a packet failing to decode does not shift the frames after it
   bool result = false;
-  AVPacket pkt;
-  for (int i = from_idx; i <= idx; ++i) {
-    if (av_read_frame(reader->input_ctx, &pkt) == 0) {
-      AVFrame *f = decodeFrame(&pkt);
-      if (f && i == idx) {
-        result = copyBuffer(f, buf);
+  while (true) {
+    int ret = avcodec_receive_frame(decoder_ctx, av_frame_);
+    if (ret == AVERROR(EAGAIN)) {
+      if (!sendPacket(reader)) break;
+      continue;
+    }
+    if (ret != 0) {
+      if (ret != AVERROR_EOF) rError("avcodec_receive_frame error: %d", ret);
+      break;
+    }
+
+    int frame_idx = av_frame_->pts;
+    next_frame_ = frame_idx + 1;
+    if (frame_idx == idx) {
+      if (av_frame_->format != hw_pix_fmt) {
+        result = copyBuffer(av_frame_, buf);
+      } else if (av_hwframe_transfer_data(hw_frame_, av_frame_, 0) == 0) {
+        result = copyBuffer(hw_frame_, buf);
+      } else {
+        rError("error transferring frame data from GPU to CPU");
       }
-      av_packet_unref(&pkt);
     }
+    if (frame_idx >= idx) break;
   }
+  if (!result) reader_ = nullptr;
   return result;
 }
 
-AVFrame *VideoDecoder::decodeFrame(AVPacket *pkt) {
-  int ret = avcodec_send_packet(decoder_ctx, pkt);
-  if (ret < 0) {
-    rError("Error sending a packet for decoding: %d", ret);
-    return nullptr;
-  }
+bool VideoDecoder::sendPacket(FrameReader *reader) {
+  if (draining_) return false;
 
-  ret = avcodec_receive_frame(decoder_ctx, av_frame_);
-  if (ret != 0) {
-    rError("avcodec_receive_frame error: %d", ret);
-    return nullptr;
+  int ret;
+  AVPacket pkt;
+  if (av_read_frame(reader->input_ctx, &pkt) == 0) {
+    pkt.pts = pkt.dts = next_packet_++;
+    ret = avcodec_send_packet(decoder_ctx, &pkt);
+    av_packet_unref(&pkt);
+  } else {
+    // end of the video, flush the frames in flight
+    draining_ = true;
+    ret = avcodec_send_packet(decoder_ctx, nullptr);
   }
-
-  if (av_frame_->format == hw_pix_fmt && av_hwframe_transfer_data(hw_frame_, av_frame_, 0) < 0) {
-    rError("error transferring frame data from GPU to CPU");
-    return nullptr;
+  if (ret < 0) {
+    // the packet is dropped, its frame never comes out
+    rError("Error sending a packet for decoding: %d", ret);
   }
-  return (av_frame_->format == hw_pix_fmt) ? hw_frame_ : av_frame_;
+  return true;
 }
 
 bool VideoDecoder::copyBuffer(AVFrame *f, VisionBuf *buf) {
-  if (hw_pix_fmt == HW_PIX_FMT) {
-    for (int i = 0; i < height/2; i++) {
-      memcpy(buf->y + (i*2 + 0)*buf->stride, f->data[0] + (i*2 + 0)*f->linesize[0], width);
-      memcpy(buf->y + (i*2 + 1)*buf->stride, f->data[0] + (i*2 + 1)*f->linesize[0], width);
-      memcpy(buf->uv + i*buf->stride, f->data[1] + i*f->linesize[1], width);
+  // converted in bands of rows, each band starts at an even row to share the chroma rows
+  auto pool = convert_pool();
+  const int bands = pool->threads() + 1;
+  pool->run(bands, [&](int band) {
+    const int begin = (height / 2) * band / bands, end = (height / 2) * (band + 1) / bands;
+    if (hw_pix_fmt == HW_PIX_FMT) {
+      for (int i = begin; i < end; i++) {
+        memcpy(buf->y + (i*2 + 0)*buf->stride, f->data[0] + (i*2 + 0)*f->linesize[0], width);
+        memcpy(buf->y + (i*2 + 1)*buf->stride, f->data[0] + (i*2 + 1)*f->linesize[0], width);
+        memcpy(buf->uv + i*buf->stride, f->data[1] + i*f->linesize[1], width);
+      }
+    } else {
+      libyuv::I420ToNV12(f->data[0] + begin*2*f->linesize[0], f->linesize[0],
+                         f->data[1] + begin*f->linesize[1], f->linesize[1],
+                         f->data[2] + begin*f->linesize[2], f->linesize[2],
+                         buf->y + begin*2*buf->stride, buf->stride,
+                         buf->uv + begin*buf->stride, buf->stride,
+                         width, (end - begin) * 2);
     }
-  } else {
-    libyuv::I420ToNV12(f->data[0], f->linesize[0],
-                       f->data[1], f->linesize[1],
-                       f->data[2], f->linesize[2],
-                       buf->y, buf->stride,
-                       buf->uv, buf->stride,
-                       width, height);
-  }
+  });
   return true;
 }
@@ -13,6 +13,12 @@ extern "C" {
 }
 
 class VideoDecoder;
+class FrameCache;
+
+// software decoding threads: libavcodec frame/slice threads per decoder (0 for one per core)
+// and workers converting decoded frames to NV12 next to the decoding thread.
+// applies to the decoders opened afterwards.
+void set_decoder_threads(int decode_threads, int convert_threads);
 
 class FrameReader {
 public:
@@ -23,12 +29,16 @@ public:
   bool loadFromFile(CameraType type, const std::string &file, bool no_hw_decoder = false, std::atomic<bool> *abort = nullptr);
   bool get(int idx, VisionBuf *buf);
   size_t getFrameCount() const { return packets_info.size(); }
+  // the key frame decoding of idx has to start from
+  int keyFrameIndex(int idx) const;
 
   int width = 0, height = 0;
 
   VideoDecoder *decoder_ = nullptr;
   AVFormatContext *input_ctx = nullptr;
   int prev_idx = -1;
+  // set while a FrameCache decodes from this reader, released on destruction
+  FrameCache *cache = nullptr;
   struct PacketInfo {
     int flags;
     int64_t pos;
@@ -47,10 +57,15 @@ public:
 
 private:
   bool initHardwareDecoder(AVHWDeviceType hw_device_type);
-  AVFrame *decodeFrame(AVPacket *pkt);
+  bool sendPacket(FrameReader *reader);
   bool copyBuffer(AVFrame *f, VisionBuf *buf);
 
   AVFrame *av_frame_, *hw_frame_;
+  // with frame threading the packets after the requested frame stay in flight,
+  // sequential reads of the same reader continue from them.
+  FrameReader *reader_ = nullptr;
+  int next_packet_ = 0, next_frame_ = 0;
+  bool draining_ = false;
   AVCodecContext *decoder_ctx = nullptr;
   AVPixelFormat hw_pix_fmt = AV_PIX_FMT_NONE;
   AVBufferRef *hw_device_ctx = nullptr;
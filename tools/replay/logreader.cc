@@ -1,14 +1,43 @@
 #include "tools/replay/logreader.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <algorithm>
 #include <utility>
+#include "system/loggerd/log_index.h"
 #include "tools/replay/filereader.h"
 #include "tools/replay/util.h"
 
+LogReader::~LogReader() {
+  unmap();
+}
+
 bool LogReader::load(const std::string &url, std::atomic<bool> *abort, bool local_cache, int chunk_size, int retries) {
+  // uncompressed local logs (and cached downloads) are mapped, the events point into the mapping
+  const bool is_remote = url.find("https://") == 0;
+  const bool is_compressed = url.find(".bz2") != std::string::npos || url.find(".zst") != std::string::npos;
+  if (!is_compressed && (!is_remote || local_cache)) {
+    const std::string local_file = is_remote ? cacheFilePath(url) : url;
+    if (!is_remote && util::file_exists(local_file + ".idx") && loadIndexed(local_file, 0, UINT64_MAX, abort)) {
+      return !events.empty();
+    }
+    if (util::file_exists(local_file) && map(local_file)) {
+      madvise(mapped_, mapped_size_, MADV_SEQUENTIAL);
+      madvise(mapped_, mapped_size_, MADV_WILLNEED);
+      return parse((const char *)mapped_, mapped_size_, false, abort);
+    }
+  }
+
   std::string data = FileReader(local_cache, chunk_size, retries).read(url, abort);
-  if (!data.empty() && url.find(".bz2") != std::string::npos)
-    data = decompressBZ2(data, abort);
+  if (!data.empty()) {
+    if (url.find(".bz2") != std::string::npos)
+      data = decompressBZ2(data, abort);
+    else if (url.find(".zst") != std::string::npos)
+      data = decompressZST(data, abort);
+  }
 
   bool success = !data.empty() && load(data.data(), data.size(), abort);
   if (filters_.empty())
@@ -17,6 +46,38 @@ bool LogReader::load(const std::string &url, std::atomic<bool> *abort, bool loca
 }
 
 bool LogReader::load(const char *data, size_t size, std::atomic<bool> *abort) {
+  return parse(data, size, !filters_.empty(), abort);
+}
+
+bool LogReader::map(const std::string &file, size_t expected_size) {
+  int fd = HANDLE_EINTR(open(file.c_str(), O_RDONLY | O_CLOEXEC));
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st = {};
+  void *addr = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0 && (expected_size == 0 || (size_t)st.st_size == expected_size)) {
+    addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (addr == MAP_FAILED) {
+    return false;
+  }
+  unmap();
+  mapped_ = addr;
+  mapped_size_ = st.st_size;
+  return true;
+}
+
+void LogReader::unmap() {
+  if (mapped_) {
+    munmap(mapped_, mapped_size_);
+    mapped_ = nullptr;
+    mapped_size_ = 0;
+  }
+}
+
+bool LogReader::parse(const char *data, size_t size, bool copy_events, std::atomic<bool> *abort) {
   try {
     events.reserve(65000);
     kj::ArrayPtr<const capnp::word> words((const capnp::word *)data, size / sizeof(capnp::word));
@@ -27,26 +88,17 @@ bool LogReader::load(const char *data, size_t size, std::atomic<bool> *abort) {
       auto event_data = kj::arrayPtr(words.begin(), reader.getEnd());
       words = kj::arrayPtr(reader.getEnd(), words.end());
 
-      if (!filters_.empty()) {
-        if (which >= filters_.size() || !filters_[which])
-          continue;
+      if (!filters_.empty() && (which >= filters_.size() || !filters_[which]))
+        continue;
+      if (copy_events) {
+        // keep only the filtered events, the caller's buffer is released after loading
         auto buf = buffer_.allocate(event_data.size() * sizeof(capnp::word));
         memcpy(buf, event_data.begin(), event_data.size() * sizeof(capnp::word));
         event_data = kj::arrayPtr((const capnp::word *)buf, event_data.size());
       }
 
-      uint64_t mono_time = event.getLogMonoTime();
-      const Event &evt = events.emplace_back(which, mono_time, event_data);
-      // Add encodeIdx packet again as a frame packet for the video stream
-      if (evt.which == cereal::Event::ROAD_ENCODE_IDX ||
-          evt.which == cereal::Event::DRIVER_ENCODE_IDX ||
-          evt.which == cereal::Event::WIDE_ROAD_ENCODE_IDX) {
-        auto idx = capnp::AnyStruct::Reader(event).getPointerSection()[0].getAs<cereal::EncodeIndex>();
-        if (uint64_t sof = idx.getTimestampSof()) {
-          mono_time = sof;
-        }
-        events.emplace_back(which, mono_time, event_data, idx.getSegmentNum());
-      }
+      events.emplace_back(which, event.getLogMonoTime(), event_data);
+      addFrameEvent(event, event_data);
     }
   } catch (const kj::Exception &e) {
     rWarning("Failed to parse log : %s.\nRetrieved %zu events from corrupt log", e.getDescription().cStr(), events.size());
@@ -59,3 +111,74 @@ bool LogReader::load(const char *data, size_t size, std::atomic<bool> *abort) {
   }
   return false;
 }
+
+bool LogReader::loadIndexed(const std::string &file, uint64_t begin_mono_time, uint64_t end_mono_time, std::atomic<bool> *abort) {
+  std::string index_data = util::read_file(file + ".idx");
+  LogIndexView index;
+  if (!index.parse(index_data)) {
+    return false;
+  }
+
+  // an index that doesn't match the log (e.g. a log that was rewritten) is ignored
+  if (!map(file, index.header->log_size)) {
+    return false;
+  }
+  // only the selected events are touched, don't read ahead the rest of the log
+  const bool partial = !filters_.empty() || begin_mono_time > 0 || end_mono_time < UINT64_MAX;
+  madvise(mapped_, mapped_size_, partial ? MADV_RANDOM : MADV_WILLNEED);
+  events.clear();
+
+  const capnp::word *words = (const capnp::word *)mapped_;
+  const LogIndexHeader *header = index.header;
+  try {
+    for (uint32_t i = 0; i < header->num_groups && !(abort && *abort); ++i) {
+      const LogIndexGroup &group = index.groups[i];
+      if (!filters_.empty() && (group.which >= filters_.size() || !filters_[group.which]))
+        continue;
+
+      const uint64_t bucket_begin = header->start_mono_time + group.bucket * header->bucket_ns;
+      if (bucket_begin >= end_mono_time || bucket_begin + header->bucket_ns <= begin_mono_time)
+        continue;
+
+      const auto which = (cereal::Event::Which)group.which;
+      const bool is_encode_idx = which == cereal::Event::ROAD_ENCODE_IDX ||
+                                 which == cereal::Event::DRIVER_ENCODE_IDX ||
+                                 which == cereal::Event::WIDE_ROAD_ENCODE_IDX;
+      for (uint32_t j = group.first_event; j < group.first_event + group.num_events; ++j) {
+        const LogIndexEvent &e = index.events[j];
+        if (e.mono_time < begin_mono_time || e.mono_time >= end_mono_time)
+          continue;
+
+        auto event_data = kj::arrayPtr(words + e.offset_words, e.size_words);
+        events.emplace_back(which, e.mono_time, event_data);
+        if (is_encode_idx) {
+          capnp::FlatArrayMessageReader reader(event_data);
+          addFrameEvent(reader.getRoot<cereal::Event>(), event_data);
+        }
+      }
+    }
+  } catch (const kj::Exception &e) {
+    rWarning("Failed to parse indexed log : %s", e.getDescription().cStr());
+  }
+
+  if (!(abort && *abort)) {
+    std::sort(events.begin(), events.end());
+    return true;
+  }
+  return false;
+}
+
+void LogReader::addFrameEvent(const cereal::Event::Reader &event, const kj::ArrayPtr<const capnp::word> &data) {
+  // Add encodeIdx packet again as a frame packet for the video stream
+  auto which = event.which();
+  if (which == cereal::Event::ROAD_ENCODE_IDX ||
+      which == cereal::Event::DRIVER_ENCODE_IDX ||
+      which == cereal::Event::WIDE_ROAD_ENCODE_IDX) {
+    auto idx = capnp::AnyStruct::Reader(event).getPointerSection()[0].getAs<cereal::EncodeIndex>();
+    uint64_t mono_time = event.getLogMonoTime();
+    if (uint64_t sof = idx.getTimestampSof()) {
+      mono_time = sof;
+    }
+    events.emplace_back(which, mono_time, data, idx.getSegmentNum());
+  }
+}
@@ -28,13 +28,29 @@ public:
 class LogReader {
 public:
   LogReader(const std::vector<bool> &filters = {}) { filters_ = filters; }
+  ~LogReader();
+  // not copyable, the events point into the data it owns
+  LogReader(const LogReader&) = delete;
+  LogReader& operator=(const LogReader&) = delete;
   bool load(const std::string &url, std::atomic<bool> *abort = nullptr,
             bool local_cache = false, int chunk_size = -1, int retries = 0);
   bool load(const char *data, size_t size, std::atomic<bool> *abort = nullptr);
+  // maps an uncompressed local log and loads the filtered events in [begin_mono_time, end_mono_time)
+  // through its side index. returns false if the log has no valid index.
+  bool loadIndexed(const std::string &file, uint64_t begin_mono_time = 0, uint64_t end_mono_time = UINT64_MAX,
+                   std::atomic<bool> *abort = nullptr);
   std::vector<Event> events;
 
 private:
+  bool parse(const char *data, size_t size, bool copy_events, std::atomic<bool> *abort);
+  bool map(const std::string &file, size_t expected_size = 0);
+  void unmap();
+  void addFrameEvent(const cereal::Event::Reader &event, const kj::ArrayPtr<const capnp::word> &data);
+
+  // owns the event data: a decompressed log, or a mapping of an uncompressed local log
   std::string raw_;
+  void *mapped_ = nullptr;
+  size_t mapped_size_ = 0;
   std::vector<bool> filters_;
   MonotonicBuffer buffer_{1024 * 1024};
 };
@@ -32,6 +32,13 @@ int main(int argc, char *argv[]) {
   parser.addOption({{"a", "allow"}, "whitelist of services to send", "allow"});
   parser.addOption({{"b", "block"}, "blacklist of services to send", "block"});
   parser.addOption({{"c", "cache"}, "cache <n> segments in memory. default is 5", "n"});
+  parser.addOption({"prefetch", "load <n> segments in parallel. default is 2", "n"});
+  parser.addOption({"frame-cache", "cache <mb> of decoded frames per camera. default is 100", "mb"});
+  parser.addOption({"decode-threads", "software decoding threads per camera. default is one per core", "n"});
+  parser.addOption({"convert-threads", "threads converting decoded frames. default is 2", "n"});
+  parser.addOption({"lockstep", "publish in steps of <ms> of log time as fast as possible, without the console ui. "
+                                "prints the throughput at the end of the route", "ms"});
+  parser.addOption({"ack", "with --lockstep, wait for a message of each service after every step", "services"});
   parser.addOption({{"s", "start"}, "start from <seconds>", "seconds"});
   parser.addOption({"x", QString("playback <speed>. between %1 - %2")
                         .arg(ConsoleUI::speed_array.front()).arg(ConsoleUI::speed_array.back()), "speed"});
@@ -58,6 +65,10 @@ int main(int argc, char *argv[]) {
       replay_flags |= flag;
     }
   }
+  const bool lockstep = !parser.value("lockstep").isEmpty();
+  if (lockstep) {
+    replay_flags |= REPLAY_FLAG_NO_LOOP;
+  }
 
   std::unique_ptr<OpenpilotPrefix> op_prefix;
   auto prefix = parser.value("prefix");
@@ -69,15 +80,59 @@ int main(int argc, char *argv[]) {
   if (!parser.value("c").isEmpty()) {
     replay->setSegmentCacheLimit(parser.value("c").toInt());
   }
+  if (!parser.value("prefetch").isEmpty()) {
+    replay->setPrefetchSegments(parser.value("prefetch").toInt());
+  }
+  if (!parser.value("frame-cache").isEmpty()) {
+    replay->setFrameCacheBudget(parser.value("frame-cache").toULongLong() * 1024 * 1024);
+  }
+  if (!parser.value("decode-threads").isEmpty() || !parser.value("convert-threads").isEmpty()) {
+    set_decoder_threads(parser.value("decode-threads").isEmpty() ? 0 : parser.value("decode-threads").toInt(),
+                        parser.value("convert-threads").isEmpty() ? 2 : parser.value("convert-threads").toInt());
+  }
   if (!parser.value("x").isEmpty()) {
     replay->setSpeed(std::clamp(parser.value("x").toFloat(),
                                 ConsoleUI::speed_array.front(), ConsoleUI::speed_array.back()));
   }
+  // a step is acknowledged once every ack service published after the previous step
+  std::vector<std::string> ack_services;
+  std::vector<const char *> ack_list;
+  std::unique_ptr<SubMaster> ack_sm;
+  uint64_t acked_frame = 0;
+  if (lockstep) {
+    for (const QString &s : parser.value("ack").split(",", Qt::SkipEmptyParts)) {
+      ack_services.push_back(s.toStdString());
+    }
+    LockstepSync sync;
+    if (!ack_services.empty()) {
+      for (auto &s : ack_services) ack_list.push_back(s.c_str());
+      ack_sm = std::make_unique<SubMaster>(ack_list);
+      sync = [&](uint64_t mono_time) {
+        ack_sm->update(100);
+        for (const char *s : ack_list) {
+          if (ack_sm->rcv_frame(s) <= acked_frame) return false;
+        }
+        acked_frame = ack_sm->frame;
+        return true;
+      };
+    }
+    replay->setLockstep(parser.value("lockstep").toDouble() * 1e6, sync);
+    QObject::connect(replay, &Replay::streamFinished, &app, [replay, &app]() {
+      ReplayStats stats = replay->stats();
+      printf("published %zu events, %.2f MB in %.2f s: %.0f events/s, %.2f MB/s\n", (size_t)stats.events, stats.bytes / 1e6,
+             stats.seconds, stats.events / stats.seconds, stats.bytes / 1e6 / stats.seconds);
+      app.quit();
+    });
+  }
+
   if (!replay->load()) {
     return 0;
   }
 
-  ConsoleUI console_ui(replay);
+  std::unique_ptr<ConsoleUI> console_ui;
+  if (!lockstep) {
+    console_ui = std::make_unique<ConsoleUI>(replay);
+  }
   replay->start(parser.value("start").toInt());
   return app.exec();
 }
@@ -265,57 +265,44 @@ void Replay::updateSegmentsCache() {
 }
 
 void Replay::loadSegmentInRange(SegmentMap::iterator begin, SegmentMap::iterator cur, SegmentMap::iterator end) {
-  auto loadNext = [this](auto begin, auto end) {
-    auto it = std::find_if(begin, end, [](const auto &seg_it) { return !seg_it.second || !seg_it.second->isLoaded(); });
-    if (it != end && !it->second) {
-      rDebug("loading segment %d...", it->first);
-      it->second = std::make_unique<Segment>(it->first, route_->at(it->first), flags_, filters_);
-      QObject::connect(it->second.get(), &Segment::loadFinished, this, &Replay::segmentLoadFinished);
-      return true;
+  // keep up to prefetch_segments loading in parallel
+  int loading = std::count_if(begin, end, [](const auto &seg_it) { return seg_it.second && !seg_it.second->isLoaded(); });
+  auto loadNext = [&](auto first, auto last) {
+    for (auto it = first; it != last && loading < prefetch_segments; ++it) {
+      if (!it->second) {
+        rDebug("loading segment %d...", it->first);
+        it->second = std::make_unique<Segment>(it->first, route_->at(it->first), flags_, filters_);
+        QObject::connect(it->second.get(), &Segment::loadFinished, this, &Replay::segmentLoadFinished);
+        ++loading;
+      }
     }
-    return false;
   };
 
-  // Load forward segments, then try reverse
-  if (!loadNext(cur, end)) {
-    loadNext(std::make_reverse_iterator(cur), segments_.rend());
-  }
+  // Load forward segments, then reverse
+  loadNext(cur, end);
+  loadNext(std::make_reverse_iterator(cur), std::make_reverse_iterator(begin));
 }
 
 void Replay::mergeSegments(const SegmentMap::iterator &begin, const SegmentMap::iterator &end) {
-  std::set<int> segments_to_merge;
-  size_t new_events_size = 0;
+  // segments are merged by reference, their events are neither copied nor re-sorted
+  SegmentedEvents::SegmentEvents segments_to_merge;
   for (auto it = begin; it != end; ++it) {
     if (it->second && it->second->isLoaded()) {
-      segments_to_merge.insert(it->first);
-      new_events_size += it->second->log->events.size();
+      segments_to_merge[it->first] = &it->second->log->events;
     }
   }
 
-  if (segments_to_merge == merged_segments_) return;
+  if (segments_to_merge == events_.segments()) return;
 
   rDebug("merge segments %s", std::accumulate(segments_to_merge.begin(), segments_to_merge.end(), std::string{},
-    [](auto & a, int b) { return a + (a.empty() ? "" : ", ") + std::to_string(b); }).c_str());
-
-  std::vector<Event> new_events;
-  new_events.reserve(new_events_size);
-
-  // Merge events from segments_to_merge into new_events
-  for (int n : segments_to_merge) {
-    size_t size = new_events.size();
-    const auto &events = segments_.at(n)->log->events;
-    std::copy_if(events.begin(), events.end(), std::back_inserter(new_events),
-                  [this](const Event &e) { return e.which < sockets_.size() && sockets_[e.which] != nullptr; });
-    std::inplace_merge(new_events.begin(), new_events.begin() + size, new_events.end());
-  }
+    [](auto &a, const auto &b) { return a + (a.empty() ? "" : ", ") + std::to_string(b.first); }).c_str());
 
   if (stream_thread_) {
     emit segmentsMerged();
   }
 
   updateEvents([&]() {
-    events_.swap(new_events);
-    merged_segments_ = segments_to_merge;
+    events_.assign(segments_to_merge);
     // Check if seeking is in progress
     int target_segment = int(seeking_to_seconds_ / 60);
     if (seeking_to_seconds_ >= 0 && segments_to_merge.count(target_segment) > 0) {
@@ -369,7 +356,7 @@ void Replay::startStream(const Segment *cur_segment) {
         camera_size[type] = {fr->width, fr->height};
       }
     }
-    camera_server_ = std::make_unique<CameraServer>(camera_size);
+    camera_server_ = std::make_unique<CameraServer>(camera_size, frame_cache_budget);
   }
 
   emit segmentsMerged();
@@ -390,12 +377,19 @@ void Replay::publishMessage(const Event *e) {
     if (ret == -1) {
       rWarning("stop publishing %s due to multiple publishers error", sockets_[e->which]);
       sockets_[e->which] = nullptr;
+      return;
     }
+  } else if (lockstep_step_ns_ > 0) {
+    if (sm_batch_.empty()) sm_batch_readers_.clear();
+    auto &reader = sm_batch_readers_.emplace_back(e->data);
+    sm_batch_.emplace_back(sockets_[e->which], reader.getRoot<cereal::Event>());
   } else {
     capnp::FlatArrayMessageReader reader(e->data);
     auto event = reader.getRoot<cereal::Event>();
     sm->update_msgs(nanos_since_boot(), {{sockets_[e->which], event}});
   }
+  stats_events_ += 1;
+  stats_bytes_ += e->data.size() * sizeof(capnp::word);
 }
 
 void Replay::publishFrame(const Event *e) {
@@ -418,8 +412,26 @@ void Replay::publishFrame(const Event *e) {
   }
 }
 
+bool Replay::syncLockstep(uint64_t mono_time) {
+  if (!sm_batch_.empty()) {
+    sm->update_msgs(nanos_since_boot(), sm_batch_);
+    sm_batch_.clear();
+  }
+  if (camera_server_) {
+    camera_server_->waitForSent();
+  }
+  while (mono_time > 0 && lockstep_sync_ && !paused_ && !lockstep_sync_(mono_time)) {}
+  return !paused_;
+}
+
+ReplayStats Replay::stats() const {
+  uint64_t start = stats_start_ns_;
+  return {stats_events_, stats_bytes_, start > 0 ? (nanos_since_boot() - start) / 1e9 : 0};
+}
+
 void Replay::streamThread() {
   stream_thread_id = pthread_self();
+  stats_start_ns_ = nanos_since_boot();
   cereal::Event::Which cur_which = cereal::Event::Which::INIT_DATA;
   std::unique_lock lk(stream_lock_);
 
@@ -428,41 +440,47 @@ void Replay::streamThread() {
     if (exit_) break;
 
     Event event(cur_which, cur_mono_time_, {});
-    auto first = std::upper_bound(events_.cbegin(), events_.cend(), event);
-    if (first == events_.cend()) {
+    auto first = events_.upperBound(event);
+    if (first.atEnd()) {
       rInfo("waiting for events...");
       events_ready_ = false;
       continue;
     }
 
-    auto it = publishEvents(first, events_.cend());
+    auto it = publishEvents(first);
 
     // Ensure frames are sent before unlocking to prevent race conditions
     if (camera_server_) {
       camera_server_->waitForSent();
     }
 
-    if (it != events_.cend()) {
+    if (!it.atEnd()) {
       cur_which = it->which;
-    } else if (!hasFlag(REPLAY_FLAG_NO_LOOP)) {
+    } else {
       // Check for loop end and restart if necessary
       int last_segment = segments_.rbegin()->first;
       if (current_segment_ >= last_segment && isSegmentMerged(last_segment)) {
-        rInfo("reaches the end of route, restart from beginning");
-        QMetaObject::invokeMethod(this, std::bind(&Replay::seekTo, this, 0, false), Qt::QueuedConnection);
+        if (hasFlag(REPLAY_FLAG_NO_LOOP)) {
+          emit streamFinished();
+        } else {
+          rInfo("reaches the end of route, restart from beginning");
+          QMetaObject::invokeMethod(this, std::bind(&Replay::seekTo, this, 0, false), Qt::QueuedConnection);
+        }
       }
     }
   }
 }
 
-std::vector<Event>::const_iterator Replay::publishEvents(std::vector<Event>::const_iterator first,
-                                                         std::vector<Event>::const_iterator last) {
+SegmentedEvents::Iterator Replay::publishEvents(SegmentedEvents::Iterator it) {
   uint64_t evt_start_ts = cur_mono_time_;
   uint64_t loop_start_ts = nanos_since_boot();
   double prev_replay_speed = speed_;
+  // lockstep steps are aligned to the route start, the same route is split the same way on every run
+  const uint64_t step_ns = lockstep_step_ns_;
+  uint64_t step_end = 0;
 
-  for (; !paused_ && first != last; ++first) {
-    const Event &evt = *first;
+  for (; !paused_ && !it.atEnd(); ++it) {
+    const Event &evt = *it;
     int segment = toSeconds(evt.mono_time) / 60;
 
     if (current_segment_ != segment) {
@@ -471,20 +489,27 @@ std::vector<Event>::const_iterator Replay::publishEvents(std::vector<Event>::con
     }
 
      // Skip events if socket is not present
-    if (!sockets_[evt.which]) continue;
-
-    const uint64_t current_nanos = nanos_since_boot();
-    const int64_t time_diff = (evt.mono_time - evt_start_ts) / speed_ - (current_nanos - loop_start_ts);
-
-    // Reset timestamps for potential synchronization issues:
-    // - A negative time_diff may indicate slow execution or system wake-up,
-    // - A time_diff exceeding 1 second suggests a skipped segment.
-    if ((time_diff < -1e9 || time_diff >= 1e9) || speed_ != prev_replay_speed) {
-      evt_start_ts = evt.mono_time;
-      loop_start_ts = current_nanos;
-      prev_replay_speed = speed_;
-    } else if (time_diff > 0) {
-      precise_nano_sleep(time_diff);
+    if (evt.which >= sockets_.size() || !sockets_[evt.which]) continue;
+
+    if (step_ns > 0) {
+      if (evt.mono_time >= step_end) {
+        if (step_end > 0 && !syncLockstep(step_end)) break;
+        step_end = route_start_ts_ + ((evt.mono_time - route_start_ts_) / step_ns + 1) * step_ns;
+      }
+    } else {
+      const uint64_t current_nanos = nanos_since_boot();
+      const int64_t time_diff = (evt.mono_time - evt_start_ts) / speed_ - (current_nanos - loop_start_ts);
+
+      // Reset timestamps for potential synchronization issues:
+      // - A negative time_diff may indicate slow execution or system wake-up,
+      // - A time_diff exceeding 1 second suggests a skipped segment.
+      if ((time_diff < -1e9 || time_diff >= 1e9) || speed_ != prev_replay_speed) {
+        evt_start_ts = evt.mono_time;
+        loop_start_ts = current_nanos;
+        prev_replay_speed = speed_;
+      } else if (time_diff > 0) {
+        precise_nano_sleep(time_diff);
+      }
     }
 
     if (paused_) break;
@@ -493,12 +518,19 @@ std::vector<Event>::const_iterator Replay::publishEvents(std::vector<Event>::con
     if (evt.eidx_segnum == -1) {
       publishMessage(&evt);
     } else if (camera_server_) {
-      if (speed_ > 1.0) {
+      // frames are never dropped when playing faster than real time
+      if (speed_ > 1.0 || step_ns > 0) {
         camera_server_->waitForSent();
       }
       publishFrame(&evt);
     }
   }
 
-  return first;
+  if (step_end > 0) {
+    // the last step of the route is synced. a step interrupted by pause, seek or a segment still loading
+    // is only flushed, it's synced once the rest of it is published.
+    bool route_end = it.atEnd() && isSegmentMerged(segments_.rbegin()->first);
+    syncLockstep(route_end ? step_end : 0);
+  }
+  return it;
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <algorithm>
+#include <deque>
+#include <functional>
 #include <map>
 #include <memory>
 #include <optional>
@@ -11,14 +13,19 @@
 #include <utility>
 
 #include <QThread>
+#include <capnp/serialize.h>
 
 #include "tools/replay/camera.h"
 #include "tools/replay/route.h"
+#include "tools/replay/segmented_events.h"
 
 const QString DEMO_ROUTE = "a2a0ccea32023010|2023-07-27--13-01-19";
 
-// one segment uses about 100M of memory
+// one segment uses about 100M of memory when its log is decompressed in memory.
+// uncompressed local logs are mapped and mostly backed by the page cache, so more segments can be cached.
 constexpr int MIN_SEGMENTS_CACHE = 5;
+// segments loaded in parallel
+constexpr int DEFAULT_PREFETCH_SEGMENTS = 2;
 
 enum REPLAY_FLAGS {
   REPLAY_FLAG_NONE = 0x0000,
@@ -43,6 +50,16 @@ enum class FindFlag {
 
 enum class TimelineType { None, Engaged, AlertInfo, AlertWarning, AlertCritical, UserFlag };
 typedef bool (*replayEventFilter)(const Event *, void *);
+// called in lockstep mode after each step with the log time the step ends at.
+// returns true once the consumers acknowledged the step, false to be called again.
+// it's called in the streaming thread and should return within about 100ms.
+typedef std::function<bool(uint64_t)> LockstepSync;
+
+struct ReplayStats {
+  uint64_t events = 0;
+  uint64_t bytes = 0;
+  double seconds = 0;  // wall time since the stream started
+};
 Q_DECLARE_METATYPE(std::shared_ptr<LogReader>);
 
 class Replay : public QObject {
@@ -68,6 +85,19 @@ public:
   }
   inline int segmentCacheLimit() const { return segment_cache_limit; }
   inline void setSegmentCacheLimit(int n) { segment_cache_limit = std::max(MIN_SEGMENTS_CACHE, n); }
+  inline int prefetchSegments() const { return prefetch_segments; }
+  inline void setPrefetchSegments(int n) { prefetch_segments = std::max(1, n); }
+  // memory for decoded frames per camera, takes effect when the stream starts
+  inline void setFrameCacheBudget(size_t bytes) { frame_cache_budget = bytes; }
+  inline const CameraServer *cameraServer() const { return camera_server_.get(); }
+  // lockstep mode publishes the events in steps of step_ns of log time without pacing them to the wall clock.
+  // after each step, the stream waits for sync; without it the route plays as fast as possible.
+  // takes effect when the stream starts.
+  inline void setLockstep(uint64_t step_ns, LockstepSync sync = nullptr) {
+    lockstep_step_ns_ = step_ns;
+    lockstep_sync_ = sync;
+  }
+  ReplayStats stats() const;
   inline bool hasFlag(REPLAY_FLAGS flag) const { return flags_ & flag; }
   inline void addFlag(REPLAY_FLAGS flag) { flags_ |= flag; }
   inline void removeFlag(REPLAY_FLAGS flag) { flags_ &= ~flag; }
@@ -80,7 +110,7 @@ public:
   inline int totalSeconds() const { return (!segments_.empty()) ? (segments_.rbegin()->first + 1) * 60 : 0; }
   inline void setSpeed(float speed) { speed_ = speed; }
   inline float getSpeed() const { return speed_; }
-  inline const std::vector<Event> *events() const { return &events_; }
+  inline const SegmentedEvents *events() const { return &events_; }
   inline const std::map<int, std::unique_ptr<Segment>> &segments() const { return segments_; }
   inline const std::string &carFingerprint() const { return car_fingerprint_; }
   inline const std::vector<std::tuple<double, double, TimelineType>> getTimeline() {
@@ -93,6 +123,8 @@ signals:
   void segmentsMerged();
   void seekedTo(double sec);
   void qLogLoaded(int segnum, std::shared_ptr<LogReader> qlog);
+  // the end of the route is published with REPLAY_FLAG_NO_LOOP
+  void streamFinished();
 
 protected slots:
   void segmentLoadFinished(bool success);
@@ -107,12 +139,12 @@ protected:
   void loadSegmentInRange(SegmentMap::iterator begin, SegmentMap::iterator cur, SegmentMap::iterator end);
   void mergeSegments(const SegmentMap::iterator &begin, const SegmentMap::iterator &end);
   void updateEvents(const std::function<bool()>& update_events_function);
-  std::vector<Event>::const_iterator publishEvents(std::vector<Event>::const_iterator first,
-                                                   std::vector<Event>::const_iterator last);
+  SegmentedEvents::Iterator publishEvents(SegmentedEvents::Iterator it);
   void publishMessage(const Event *e);
   void publishFrame(const Event *e);
+  bool syncLockstep(uint64_t mono_time);
   void buildTimeline();
-  inline bool isSegmentMerged(int n) const { return merged_segments_.count(n) > 0; }
+  inline bool isSegmentMerged(int n) const { return events_.contains(n); }
 
   pthread_t stream_thread_id = 0;
   QThread *stream_thread_ = nullptr;
@@ -129,8 +161,7 @@ protected:
   QDateTime route_date_time_;
   uint64_t route_start_ts_ = 0;
   std::atomic<uint64_t> cur_mono_time_ = 0;
-  std::vector<Event> events_;
-  std::set<int> merged_segments_;
+  SegmentedEvents events_;
 
   // messaging
   SubMaster *sm = nullptr;
@@ -149,4 +180,15 @@ protected:
   replayEventFilter event_filter = nullptr;
   void *filter_opaque = nullptr;
   int segment_cache_limit = MIN_SEGMENTS_CACHE;
+  int prefetch_segments = DEFAULT_PREFETCH_SEGMENTS;
+  size_t frame_cache_budget = FRAME_CACHE_DEFAULT_BUDGET;
+
+  // lockstep
+  uint64_t lockstep_step_ns_ = 0;
+  LockstepSync lockstep_sync_;
+  // messages of a step are passed to sm at once, their readers live until the next step
+  std::vector<std::pair<std::string, cereal::Event::Reader>> sm_batch_;
+  std::deque<capnp::FlatArrayMessageReader> sm_batch_readers_;
+
+  std::atomic<uint64_t> stats_events_ = 0, stats_bytes_ = 0, stats_start_ns_ = 0;
 };
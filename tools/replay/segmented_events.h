@@ -0,0 +1,85 @@
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "tools/replay/logreader.h"
+
+// Events of the merged segments. Every segment keeps its own sorted vector and the
+// iterator merges them on the fly, so merging a segment never touches the others.
+// The vectors are owned by the segments and must outlive their entry here.
+class SegmentedEvents {
+public:
+  typedef std::map<int, const std::vector<Event> *> SegmentEvents;
+
+  class Iterator {
+  public:
+    inline const Event &operator*() const { return *cursors_[cur_].first; }
+    inline const Event *operator->() const { return cursors_[cur_].first; }
+    inline bool atEnd() const { return cur_ < 0; }
+    inline Iterator &operator++() {
+      ++cursors_[cur_].first;
+      next();
+      return *this;
+    }
+
+  private:
+    friend class SegmentedEvents;
+    // k is the number of cached segments, a linear scan is cheaper than a heap.
+    // ties go to the lower segment, like a stable merge of the segments in order.
+    inline void next() {
+      cur_ = -1;
+      for (int i = 0; i < cursors_.size(); ++i) {
+        const auto &[it, end] = cursors_[i];
+        if (it != end && (cur_ < 0 || *it < *cursors_[cur_].first)) {
+          cur_ = i;
+        }
+      }
+    }
+
+    std::vector<std::pair<const Event *, const Event *>> cursors_;
+    int cur_ = -1;
+  };
+
+  // the first event after e
+  Iterator upperBound(const Event &e) const {
+    Iterator it;
+    for (const auto &[n, events] : segments_) {
+      auto first = std::upper_bound(events->begin(), events->end(), e);
+      it.cursors_.emplace_back(events->data() + (first - events->begin()), events->data() + events->size());
+    }
+    it.next();
+    return it;
+  }
+  Iterator begin() const {
+    Iterator it;
+    for (const auto &[n, events] : segments_) {
+      it.cursors_.emplace_back(events->data(), events->data() + events->size());
+    }
+    it.next();
+    return it;
+  }
+
+  inline void assign(const SegmentEvents &segment_events) { segments_ = segment_events; }
+  inline const SegmentEvents &segments() const { return segments_; }
+  inline bool contains(int n) const { return segments_.count(n) > 0; }
+  inline bool empty() const { return size() == 0; }
+  size_t size() const {
+    size_t total = 0;
+    for (const auto &[n, events] : segments_) total += events->size();
+    return total;
+  }
+  // the last event in merged order
+  const Event *back() const {
+    const Event *last = nullptr;
+    for (const auto &[n, events] : segments_) {
+      if (!events->empty() && (!last || !(events->back() < *last))) last = &events->back();
+    }
+    return last;
+  }
+
+private:
+  SegmentEvents segments_;
+};
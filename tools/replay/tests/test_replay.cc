@@ -1,10 +1,17 @@
 #include <chrono>
+#include <fstream>
+#include <functional>
+#include <numeric>
 #include <thread>
 
 #include <QEventLoop>
+#include <QTimer>
+#include <QUrl>
 
 #include "catch2/catch.hpp"
+#include "common/timing.h"
 #include "common/util.h"
+#include "system/loggerd/log_index.h"
 #include "tools/replay/replay.h"
 #include "tools/replay/util.h"
 
@@ -71,6 +78,158 @@ TEST_CASE("LogReader") {
   }
 }
 
+// writes a minute of can, carState and roadEncodeIdx events with the side index loggerd writes
+void write_indexed_log(const std::string &log_file, uint64_t start_mono_time) {
+  std::ofstream log(log_file, std::ios::binary | std::ios::out);
+  LogIndexBuilder index;
+  auto write = [&](MessageBuilder &msg, uint64_t mono_time) {
+    msg.getRoot<cereal::Event>().setLogMonoTime(mono_time);
+    auto bytes = msg.toBytes();
+    log.write((const char *)bytes.begin(), bytes.size());
+    index.add(msg.getRoot<cereal::Event>().which(), mono_time, bytes.size());
+  };
+
+  for (int i = 0; i < 60 * 100; ++i) {
+    uint64_t mono_time = start_mono_time + i * 10000000ULL;
+    MessageBuilder can_msg;
+    auto can = can_msg.initEvent().initCan(50);
+    for (int j = 0; j < can.size(); ++j) {
+      uint64_t dat = ((uint64_t)i << 16) | j;
+      can[j].setAddress(0x100 + j);
+      can[j].setDat(kj::arrayPtr((capnp::byte *)&dat, sizeof(dat)));
+    }
+    write(can_msg, mono_time);
+
+    MessageBuilder cs_msg;
+    cs_msg.initEvent().initCarState().setVEgo(i);
+    write(cs_msg, mono_time + 1000);
+
+    if (i % 5 == 0) {
+      MessageBuilder idx_msg;
+      auto idx = idx_msg.initEvent().initRoadEncodeIdx();
+      idx.setSegmentNum(0);
+      idx.setTimestampSof(mono_time - 2000);
+      write(idx_msg, mono_time + 2000);
+    }
+  }
+  log.close();
+  std::string data = index.finish();
+  std::ofstream(log_file + ".idx", std::ios::binary | std::ios::out).write(data.data(), data.size());
+}
+
+TEST_CASE("LogReader indexed") {
+  const std::string log_file = "/tmp/test_log_reader_indexed";
+  const uint64_t start_mono_time = 1000 * 1e9;
+  write_indexed_log(log_file, start_mono_time);
+
+  std::string raw = util::read_file(log_file);
+  LogReader full;
+  REQUIRE(full.load(raw.data(), raw.size()));
+
+  auto expected = [&](const std::vector<bool> &filters, uint64_t begin, uint64_t end) {
+    std::vector<Event> events;
+    for (const Event &e : full.events) {
+      bool selected = filters.empty() || (e.which < filters.size() && filters[e.which]);
+      // frame events of encodeIdx packets are selected by the packet's log time
+      capnp::FlatArrayMessageReader reader(e.data);
+      uint64_t log_mono_time = reader.getRoot<cereal::Event>().getLogMonoTime();
+      if (selected && log_mono_time >= begin && log_mono_time < end) events.push_back(e);
+    }
+    return events;
+  };
+  auto verify = [&](const LogReader &log, const std::vector<Event> &events) {
+    REQUIRE(log.events.size() == events.size());
+    REQUIRE(std::is_sorted(log.events.begin(), log.events.end()));
+    for (int i = 0; i < events.size(); ++i) {
+      REQUIRE(log.events[i].which == events[i].which);
+      REQUIRE(log.events[i].mono_time == events[i].mono_time);
+      REQUIRE(log.events[i].eidx_segnum == events[i].eidx_segnum);
+      REQUIRE(log.events[i].data.asBytes() == events[i].data.asBytes());
+    }
+  };
+
+  SECTION("load uses the index") {
+    LogReader log;
+    REQUIRE(log.load(log_file));
+    verify(log, full.events);
+  }
+  SECTION("filters and time window") {
+    std::vector<bool> filters(std::max(cereal::Event::Which::CAN, cereal::Event::Which::ROAD_ENCODE_IDX) + 1, false);
+    filters[cereal::Event::Which::CAN] = true;
+    filters[cereal::Event::Which::ROAD_ENCODE_IDX] = true;
+    const uint64_t begin = start_mono_time + 10.5 * 1e9, end = start_mono_time + 12.25 * 1e9;
+    LogReader log(filters);
+    REQUIRE(log.loadIndexed(log_file, begin, end));
+    verify(log, expected(filters, begin, end));
+  }
+  SECTION("logs without an index are mapped") {
+    std::remove((log_file + ".idx").c_str());
+    std::vector<bool> filters(cereal::Event::Which::CAR_STATE + 1, false);
+    filters[cereal::Event::Which::CAR_STATE] = true;
+    LogReader log(filters);
+    REQUIRE(log.load(log_file));
+    verify(log, expected(filters, 0, UINT64_MAX));
+  }
+  SECTION("stale index is ignored") {
+    std::ofstream(log_file, std::ios::binary | std::ios::app).write(raw.data(), raw.size());
+    LogReader log;
+    REQUIRE(!log.loadIndexed(log_file));
+    REQUIRE(log.load(log_file));
+    REQUIRE(log.events.size() == 2 * full.events.size());
+  }
+  std::remove(log_file.c_str());
+  std::remove((log_file + ".idx").c_str());
+}
+
+TEST_CASE("LogReader indexed benchmark", "[.][benchmark]") {
+  const std::string log_file = "/tmp/test_log_reader_indexed_bench";
+  const uint64_t start_mono_time = 1000 * 1e9;
+  write_indexed_log(log_file, start_mono_time);
+
+  auto resident_bytes = []() {
+    size_t pages = 0, resident = 0;
+    std::ifstream("/proc/self/statm") >> pages >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+  };
+  auto run = [&](const char *name, std::function<bool(LogReader &)> load, const std::vector<bool> &filters = {}) {
+    size_t rss_before = resident_bytes();
+    auto start = std::chrono::steady_clock::now();
+    LogReader log(filters);
+    REQUIRE(load(log));
+    REQUIRE(!log.events.empty());
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("%-28s time to first event %8.2f ms, %7zu events, memory %8.2f MB\n", name, ms, log.events.size(),
+           (resident_bytes() - rss_before) / (1024.0 * 1024.0));
+  };
+
+  std::vector<bool> can_filter(cereal::Event::Which::CAN + 1, false);
+  can_filter[cereal::Event::Which::CAN] = true;
+  const std::string idx_file = log_file + ".idx";
+  // what load() does for compressed logs: the whole log is kept unless events are filtered
+  std::string raw;
+  run("in memory", [&](LogReader &log) {
+    raw = util::read_file(log_file);
+    return log.load(raw.data(), raw.size());
+  });
+  std::string().swap(raw);
+  run("in memory, can only", [&](LogReader &log) {
+    std::string data = util::read_file(log_file);
+    return log.load(data.data(), data.size());
+  }, can_filter);
+  std::rename(idx_file.c_str(), (idx_file + ".bak").c_str());
+  run("mapped", [&](LogReader &log) { return log.load(log_file); });
+  run("mapped, can only", [&](LogReader &log) { return log.load(log_file); }, can_filter);
+  std::rename((idx_file + ".bak").c_str(), idx_file.c_str());
+  run("indexed", [&](LogReader &log) { return log.load(log_file); });
+  run("indexed, can only", [&](LogReader &log) { return log.load(log_file); }, can_filter);
+  run("indexed, can only, 5s window", [&](LogReader &log) {
+    return log.loadIndexed(log_file, start_mono_time + 30 * 1e9, start_mono_time + 35 * 1e9);
+  }, can_filter);
+
+  std::remove(log_file.c_str());
+  std::remove(idx_file.c_str());
+}
+
 void read_segment(int n, const SegmentFile &segment_file, uint32_t flags) {
   QEventLoop loop;
   Segment segment(n, segment_file, flags);
@@ -174,3 +333,347 @@ TEST_CASE("seek_to") {
 
   loop.exec();
 }
+
+TEST_CASE("Replay lockstep") {
+  std::string data_dir = download_demo_route();
+  const uint64_t step_ns = 50 * 1e6;
+  SubMaster sm({"carState", "can"});
+  Replay replay(DEMO_ROUTE, {"carState", "can"}, {}, &sm, REPLAY_FLAG_NO_VIPC | REPLAY_FLAG_NO_LOOP,
+                QString::fromStdString(data_dir));
+  std::vector<uint64_t> steps;
+  replay.setLockstep(step_ns, [&](uint64_t mono_time) {
+    steps.push_back(mono_time);
+    return true;
+  });
+  REQUIRE(replay.load());
+
+  QEventLoop loop;
+  QObject::connect(&replay, &Replay::streamFinished, &loop, &QEventLoop::quit);
+  replay.start();
+  loop.exec();
+  replay.stop();
+
+  // every event is published, in steps aligned to the route start
+  size_t events = 0;
+  for (const auto &[n, segment] : replay.route()->segments()) {
+    LogReader log;
+    REQUIRE(log.load(segment.rlog.toStdString()));
+    events += std::count_if(log.events.begin(), log.events.end(), [](const Event &e) {
+      return e.which == cereal::Event::Which::CAN || e.which == cereal::Event::Which::CAR_STATE;
+    });
+  }
+  REQUIRE(replay.stats().events == events);
+  REQUIRE(!steps.empty());
+  for (int i = 0; i < steps.size(); ++i) {
+    REQUIRE((steps[i] - replay.routeStartTime()) % step_ns == 0);
+    if (i > 0) REQUIRE(steps[i] > steps[i - 1]);
+  }
+}
+
+std::vector<std::vector<Event>> build_segment_events(int segments, int events_per_segment) {
+  std::vector<std::vector<Event>> result(segments);
+  for (int n = 0; n < segments; ++n) {
+    for (int i = 0; i < events_per_segment; ++i) {
+      // segments overlap a little at the boundaries, like frame events of encodeIdx packets
+      uint64_t mono_time = ((n + 1) * 60 * 1000 + util::random_int(-1000, 60 * 1000)) * 1000000ULL;
+      auto which = (cereal::Event::Which)util::random_int(0, 10);
+      result[n].emplace_back(which, mono_time, kj::ArrayPtr<const capnp::word>{});
+    }
+    std::sort(result[n].begin(), result[n].end());
+  }
+  return result;
+}
+
+TEST_CASE("SegmentedEvents") {
+  auto segment_events = build_segment_events(5, 2000);
+  SegmentedEvents::SegmentEvents segments;
+  std::vector<Event> merged;
+  for (int n = 0; n < segment_events.size(); ++n) {
+    segments[n] = &segment_events[n];
+    merged.insert(merged.end(), segment_events[n].begin(), segment_events[n].end());
+  }
+  std::stable_sort(merged.begin(), merged.end());
+
+  SegmentedEvents events;
+  REQUIRE(events.empty());
+  REQUIRE(events.back() == nullptr);
+  REQUIRE(events.begin().atEnd());
+  events.assign(segments);
+  REQUIRE(events.size() == merged.size());
+  REQUIRE(events.back() == &segment_events[4].back());
+
+  auto verify_from = [&](SegmentedEvents::Iterator it, std::vector<Event>::const_iterator expected) {
+    for (; !it.atEnd(); ++it, ++expected) {
+      REQUIRE(expected != merged.cend());
+      REQUIRE(it->mono_time == expected->mono_time);
+      REQUIRE(it->which == expected->which);
+    }
+    REQUIRE(expected == merged.cend());
+  };
+  verify_from(events.begin(), merged.cbegin());
+  for (int i = 0; i < 20; ++i) {
+    const Event &e = merged[util::random_int(0, merged.size() - 1)];
+    verify_from(events.upperBound(e), std::upper_bound(merged.cbegin(), merged.cend(), e));
+  }
+
+  // merging a segment leaves the other ones untouched
+  segments.erase(0);
+  events.assign(segments);
+  REQUIRE(!events.contains(0));
+  REQUIRE(events.contains(1));
+  REQUIRE(events.size() == merged.size() - segment_events[0].size());
+}
+
+TEST_CASE("Replay prefetch benchmark", "[.][benchmark]") {
+  auto prefetch = GENERATE(1, 2, 4);
+
+  SECTION("seek latency") {
+    Replay replay(DEMO_ROUTE, {"carState", "can"}, {}, nullptr, REPLAY_FLAG_NO_VIPC | REPLAY_FLAG_NO_LOOP);
+    replay.setPrefetchSegments(prefetch);
+    REQUIRE(replay.load());
+
+    QEventLoop loop;
+    double seek_start = 0;
+    std::vector<double> latencies;
+    QObject::connect(&replay, &Replay::seekedTo, [&](double sec) {
+      latencies.push_back(millis_since_boot() - seek_start);
+      loop.quit();
+    });
+    for (int seconds : {0, 7 * 60, 2 * 60, 11 * 60, 5 * 60}) {
+      seek_start = millis_since_boot();
+      size_t seeks = latencies.size();
+      if (seconds == 0) {
+        replay.start(seconds);
+      } else {
+        replay.seekTo(seconds, false);
+      }
+      if (latencies.size() == seeks) loop.exec();
+    }
+    double total = std::accumulate(latencies.begin(), latencies.end(), 0.0);
+    printf("prefetch %d: seek latency avg %.2f ms, max %.2f ms\n", prefetch, total / latencies.size(),
+           *std::max_element(latencies.begin(), latencies.end()));
+  }
+
+  SECTION("stall time") {
+    for (float speed : {4.0f, 10.0f}) {
+      const double play_ms = 20 * 1000;
+      Replay replay(DEMO_ROUTE, {"carState", "can"}, {}, nullptr, REPLAY_FLAG_NO_VIPC | REPLAY_FLAG_NO_LOOP);
+      replay.setPrefetchSegments(prefetch);
+      replay.setSegmentCacheLimit(10);
+      replay.setSpeed(speed);
+      REQUIRE(replay.load());
+
+      QEventLoop loop;
+      double start_ms = 0, start_sec = 0;
+      QObject::connect(&replay, &Replay::seekedTo, [&](double sec) {
+        start_ms = millis_since_boot();
+        start_sec = sec;
+        QTimer::singleShot(play_ms, &loop, &QEventLoop::quit);
+      });
+      replay.start(0);
+      loop.exec();
+
+      double elapsed_ms = millis_since_boot() - start_ms;
+      double played_ms = (replay.currentSeconds() - start_sec) * 1000 / speed;
+      printf("prefetch %d, %.0fx: played %.1f s of route in %.1f s, stalled %.2f s\n", prefetch, speed,
+             replay.currentSeconds() - start_sec, elapsed_ms / 1000, std::max(0.0, elapsed_ms - played_ms) / 1000);
+    }
+  }
+}
+
+std::vector<std::string> decode_frames(FrameReader &fr, const std::vector<int> &indices) {
+  auto [nv12_width, nv12_height, nv12_buffer_size] = get_nv12_info(fr.width, fr.height);
+  VisionBuf buf;
+  buf.allocate(nv12_buffer_size);
+  buf.init_yuv(fr.width, fr.height, nv12_width, nv12_width * nv12_height);
+  std::vector<std::string> frames;
+  for (int idx : indices) {
+    REQUIRE(fr.get(idx, &buf));
+    frames.emplace_back((const char *)buf.addr, buf.len);
+  }
+  buf.free();
+  return frames;
+}
+
+TEST_CASE("FrameReader packet index") {
+  std::string data_dir = download_demo_route();
+  Route route(DEMO_ROUTE, QString::fromStdString(data_dir));
+  REQUIRE(route.load());
+  const std::string qcamera = route.at(0).qcamera.toStdString();
+  const std::string index_file = cacheFilePath(qcamera) + ".pkt";
+  std::remove(index_file.c_str());
+
+  auto load = [&]() {
+    auto fr = std::make_unique<FrameReader>();
+    REQUIRE(fr->load(RoadCam, qcamera, true));
+    return fr;
+  };
+  auto scanned = load();
+  REQUIRE(util::file_exists(index_file));
+
+  SECTION("reload uses the index") {
+    auto indexed = load();
+    REQUIRE(indexed->getFrameCount() == scanned->getFrameCount());
+    for (int i = 0; i < scanned->getFrameCount(); ++i) {
+      REQUIRE(indexed->packets_info[i].flags == scanned->packets_info[i].flags);
+      REQUIRE(indexed->packets_info[i].pos == scanned->packets_info[i].pos);
+    }
+    std::vector<int> indices = {0, 1, 2, 150, 151, 37};
+    REQUIRE(decode_frames(*indexed, indices) == decode_frames(*scanned, indices));
+  }
+  SECTION("invalid index is rebuilt") {
+    std::string index = util::read_file(index_file);
+    index.resize(index.size() - 1);
+    REQUIRE(util::write_file(index_file.c_str(), index.data(), index.size(), O_WRONLY | O_TRUNC) == 0);
+    auto rebuilt = load();
+    REQUIRE(rebuilt->getFrameCount() == scanned->getFrameCount());
+    REQUIRE(util::read_file(index_file).size() == index.size() + 1);
+  }
+}
+
+TEST_CASE("FrameReader load benchmark", "[.][benchmark]") {
+  Route route(DEMO_ROUTE);
+  REQUIRE(route.load());
+  for (const QString &url : {route.at(0).road_cam, route.at(0).qcamera}) {
+    const std::string file = url.toStdString();
+    if (!util::file_exists(cacheFilePath(file))) {
+      REQUIRE(!FileReader(true, 20 * 1024 * 1024, 3).read(file).empty());
+    }
+    for (bool indexed : {false, true}) {
+      if (!indexed) std::remove((cacheFilePath(file) + ".pkt").c_str());
+      // time until the first frame of a cached video is decoded
+      double start = millis_since_boot();
+      FrameReader fr;
+      REQUIRE(fr.load(RoadCam, file, true, nullptr, true, 20 * 1024 * 1024, 3));
+      double load_ms = millis_since_boot() - start;
+      REQUIRE(decode_frames(fr, {0}).size() == 1);
+      printf("%-12s %-10s load %8.2f ms, first frame %8.2f ms\n", QUrl(url).fileName().toStdString().c_str(),
+             indexed ? "indexed" : "scanned", load_ms, millis_since_boot() - start);
+    }
+  }
+}
+
+TEST_CASE("FrameCache") {
+  std::string data_dir = download_demo_route();
+  Route route(DEMO_ROUTE, QString::fromStdString(data_dir));
+  REQUIRE(route.load());
+  const std::string qcamera = route.at(0).qcamera.toStdString();
+
+  // sequential playback, a skip within the GOP, a seek back and a seek forward
+  std::vector<int> indices;
+  for (int i = 0; i < 30; ++i) indices.push_back(i);
+  for (int i : {33, 36, 5, 6, 7, 300, 301, 302}) indices.push_back(i);
+
+  std::vector<std::string> expected;
+  {
+    FrameReader fr;
+    REQUIRE(fr.load(RoadCam, qcamera, true));
+    expected = decode_frames(fr, indices);
+  }
+
+  auto fr = std::make_unique<FrameReader>();
+  REQUIRE(fr->load(RoadCam, qcamera, true));
+  auto [nv12_width, nv12_height, nv12_buffer_size] = get_nv12_info(fr->width, fr->height);
+  auto budget = GENERATE(2, 16, 64);
+  FrameCache cache(fr->width, fr->height, budget * nv12_buffer_size);
+  REQUIRE(cache.capacity() == budget);
+
+  VisionBuf buf;
+  buf.allocate(nv12_buffer_size);
+  buf.init_yuv(fr->width, fr->height, nv12_width, nv12_width * nv12_height);
+  int hits = 0;
+  for (int i = 0; i < indices.size(); ++i) {
+    bool hit = false;
+    REQUIRE(cache.get(fr.get(), indices[i], &buf, &hit));
+    REQUIRE(std::string((const char *)buf.addr, buf.len) == expected[i]);
+    hits += hit;
+    // give the decoder time to get ahead of playback
+    util::sleep_for(5);
+  }
+  INFO("hits " << hits << " of " << indices.size());
+  if (budget > 2) {
+    REQUIRE(hits > indices.size() / 2);
+  }
+
+  // frames past the end don't exist
+  REQUIRE_FALSE(cache.get(fr.get(), fr->getFrameCount(), &buf));
+  REQUIRE_FALSE(cache.get(fr.get(), -1, &buf));
+  REQUIRE(fr->keyFrameIndex(fr->getFrameCount() + 10) < fr->getFrameCount());
+
+  // readers can go away while the cache is alive
+  fr.reset();
+  FrameReader fr2;
+  REQUIRE(fr2.load(RoadCam, qcamera, true));
+  REQUIRE(cache.get(&fr2, indices[0], &buf));
+  REQUIRE(std::string((const char *)buf.addr, buf.len) == expected[0]);
+  buf.free();
+}
+
+TEST_CASE("FrameReader threaded decoding") {
+  std::string data_dir = download_demo_route();
+  Route route(DEMO_ROUTE, QString::fromStdString(data_dir));
+  REQUIRE(route.load());
+  auto decode = [&](int decode_threads, int convert_threads) {
+    set_decoder_threads(decode_threads, convert_threads);
+    FrameReader fr;
+    REQUIRE(fr.load(RoadCam, route.at(0).qcamera.toStdString(), true));
+    // sequential, seeks back and forth, and the end of the video
+    const int last = fr.getFrameCount() - 1;
+    return decode_frames(fr, {0, 1, 2, 3, 40, 41, 42, 10, 11, last - 1, last, 5});
+  };
+  auto single = decode(1, 0);
+  auto threaded = decode(4, 3);
+  set_decoder_threads(0, 2);
+  REQUIRE(single == threaded);
+}
+
+TEST_CASE("FrameReader decode benchmark", "[.][benchmark]") {
+  Route route(DEMO_ROUTE);
+  REQUIRE(route.load());
+  const std::pair<CameraType, std::string> cameras[] = {
+      {RoadCam, route.at(0).road_cam.toStdString()},
+      {WideRoadCam, route.at(0).wide_road_cam.toStdString()},
+      {DriverCam, route.at(0).driver_cam.toStdString()},
+  };
+
+  // all cameras play 100 frames at speed, each from its own thread like the camera server
+  auto play = [&](const char *name, float speed) {
+    std::atomic<bool> failed = false;
+    std::vector<std::thread> threads;
+    for (auto &[type, file] : cameras) {
+      threads.emplace_back([&, type = type, file = file]() {
+        FrameReader fr;
+        if (!fr.load(type, file, true, nullptr, true, 20 * 1024 * 1024, 3)) {
+          failed = true;
+          return;
+        }
+        auto [nv12_width, nv12_height, nv12_buffer_size] = get_nv12_info(fr.width, fr.height);
+        VisionBuf buf;
+        buf.allocate(nv12_buffer_size);
+        buf.init_yuv(fr.width, fr.height, nv12_width, nv12_width * nv12_height);
+        const int frames = std::min<int>(100, fr.getFrameCount());
+        int late = 0;
+        double start = millis_since_boot();
+        for (int i = 0; i < frames; ++i) {
+          failed = failed || !fr.get(i, &buf);
+          double ms = millis_since_boot() - start - i * 50 / speed;
+          late += ms > 50 / speed;
+          util::sleep_for(std::max(0.0, 50 / speed - ms));
+        }
+        double fps = frames * 1000.0 / (millis_since_boot() - start);
+        printf("%-8s %2.0fx camera %d: %6.1f fps (target %4.0f), %5.1f%% frames late\n", name, speed, type, fps,
+               20 * speed, 100.0 * late / frames);
+        buf.free();
+      });
+    }
+    for (auto &t : threads) t.join();
+    REQUIRE(!failed);
+  };
+
+  for (float speed : {1.0f, 2.0f, 4.0f}) {
+    set_decoder_threads(1, 0);
+    play("single", speed);
+    set_decoder_threads(0, 2);
+    play("threaded", speed);
+  }
+}
@@ -3,6 +3,7 @@
 #include <bzlib.h>
 #include <curl/curl.h>
 #include <openssl/sha.h>
+#include <zstd.h>
 
 #include <cassert>
 #include <algorithm>
@@ -318,6 +319,48 @@ std::string decompressBZ2(const std::byte *in, size_t in_size, std::atomic<bool>
   return {};
 }
 
+std::string decompressZST(const std::string &in, std::atomic<bool> *abort) {
+  return decompressZST((std::byte *)in.data(), in.size(), abort);
+}
+
+std::string decompressZST(const std::byte *in, size_t in_size, std::atomic<bool> *abort) {
+  if (in_size == 0) return {};
+
+  ZSTD_DCtx *dctx = ZSTD_createDCtx();
+  assert(dctx != nullptr);
+
+  // loggerd streams the frame, so the content size is not stored in the header
+  std::string out(in_size * 5, '\0');
+  ZSTD_inBuffer input = {in, in_size, 0};
+  ZSTD_outBuffer output = {&out[0], out.size(), 0};
+  size_t ret = 0;
+  do {
+    ret = ZSTD_decompressStream(dctx, &output, &input);
+    if (ZSTD_isError(ret)) {
+      rWarning("decompressZST error : %s", ZSTD_getErrorName(ret));
+      break;
+    }
+
+    if (output.pos == output.size) {
+      out.resize(out.size() * 2);
+      output.dst = &out[0];
+      output.size = out.size();
+    }
+  } while ((input.pos < input.size || output.pos == output.size) && !(abort && *abort));
+
+  ZSTD_freeDCtx(dctx);
+  if (ZSTD_isError(ret) || (abort && *abort)) {
+    return {};
+  }
+  if (ret != 0) {
+    // the log was not closed (e.g. loggerd crashed), everything up to the last flushed block is still valid
+    rWarning("decompressZST : content is truncated");
+  }
+  out.resize(output.pos);
+  out.shrink_to_fit();
+  return out;
+}
+
 void precise_nano_sleep(int64_t nanoseconds) {
 #ifdef __APPLE__
   const long estimate_ns = 1 * 1e6;  // 1ms